@@ -0,0 +1,38 @@
+#version 450
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D sceneTexture;
+
+// Same layout as sUpscalePushConstants
+layout(push_constant) uniform PushConstants {
+    vec2  uv_scale;   // Rendered part of the scene target
+    vec2  texel_size; // Of the scene target
+    float sharpness;  // 0 is plain bilinear
+} push;
+
+void main() {
+    // Half a texel inside of the rendered part, the rest of the target is stale
+    vec2 uv_max = push.uv_scale - 0.5 * push.texel_size;
+    vec2 uv = min(fragTexCoord * push.uv_scale, uv_max);
+    vec4 color = texture(sceneTexture, uv);
+
+    if (push.sharpness > 0.0) {
+        // Unsharp mask on the 4 neighbours, clamped to their range so the edges do not ring
+        vec3 north = texture(sceneTexture, min(uv - vec2(0.0, push.texel_size.y), uv_max)).rgb;
+        vec3 south = texture(sceneTexture, min(uv + vec2(0.0, push.texel_size.y), uv_max)).rgb;
+        vec3 west = texture(sceneTexture, min(uv - vec2(push.texel_size.x, 0.0), uv_max)).rgb;
+        vec3 east = texture(sceneTexture, min(uv + vec2(push.texel_size.x, 0.0), uv_max)).rgb;
+
+        vec3 blurred = (north + south + west + east) * 0.25;
+        vec3 sharpened = color.rgb + (color.rgb - blurred) * push.sharpness * 2.0;
+
+        vec3 low = min(min(min(north, south), min(west, east)), color.rgb);
+        vec3 high = max(max(max(north, south), max(west, east)), color.rgb);
+        color.rgb = clamp(sharpened, low, high);
+    }
+
+    outColor = color;
+}
@@ -0,0 +1,9 @@
+#version 450
+
+layout(location = 0) out vec2 fragTexCoord;
+
+// Fullscreen triangle from the vertex index, no vertex buffer
+void main() {
+    fragTexCoord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(fragTexCoord * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -22,9 +22,11 @@ void get_swapchain_info(const VkPhysicalDevice& device,
                         const VkSurfaceKHR &surface,
                         sSwapchainSupportInfo *swapchain_info);
 
-void choose_swapchain_config(sSwapchainSupportInfo *swapchain_info);
+void choose_swapchain_config(sSwapchainSupportInfo *swapchain_info,
+                             const ePresentPolicy present_policy);
 
-VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities);
+VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities,
+                                   GLFWwindow *window);
 
 static VKAPI_ATTR VkBool32 
 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
@@ -64,7 +66,7 @@ void sApp::_init_vulkan() {
             .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
             .pEngineName = ENGINE_NAME,
             .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-            .apiVersion = VK_API_VERSION_1_0
+            .apiVersion = VK_API_VERSION_1_2 // For descriptor indexing, if the device has it
         };
 
         VkInstanceCreateInfo create_info = {
@@ -148,7 +150,8 @@ void sApp::_init_vulkan() {
 
         assert_msg(device_count > 0, "There are no GPUs detected!");
 
-        VkPhysicalDevice *device_list = (VkPhysicalDevice*) malloc(sizeof(VkPhysicalDevice) * device_count);
+        sScratchScope scratch(get_scratch_allocator());
+        VkPhysicalDevice *device_list = scratch.alloc_array<VkPhysicalDevice>(device_count);
         vkEnumeratePhysicalDevices(Vulkan.instance, 
                                    &device_count, 
                                    device_list);
@@ -167,7 +170,11 @@ void sApp::_init_vulkan() {
         }
         assert_msg(Vulkan.physical_device != VK_NULL_HANDLE, "Could not find a suitable GPU");
 
-        free(device_list);
+        // The compute passes share the graphics queue
+        if (!config.use_async_compute) {
+            Vulkan.queues.compute_family_id = Vulkan.queues.graphics_family_id;
+            Vulkan.queues.has_found_async_compute_family = false;
+        }
     }
 
 
@@ -177,33 +184,93 @@ void sApp::_init_vulkan() {
     {
         // Create the queues for interacting with the device
         float queue_priority = 1.0f;
-        VkDeviceQueueCreateInfo queues_creation_info[2] = {
-            { // GRAPHICS QUEUE
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .pNext = NULL,
-                .queueFamilyIndex = Vulkan.queues.graphics_family_id,
-                .queueCount = 1,
-                .pQueuePriorities = &queue_priority
-            },
-            { // PRESENT QUEUE
+        const uint32_t family_ids[3] = {
+            Vulkan.queues.graphics_family_id,
+            Vulkan.queues.presenting_family_id,
+            Vulkan.queues.compute_family_id
+        };
+        // One per distinct family
+        VkDeviceQueueCreateInfo queues_creation_info[3];
+        uint32_t queue_create_count = 0;
+        for(uint32_t i = 0; i < 3; i++) {
+            bool is_repeated = false;
+            for(uint32_t j = 0; j < i; j++) {
+                is_repeated |= family_ids[j] == family_ids[i];
+            }
+            if (is_repeated) {
+                continue;
+            }
+
+            queues_creation_info[queue_create_count++] = {
                 .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
                 .pNext = NULL,
-                .queueFamilyIndex = Vulkan.queues.presenting_family_id,
+                .queueFamilyIndex = family_ids[i],
                 .queueCount = 1,
                 .pQueuePriorities = &queue_priority
-            }
-        };
+            };
+        }
 
         // Set the device features: no need for now (thingslike geometry shaders and stuff)
+        // Block compression is enabled when available, the textures fallback to RGBA8 otherwise
+        VkPhysicalDeviceFeatures supported_features;
+        vkGetPhysicalDeviceFeatures(Vulkan.physical_device, 
+                                    &supported_features);
         VkPhysicalDeviceFeatures device_features{
             .samplerAnisotropy = VK_TRUE,
+            .textureCompressionASTC_LDR = supported_features.textureCompressionASTC_LDR,
+            .textureCompressionBC = supported_features.textureCompressionBC,
         };
 
+        // Bindless textures, otherwise the textures are bound through the per-frame sets
+        Vulkan.use_bindless = supports_descriptor_indexing();
+        VkPhysicalDeviceDescriptorIndexingFeatures indexing_features = {};
+        indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        indexing_features.runtimeDescriptorArray = VK_TRUE;
+        indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+        indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+        // The optional features are chained from the end
+        void *feature_chain = (Vulkan.use_bindless) ? &indexing_features : NULL;
+
+        // Frame pacing on the real present times, when available (see frame_pacer.cpp)
+        Vulkan.use_present_wait = supports_present_wait();
+        VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+        present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        present_wait_features.pNext = feature_chain;
+        present_wait_features.presentWait = VK_TRUE;
+        VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+        present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        present_id_features.pNext = &present_wait_features;
+        present_id_features.presentId = VK_TRUE;
+        if (Vulkan.use_present_wait) {
+            Vulkan.required_device_extensions[Vulkan.required_device_extension_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+            Vulkan.required_device_extensions[Vulkan.required_device_extension_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+            feature_chain = &present_id_features;
+        }
+
+        // The render graph barriers, with the legacy ones as fallback (see render_graph.cpp)
+        Vulkan.use_synchronization2 = supports_synchronization2();
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features = {};
+        synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        synchronization2_features.pNext = feature_chain;
+        synchronization2_features.synchronization2 = VK_TRUE;
+        if (Vulkan.use_synchronization2) {
+            Vulkan.required_device_extensions[Vulkan.required_device_extension_count++] = VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME;
+            feature_chain = &synchronization2_features;
+        }
+
+        // The frame & upload synchronization (see gpu_timeline.h)
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+        timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timeline_features.pNext = feature_chain;
+        timeline_features.timelineSemaphore = VK_TRUE;
+
         // TODO: add the enabled layers for retorcompatibility
         VkDeviceCreateInfo device_create_info = {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .pNext = NULL,
-            .queueCreateInfoCount = 2,
+            .pNext = &timeline_features,
+            .queueCreateInfoCount = queue_create_count,
             .pQueueCreateInfos = queues_creation_info,
             .enabledExtensionCount = Vulkan.required_device_extension_count,
             .ppEnabledExtensionNames = Vulkan.required_device_extensions,
@@ -225,113 +292,20 @@ void sApp::_init_vulkan() {
                          Vulkan.queues.presenting_family_id, 
                          0, 
                          &Vulkan.present_queue);
+
+        // Before anything is submitted, the uploads of the init wait on it too
+        Vulkan.graphics_timeline.init(&Vulkan.device);
+        Vulkan.deletion_queue.init(&Vulkan.device,
+                                   &Vulkan.graphics_timeline);
     }
 
     
     // ===================================
     // CREATE SWAPCHAIN ==================
     // ===================================
-    {
-        choose_swapchain_config(&Vulkan.swapchain_info);
-
-        // One more, in order to avoid waiting for the driver in order to adquire the image
-        uint32_t image_count = Vulkan.swapchain_info.capabilites.minImageCount + 1;
-
-        // Check if we dont go over the max amount of images of the device
-        if (Vulkan.swapchain_info.capabilites.maxImageCount > 0 && 
-            image_count > Vulkan.swapchain_info.capabilites.maxImageCount) {
-            image_count = Vulkan.swapchain_info.capabilites.minImageCount;
-        }
-
-        uint32_t queue_familiy_indices[2] = { 
-            Vulkan.queues.graphics_family_id, 
-            Vulkan.queues.presenting_family_id 
-        };
-
-        bool use_concurrent_mode = Vulkan.queues.graphics_family_id != Vulkan.queues.presenting_family_id;
-
-        Vulkan.swapchain_info.swapchain_extent = choose_swapchain_extent(Vulkan.swapchain_info.capabilites);
-
-        VkSwapchainCreateInfoKHR create_info = {
-            .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-            .pNext = NULL,
-            .surface = Vulkan.surface,
-            .minImageCount = image_count,
-            .imageFormat = Vulkan.swapchain_info.selected_format.format,
-            .imageColorSpace = Vulkan.swapchain_info.selected_format.colorSpace,
-            .imageExtent = Vulkan.swapchain_info.swapchain_extent, // size of the swapchain iamges
-            .imageArrayLayers = 1, 
-            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-            .imageSharingMode = (use_concurrent_mode) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE, // share images between queues families
-            .queueFamilyIndexCount = (uint32_t) ((use_concurrent_mode) ? 2 : 0),
-            .pQueueFamilyIndices = (use_concurrent_mode) ? queue_familiy_indices : NULL,
-            .preTransform = Vulkan.swapchain_info.capabilites.currentTransform, // Apply a transformation to the swapchian if wanted to
-            .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, // use alpha channel for blending
-            .presentMode = Vulkan.swapchain_info.selected_present_mode,
-            .clipped = VK_TRUE, // remove ocluded, on screen pixels (if a window overlaps for example),
-            .oldSwapchain = VK_NULL_HANDLE // Only used if we need to re create the swapchan, for example a resize
-        };
-
-        VK_OK(vkCreateSwapchainKHR(Vulkan.device, 
-                                   &create_info, 
-                                   NULL, 
-                                   &Vulkan.swapchain), 
-              "Swapchain creation");
-    }
-
-    // ===================================
-    // GET IMAGES FROM SWAPCHAIN =========
-    // ===================================
-    {
-        vkGetSwapchainImagesKHR(Vulkan.device, 
-                                Vulkan.swapchain, 
-                                &Vulkan.swapchain_images_count, 
-                                NULL);
-
-        Vulkan.swapchain_images = (VkImage*) malloc(sizeof(VkImage) * Vulkan.swapchain_images_count);
-
-        vkGetSwapchainImagesKHR(Vulkan.device, 
-                                Vulkan.swapchain, 
-                                &Vulkan.swapchain_images_count, 
-                                Vulkan.swapchain_images);
-    }
-
-
-    // ===================================
-    // CREATE IMAGE VIEWS ================
-    // ===================================
-    {
-        Vulkan.swapchain_image_views = (VkImageView*) malloc(sizeof(VkImageView) * Vulkan.swapchain_images_count);
-
-        for(uint32_t i = 0; i < Vulkan.swapchain_images_count; i++) {
-            VkImageViewCreateInfo create_info = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .pNext = NULL,
-                .image = Vulkan.swapchain_images[i],
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format = Vulkan.swapchain_info.selected_format.format,
-                .components = { // Alter the was the RGBA channels are stored. Leave it as it comes
-                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .a = VK_COMPONENT_SWIZZLE_IDENTITY
-                },
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, // Wich aspect of the iamge are used, in this case just the color
-                    .baseMipLevel = 0,
-                    .levelCount = 1, // No need for mipmaping (for now) on the swapchain
-                    .baseArrayLayer = 0, // multiplelayers could be usefull for multiple perspectives rendered at the same time
-                    .layerCount = 1
-                }
-            };
-
-            VK_OK(vkCreateImageView(Vulkan.device, 
-                                    &create_info, 
-                                    NULL, 
-                                    &Vulkan.swapchain_image_views[i]),
-                 "Error creating image views of swapchain");
-        }
-    }
+    choose_swapchain_config(&Vulkan.swapchain_info,
+                            config.present_policy);
+    _create_swapchain(VK_NULL_HANDLE);
 }
 
 
@@ -350,7 +324,8 @@ bool check_validation_layers(const char** required_val_layers,
     uint32_t layer_count = 0;
     vkEnumerateInstanceLayerProperties(&layer_count, NULL);
 
-    VkLayerProperties* available_layers = (VkLayerProperties*) malloc(sizeof(VkLayerProperties) * layer_count);
+    sScratchScope scratch(get_scratch_allocator());
+    VkLayerProperties* available_layers = scratch.alloc_array<VkLayerProperties>(layer_count);
     vkEnumerateInstanceLayerProperties(&layer_count, available_layers);
 
     for(uint32_t i = 0; i < required_val_layer_count; i++) {
@@ -367,8 +342,6 @@ bool check_validation_layers(const char** required_val_layers,
             return false;
         }
     }
-    
-    free(available_layers);
 
     return true;
 }
@@ -397,7 +370,18 @@ void get_swapchain_info(const VkPhysicalDevice& device,
     vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &swapchain_info->present_modes_count, swapchain_info->present_modes);
 }
 
-void choose_swapchain_config(sSwapchainSupportInfo *swapchain_info) {
+static bool has_present_mode(const sSwapchainSupportInfo *swapchain_info,
+                             const VkPresentModeKHR present_mode) {
+    for(uint32_t i = 0; i < swapchain_info->present_modes_count; i++) {
+        if (swapchain_info->present_modes[i] == present_mode) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void choose_swapchain_config(sSwapchainSupportInfo *swapchain_info,
+                             const ePresentPolicy present_policy) {
     // SWAPCHAIN FORMAT =================
     // TODO: rank all the different available formats, and pick the best
     swapchain_info->selected_format = swapchain_info->formats[0]; // Choose the first one by default
@@ -410,18 +394,50 @@ void choose_swapchain_config(sSwapchainSupportInfo *swapchain_info) {
     }
 
     // SWAPCHAIN PRESENT MODE ====
+    // By preference for each policy, FIFO is the only one that is always there
+    VkPresentModeKHR candidates[2] = {};
+    uint32_t candidate_count = 0;
+    switch(present_policy) {
+        case PRESENT_POLICY_LOW_LATENCY:
+            candidates[candidate_count++] = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PRESENT_POLICY_FIFO_RELAXED:
+            candidates[candidate_count++] = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            break;
+        case PRESENT_POLICY_IMMEDIATE:
+            candidates[candidate_count++] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            candidates[candidate_count++] = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case PRESENT_POLICY_LOW_POWER:
+            break;
+    }
+
     swapchain_info->selected_present_mode = VK_PRESENT_MODE_FIFO_KHR;
-    for(uint32_t i = 0; i < swapchain_info->present_modes_count; i++) {
-        if (swapchain_info->present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            swapchain_info->selected_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    for(uint32_t i = 0; i < candidate_count; i++) {
+        if (has_present_mode(swapchain_info, candidates[i])) {
+            swapchain_info->selected_present_mode = candidates[i];
             break;
         }
     }
 }
 
-// TODO: VERY BAD NOT ACCOUNT FOR VERY HIGH PIXEL DENSITY SCREENS
-VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities) {
-    return capabilities.currentExtent;
+VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities,
+                                   GLFWwindow *window) {
+    if (capabilities.currentExtent.width != UINT32_MAX) {
+        return capabilities.currentExtent;
+    }
+
+    // The surface takes the size of the swapchain (Wayland), so use the framebuffer's
+    int width, height;
+    glfwGetFramebufferSize(window,
+                           &width,
+                           &height);
+    VkExtent2D extent = { .width = (uint32_t) width, .height = (uint32_t) height };
+    extent.width = (extent.width < capabilities.minImageExtent.width) ? capabilities.minImageExtent.width : extent.width;
+    extent.width = (extent.width > capabilities.maxImageExtent.width) ? capabilities.maxImageExtent.width : extent.width;
+    extent.height = (extent.height < capabilities.minImageExtent.height) ? capabilities.minImageExtent.height : extent.height;
+    extent.height = (extent.height > capabilities.maxImageExtent.height) ? capabilities.maxImageExtent.height : extent.height;
+    return extent;
 }
 
 
@@ -434,7 +450,8 @@ inline bool check_device_extension_support(const VkPhysicalDevice &device,
     uint32_t device_extension_count = 0;
     vkEnumerateDeviceExtensionProperties(device, NULL, &device_extension_count, NULL);
 
-    VkExtensionProperties *device_extensions = (VkExtensionProperties*) malloc(sizeof(VkExtensionProperties) * device_extension_count);
+    sScratchScope scratch(get_scratch_allocator());
+    VkExtensionProperties *device_extensions = scratch.alloc_array<VkExtensionProperties>(device_extension_count);
 
     vkEnumerateDeviceExtensionProperties(device, NULL, &device_extension_count, device_extensions);
 
@@ -450,11 +467,15 @@ inline bool check_device_extension_support(const VkPhysicalDevice &device,
         }       
     }
 
-    free(device_extensions);
-
     return extensions_available_count == required_extensions_count;
 }
 
+bool sApp::has_device_extension(const char *name) {
+    return check_device_extension_support(Vulkan.physical_device,
+                                          &name,
+                                          1);
+}
+
 bool is_device_suitable(const VkPhysicalDevice &device, 
                         const VkSurfaceKHR &surface, 
                         const char** required_extensions,
@@ -471,12 +492,21 @@ bool is_device_suitable(const VkPhysicalDevice &device,
     //    return false;
     //}
 
+    // Nothing found on a rejected device carries over to this one
+    *queues = {};
+
+    // Timeline semaphores are core (and mandatory) since Vulkan 1.2, all the sync relies on them
+    if (device_properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
     // Now check the the needed queue families
     uint32_t queue_family_count = 0;
 
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, NULL);
 
-    VkQueueFamilyProperties *queue_properties = (VkQueueFamilyProperties*) malloc(sizeof(VkQueueFamilyProperties) * queue_family_count); 
+    sScratchScope scratch(get_scratch_allocator());
+    VkQueueFamilyProperties *queue_properties = scratch.alloc_array<VkQueueFamilyProperties>(queue_family_count);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_properties);
 
     for(uint32_t i = 0; i < queue_family_count; i++) {
@@ -486,6 +516,14 @@ bool is_device_suitable(const VkPhysicalDevice &device,
             queues->has_found_graphics_family = true;
         }
 
+        // The first dedicated compute family, the async compute queue
+        if ((queue_properties[i].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(queue_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+            !queues->has_found_async_compute_family) {
+            queues->compute_family_id = i;
+            queues->has_found_async_compute_family = true;
+        }
+
         // Check for support for being able to present to the current VkSurface type
         VkBool32 present_support = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
@@ -495,7 +533,10 @@ bool is_device_suitable(const VkPhysicalDevice &device,
         }
     }
 
-    free(queue_properties);
+    // Graphics queues always support compute
+    if (!queues->has_found_async_compute_family) {
+        queues->compute_family_id = queues->graphics_family_id;
+    }
 
     bool extension_support = check_device_extension_support(device, required_extensions, required_extensions_count);
 
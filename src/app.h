@@ -18,25 +18,49 @@
 #include <GLFW/glfw3native.h>
 
 #include <cassert>
+#include <stdio.h>
 #include <iostream>
 
 #include "utils.h"
 #include "textures.h"
+#include "texture_loader.h"
+#include "app_config.h"
+#include "gpu_timeline.h"
+#include "deletion_queue.h"
+#include "async_compute.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define WINDOW_NAME   "Vulkan test"
 #define ENGINE_NAME   "No engine"
 
-#define MAX_FRAMES_IN_FLIGHT 2
-#define MAX_UNIFORM_BUFFERS 5 * MAX_FRAMES_IN_FLIGHT
-#define MAX_DESCRIPTOR_SETS 5 * MAX_FRAMES_IN_FLIGHT
+#include "mesh.h"
+#include "sprite_batcher.h"
+#include "geometry_pool.h"
+#include "worker_pool.h"
+#include "frustum_culling.h"
+#include "texture_streamer.h"
+#include "texture_atlas.h"
+#include "sampler_cache.h"
+#include "bindless.h"
+#include "tile_cache.h"
+#include "frame_pacer.h"
+#include "simulation.h"
+#include "render_graph.h"
+#include "dynamic_resolution.h"
+#include "linear_allocator.h"
+#include "heap_stats.h"
+#include "gpu_culling.h"
 
 struct sQueueFamilies {
     uint32_t graphics_family_id;
     bool has_found_graphics_family = false;
     uint32_t presenting_family_id;
     bool has_found_presenting_familiy = false;
+    // A compute family without graphics, so its work overlaps the rasterization.
+    // The graphics family otherwise
+    uint32_t compute_family_id;
+    bool has_found_async_compute_family = false;
 };
 
 struct sSwapchainSupportInfo {
@@ -60,29 +84,85 @@ struct sSwapchainSupportInfo {
 struct sApp {
     GLFWwindow *window = NULL;
 
-    sTexture texture;
+    sAppConfig config;
+
+    sSamplerCache    sampler_cache;
+    sTextureStreamer texture_streamer;
+    sTextureHandle   main_texture;
+
+    sSpriteBatcher sprite_batcher;
+
+    // Only with Vulkan.use_bindless, otherwise the texture goes on the per-frame sets
+    sBindlessTable bindless_table;
+
+    sGeometryPool geometry_pool;
+    sMeshHandle   quad_mesh;
+
+    sWorkerPool   worker_pool;
+
+    // The scene updates, on their own thread (see simulation.h)
+    sSimulation   simulation;
+
+    // Sleeps before each frame's input, and its stats (see frame_pacer.h)
+    sFramePacer   frame_pacer;
+
+    // The compute passes, on their own queue when there is one (see async_compute.h)
+    sAsyncCompute async_compute;
+
+    // Rebuilt each frame, its barriers & transient images (see render_graph.h)
+    sRenderGraph  render_graph;
+
+    // Scene render scale from the GPU time, and its upscale (see dynamic_resolution.h)
+    sDynamicResolution dynamic_resolution;
+
+    // Transient CPU data of the render thread's frame, reset after each one
+    sLinearAllocator frame_allocator;
+    // Heap allocations of the render thread during the last frame, and the most since the last stats
+    uint64_t      frame_heap_allocations = 0;
+    uint64_t      max_frame_heap_allocations = 0;
+
+    // Tiled image mode, instead of the quad: config.tiled_image_path
+    sTileCache      tile_cache;
+    sTiledImageView tiled_image_view;
+
+    // World space bounds of the scene, culled each frame against the camera
+    sCullingSet   culling_set;
+    uint32_t      quad_cull_id;
+    // The cull of the scene draws, on the async compute queue when there is one (see gpu_culling.h)
+    sGpuCulling   gpu_culling;
+    uint32_t      quad_draw_id;
 
     // Vulkan data
     struct {
         VkInstance instance;
         VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+        bool use_bindless = false; // Descriptor indexing support
+        bool use_present_wait = false; // VK_KHR_present_id & VK_KHR_present_wait support
+        bool use_synchronization2 = false; // VK_KHR_synchronization2 support, for the render graph barriers
         sQueueFamilies queues;
         VkDevice device; // logical device
 
         VkQueue  graphics_queue;
         VkQueue  present_queue;
+        std::mutex graphics_queue_mutex; // The texture streamer also submits on it
+        sGpuTimeline graphics_timeline; // Signaled by every submit on the graphics queue
+        sDeletionQueue deletion_queue; // The resources released mid-run, on the graphics timeline
         VkSurfaceKHR surface;
 
         sSwapchainSupportInfo swapchain_info;
         VkSwapchainKHR swapchain;
+        bool is_framebuffer_resized = false; // Set by the GLFW callback
+        bool is_swapchain_stale = false; // Minimized, there is no swapchain to render to
 
         VkPipeline graphics_pipeline;
+        VkPipeline sprite_pipeline;
         VkRenderPass render_pass;
 
         VkDescriptorSetLayout descriptor_set_layout;
+        VkSampler default_sampler; // Baked on the layout as an immutable sampler
         VkDescriptorPool descriptor_pool;
-        VkDescriptorSet  descriptor_sets[MAX_DESCRIPTOR_SETS];
-        uint32_t descriptor_sets_count = 0;
+        VkDescriptorSet  *descriptor_sets = NULL;
+        VkImageView *descriptor_texture_views = NULL; // What each frame's set points to
 
         VkPipelineLayout pipeline_layout;
 
@@ -95,23 +175,21 @@ struct sApp {
         uint32_t swapchain_images_index = 0;
 
         VkCommandPool command_pool;
-        VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
-
-        VkBuffer vertex_buffer;
-        VkDeviceMemory vertex_buffer_memmory;
-        VkBuffer index_buffer;
-        VkDeviceMemory index_buffer_memory;
 
+        // Everything per frame in flight is frame_count long, from config.frames_in_flight
+        uint32_t    frame_count = 0;
         uint32_t    current_frame = 0;
-        VkSemaphore image_available_semaphore[MAX_FRAMES_IN_FLIGHT];
-        VkSemaphore render_finished_semaphore[MAX_FRAMES_IN_FLIGHT];
-        VkFence in_flight_fence[MAX_FRAMES_IN_FLIGHT]; // ???
+        VkCommandBuffer *command_buffers = NULL;
+        // Binary, only for the swapchain
+        VkSemaphore *image_available_semaphore = NULL;
+        VkSemaphore *render_finished_semaphore = NULL;
+        // Of the graphics timeline, signaled by the last submit of each frame slot
+        uint64_t *frame_timeline_values = NULL;
 
         // Uniform buffers
-        VkBuffer uniform_buffers[MAX_UNIFORM_BUFFERS];
-        VkDeviceMemory uniform_buffers_memory[MAX_UNIFORM_BUFFERS];
-        void*   uniform_buffers_mapped[MAX_UNIFORM_BUFFERS];
-        uint32_t uniform_buffer_count = 0;
+        VkBuffer *uniform_buffers = NULL;
+        VkDeviceMemory *uniform_buffers_memory = NULL;
+        void*   *uniform_buffers_mapped = NULL;
 
         // Validation layers
         const char* required_validation_layers[2] = {
@@ -136,13 +214,34 @@ struct sApp {
     } Vulkan;
 
     void run() {
+        Vulkan.frame_count = config.frames_in_flight;
+        frame_allocator.init(FRAME_ALLOCATOR_SIZE);
+        worker_pool.init();
         _init_window();
         _init_vulkan();
         _create_descriptor_set_layout();
+        _create_bindless_table();
         _create_graphics_pipeline();
         _create_framebuffers();
         _create_command_buffers();
+        _open_tiled_image();
         _create_sync_objects();
+        frame_pacer.init(this,
+                         Vulkan.frame_count,
+                         config.target_fps);
+        render_graph.init(this);
+        async_compute.init(this,
+                           Vulkan.frame_count);
+        gpu_culling.init(this,
+                         &culling_set,
+                         Vulkan.frame_count);
+        quad_draw_id = gpu_culling.add_draw(quad_mesh,
+                                            quad_cull_id);
+        dynamic_resolution.init(this,
+                                Vulkan.frame_count,
+                                config.dynamic_resolution_target,
+                                config.upscale_filter);
+        simulation.start();
         _main_loop();
         _clean_up();
     };
@@ -156,7 +255,7 @@ struct sApp {
         glfwWindowHint(GLFW_CLIENT_API, 
                        GLFW_NO_API);
         glfwWindowHint(GLFW_RESIZABLE, 
-                       GLFW_FALSE);
+                       GLFW_TRUE);
 
         window = glfwCreateWindow(WINDOW_WIDTH, 
                                  WINDOW_HEIGHT, 
@@ -166,6 +265,18 @@ struct sApp {
 
         assert_msg(window != NULL, "Could not create window");
 
+        // For the callbacks
+        glfwSetWindowUserPointer(window,
+                                 this);
+
+        // The swapchain is recreated after the next present (see swapchain.cpp)
+        glfwSetFramebufferSizeCallback(window,
+                                       [](GLFWwindow *window,
+                                          int width,
+                                          int height) {
+                                            ((sApp*) glfwGetWindowUserPointer(window))->Vulkan.is_framebuffer_resized = true;
+                                        });
+
         glfwSetKeyCallback(window, 
                            [](GLFWwindow *window, 
                               int key, 
@@ -181,8 +292,25 @@ struct sApp {
 
     void _init_vulkan();
 
+    // Swapchain, its images & views (see swapchain.cpp)
+    void _create_swapchain(const VkSwapchainKHR &old_swapchain);
+    // On resizes & out of date swapchains, without waiting for the GPU
+    void _recreate_swapchain();
+
     void _create_descriptor_set_layout();
 
+    // Bindless textures (see bindless.cpp)
+    bool supports_descriptor_indexing();
+    void _create_bindless_table();
+
+    bool has_device_extension(const char *name);
+
+    // Frame pacing (see frame_pacer.cpp)
+    bool supports_present_wait();
+
+    // Render graph barriers (see render_graph.cpp)
+    bool supports_synchronization2();
+
     void _create_uniform_buffers();
 
     void _create_descriptor_pool_and_set();
@@ -193,23 +321,33 @@ struct sApp {
 
     void _create_command_buffers();
 
-    void _create_vertex_buffer();
+    void _create_geometry_pool();
 
-    void _create_index_buffer();
+    void _create_sprite_batcher();
 
     void _create_sync_objects();
 
+    // Tiled image mode (see tile_cache.cpp)
+    void _open_tiled_image();
+
     void _render_frame();
 
+    void _update_texture_descriptors();
+
 
     // TODO: clean shaders
     void _clean_up() {
-        for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        simulation.stop();
+
+        for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
             vkDestroySemaphore(Vulkan.device, Vulkan.image_available_semaphore[i], NULL);
             vkDestroySemaphore(Vulkan.device, Vulkan.render_finished_semaphore[i], NULL);
-            vkDestroyFence(Vulkan.device, Vulkan.in_flight_fence[i], NULL);
         }
+        free(Vulkan.image_available_semaphore);
+        free(Vulkan.render_finished_semaphore);
+        free(Vulkan.frame_timeline_values);
         vkDestroyCommandPool(Vulkan.device, Vulkan.command_pool, NULL);
+        free(Vulkan.command_buffers);
 
         for(uint32_t i = 0; i < Vulkan.framebuffers_count; i++) {
             vkDestroyFramebuffer(Vulkan.device, Vulkan.framebuffers[i], NULL);
@@ -217,35 +355,58 @@ struct sApp {
         free(Vulkan.framebuffers);
 
         vkDestroyPipeline(Vulkan.device, Vulkan.graphics_pipeline, nullptr);
+        vkDestroyPipeline(Vulkan.device, Vulkan.sprite_pipeline, nullptr);
         vkDestroyPipelineLayout(Vulkan.device, Vulkan.pipeline_layout, nullptr);
 
         vkDestroyRenderPass(Vulkan.device, Vulkan.render_pass, NULL);
 
         Vulkan.swapchain_info.clean();
 
-        for(uint32_t i = 0; i < Vulkan.uniform_buffer_count; i++) {
+        for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
             vkDestroyBuffer(Vulkan.device, Vulkan.uniform_buffers[i], NULL);
             vkFreeMemory(Vulkan.device, Vulkan.uniform_buffers_memory[i], NULL);
         }
+        free(Vulkan.uniform_buffers);
+        free(Vulkan.uniform_buffers_memory);
+        free(Vulkan.uniform_buffers_mapped);
 
         vkDestroyDescriptorPool(Vulkan.device, Vulkan.descriptor_pool, NULL);
+        free(Vulkan.descriptor_sets);
+        free(Vulkan.descriptor_texture_views);
 
         vkDestroyDescriptorSetLayout(Vulkan.device, Vulkan.descriptor_set_layout, NULL);
-
-        vkDestroyBuffer(Vulkan.device, Vulkan.vertex_buffer, NULL);
-        vkFreeMemory(Vulkan.device, Vulkan.vertex_buffer_memmory, NULL);
-
-        vkDestroyBuffer(Vulkan.device, Vulkan.index_buffer, NULL);
-        vkFreeMemory(Vulkan.device, Vulkan.index_buffer_memory, NULL);
+        if (Vulkan.use_bindless) {
+            bindless_table.cleanup();
+        }
+        sampler_cache.release(Vulkan.default_sampler);
+
+        geometry_pool.cleanup();
+
+        sprite_batcher.cleanup();
+
+        culling_set.clean();
+        // No decodes in flight after this
+        worker_pool.shutdown();
+        texture_streamer.cleanup();
+        frame_pacer.cleanup();
+        render_graph.cleanup();
+        gpu_culling.cleanup();
+        async_compute.cleanup();
+        dynamic_resolution.cleanup();
+        frame_allocator.cleanup();
+        if (tile_cache.is_open) {
+            tile_cache.cleanup();
+        }
+        // After every texture released its sampler
+        sampler_cache.cleanup();
 
         for(uint32_t i = 0; i < Vulkan.swapchain_images_count; i++) {
             vkDestroyImageView(Vulkan.device, Vulkan.swapchain_image_views[i], NULL);
         }
 
-        texture.cleanup();
-
-        vkDestroyBuffer(Vulkan.device, Vulkan.vertex_buffer, NULL);
         vkDestroySwapchainKHR(Vulkan.device, Vulkan.swapchain, NULL);
+        Vulkan.deletion_queue.flush();
+        Vulkan.graphics_timeline.cleanup();
         vkDestroyDevice(Vulkan.device, NULL);
         vkDestroySurfaceKHR(Vulkan.instance, Vulkan.surface, NULL);
         // TODO destroy the Utils messener: add it to the Vulkna struct
@@ -258,18 +419,57 @@ struct sApp {
     // ===============================
     // HELPER FUNCTIONS
     // ===============================
+    // Shared across queue families with CONCURRENT & their indices (see sAsyncCompute::get_sharing_mode)
     void create_buffer(const VkDeviceSize &size, 
                        const VkBufferUsageFlags usage,
                        const VkMemoryPropertyFlags memmory_properties, 
                        VkBuffer *buffer, 
-                       VkDeviceMemory *buffer_memory);
+                       VkDeviceMemory *buffer_memory,
+                       const VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE,
+                       const uint32_t family_count = 0,
+                       const uint32_t *family_indices = NULL);
     void copy_buffer(const VkBuffer &src_buffer, const VkBuffer dst_buffer, const VkDeviceSize size);
 
+    sMeshHandle upload_mesh(const Geometry::sVertex2D *vertices,
+                            const uint32_t vertex_count,
+                            const uint32_t *indices,
+                            const uint32_t index_count);
+
+    // Runs the mesh optimizer (see mesh_optimizer.h) before uploading
+    sMeshHandle import_mesh(const char *mesh_name,
+                            const Geometry::sVertex2D *vertices,
+                            const uint32_t vertex_count,
+                            const uint32_t *indices,
+                            const uint32_t index_count);
+
     void record_command_buffer(const VkCommandBuffer &command_buffer,
                            const VkRenderPass &render_pass,
                            const uint32_t image_index);
 
     void create_image(const char* image_name, sTexture *texture);
+    // The pixels can have 1 to 4 channels, the image is always RGBA8
+    void create_image_from_pixels(const uint8_t *raw_pixels, const uint32_t text_width, const uint32_t text_height, sTexture *texture, const uint32_t channel_count = 4);
+
+    // Uses a KTX2/DDS version of the image when there is one the GPU supports
+    void load_texture(const char *image_name, sTexture *texture);
+    // Thread safe, only reads files and queries the format support
+    bool find_compressed_texture(const char *image_name, sTextureFile *texture_file);
+    void create_compressed_image(const sTextureFile &texture_file, sTexture *texture);
+    bool is_texture_format_supported(const VkFormat format);
+    void _create_texture_image(const uint32_t width,
+                               const uint32_t height,
+                               const uint32_t mip_levels,
+                               const VkFormat format,
+                               const VkImageUsageFlags usage,
+                               const VkImageCreateFlags flags,
+                               VkImage *texture_image,
+                               VkDeviceMemory *texture_image_memory,
+                               const uint32_t array_layers = 1);
+
+    // Uploads the packed images of the builder as a 2D array (see texture_atlas.cpp).
+    // Without images the atlas is empty, with a layer_count of 0 and nothing to bind
+    void create_texture_atlas(const sAtlasBuilder &builder,
+                              sTextureAtlas *atlas);
 
     uint32_t find_memmory_type(const VkPhysicalDevice &phys_device,
                            const  uint32_t type_filter, 
@@ -279,12 +479,56 @@ struct sApp {
     void end_single_time_commands(const VkCommandBuffer &command_buffer);
 
     void copy_buffer_to_image(const VkBuffer &buffer, const VkImage &image, const uint32_t width, const uint32_t height,  const uint32_t depth);
-    void transition_image_layout(const VkImage &image, const VkFormat &format, const VkImageLayout &old_layout, const VkImageLayout &new_layout);
+    void transition_image_layout(const VkImage &image, const VkFormat &format, const VkImageLayout &old_layout, const VkImageLayout &new_layout, const uint32_t mip_levels = 1);
+
+    // Mipmaps (see mipmaps.cpp), the levels are left ready for sampling
+    bool supports_linear_blit(const VkFormat format);
+    bool supports_storage_image(const VkFormat format);
+    void generate_mipmaps(const VkImage &image, const VkFormat format, const uint32_t width, const uint32_t height, const uint32_t mip_levels);
+    void _generate_mipmaps_compute(const VkImage &image, const VkFormat format, const uint32_t width, const uint32_t height, const uint32_t mip_levels);
 
     void _main_loop() {
+        double last_stats_time = glfwGetTime();
         while(!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            // Minimized, sleep until something happens to the window
+            if (Vulkan.is_swapchain_stale) {
+                glfwWaitEvents();
+            } else {
+                // As late as the frame can start, so the input is fresh
+                frame_pacer.wait_for_next_frame();
+                glfwPollEvents();
+            }
+            const uint64_t heap_allocation_count = get_thread_heap_allocation_count();
             _render_frame();
+            frame_heap_allocations = get_thread_heap_allocation_count() - heap_allocation_count;
+            max_frame_heap_allocations = (frame_heap_allocations > max_frame_heap_allocations) ? frame_heap_allocations : max_frame_heap_allocations;
+
+            // Everything the frame allocated on it, at once
+            frame_allocator.reset();
+
+            // The pacing stats on the title, once per second
+            if (glfwGetTime() - last_stats_time > 1.0) {
+                last_stats_time = glfwGetTime();
+                const sFramePacerStats stats = frame_pacer.get_stats();
+                char title[256];
+                snprintf(title,
+                         sizeof(title),
+                         "%s - %.2f ms (jitter %.2f) cpu %.2f gpu %.2f (scene %.2f) latency %.2f%s (max %.2f) scale %d%% heap allocs %llu",
+                         WINDOW_NAME,
+                         stats.frame_interval,
+                         stats.jitter,
+                         stats.cpu_time,
+                         stats.gpu_time,
+                         stats.scene_gpu_time,
+                         stats.latency,
+                         (stats.is_latency_measured) ? "" : " est.",
+                         stats.max_latency,
+                         (int) (dynamic_resolution.get_scale() * 100.0f + 0.5f),
+                         (unsigned long long) max_frame_heap_allocations);
+                glfwSetWindowTitle(window,
+                                   title);
+                max_frame_heap_allocations = 0;
+            }
         }
 
         vkDeviceWaitIdle(Vulkan.device);
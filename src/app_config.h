@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "dynamic_resolution.h"
+
+// Bounds of the frame pipelining depth. One frame in flight is the lowest latency,
+// the CPU waits for the GPU each frame; more overlap them, at a frame of latency each
+#define MIN_FRAMES_IN_FLIGHT 1
+#define MAX_FRAMES_IN_FLIGHT 4
+
+enum ePresentPolicy : uint32_t {
+    PRESENT_POLICY_LOW_LATENCY = 0, // Mailbox, or FIFO without it
+    PRESENT_POLICY_LOW_POWER, // FIFO: vsync, the GPU idles between the frames
+    PRESENT_POLICY_FIFO_RELAXED, // FIFO, but a late frame tears instead of waiting for the next vblank
+    PRESENT_POLICY_IMMEDIATE // Immediate, tears: the lowest latency, only when asked for
+};
+
+// Chosen at startup, from the command line:
+//   [--frames 1-4] [--present latency|power|relaxed|immediate] [--fps N] [--no-async-compute] [--dynamic-resolution MS] [--upscale bilinear|sharpen] [tile pyramid file]
+struct sAppConfig {
+    uint32_t       frames_in_flight = 2;
+    ePresentPolicy present_policy = PRESENT_POLICY_LOW_LATENCY;
+    uint32_t       target_fps = 0; // Frame rate cap of the pacer, 0 is uncapped
+    bool           use_async_compute = true; // Off: the compute passes go to the graphics queue
+    double         dynamic_resolution_target = 0.0; // GPU frame time to hold, in ms, 0 renders at full size
+    eUpscaleFilter upscale_filter = UPSCALE_FILTER_BILINEAR;
+    // Tiled image mode, instead of the quad (see tools/tile_pyramid.cpp)
+    const char     *tiled_image_path = NULL;
+
+    // False (with the usage printed) on an unknown option
+    bool parse(const int argc,
+               char **argv) {
+        for(int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                frames_in_flight = (uint32_t) strtoul(argv[++i], NULL, 10);
+                if (frames_in_flight < MIN_FRAMES_IN_FLIGHT || frames_in_flight > MAX_FRAMES_IN_FLIGHT) {
+                    std::cout << "The frames in flight go from " << MIN_FRAMES_IN_FLIGHT << " to " << MAX_FRAMES_IN_FLIGHT << std::endl;
+                    return false;
+                }
+            } else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc) {
+                const char *policy = argv[++i];
+                if (strcmp(policy, "latency") == 0) {
+                    present_policy = PRESENT_POLICY_LOW_LATENCY;
+                } else if (strcmp(policy, "power") == 0) {
+                    present_policy = PRESENT_POLICY_LOW_POWER;
+                } else if (strcmp(policy, "relaxed") == 0) {
+                    present_policy = PRESENT_POLICY_FIFO_RELAXED;
+                } else if (strcmp(policy, "immediate") == 0) {
+                    present_policy = PRESENT_POLICY_IMMEDIATE;
+                } else {
+                    std::cout << "Unknown present policy " << policy << std::endl;
+                    return false;
+                }
+            } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+                target_fps = (uint32_t) strtoul(argv[++i], NULL, 10);
+            } else if (strcmp(argv[i], "--no-async-compute") == 0) {
+                use_async_compute = false;
+            } else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+                dynamic_resolution_target = strtod(argv[++i], NULL);
+            } else if (strcmp(argv[i], "--upscale") == 0 && i + 1 < argc) {
+                const char *filter = argv[++i];
+                if (strcmp(filter, "bilinear") == 0) {
+                    upscale_filter = UPSCALE_FILTER_BILINEAR;
+                } else if (strcmp(filter, "sharpen") == 0) {
+                    upscale_filter = UPSCALE_FILTER_SHARPEN;
+                } else {
+                    std::cout << "Unknown upscale filter " << filter << std::endl;
+                    return false;
+                }
+            } else if (argv[i][0] != '-' && tiled_image_path == NULL) {
+                tiled_image_path = argv[i];
+            } else {
+                std::cout << "Usage: " << argv[0] << " [--frames 1-4] [--present latency|power|relaxed|immediate] [--fps N] [--no-async-compute] [--dynamic-resolution MS] [--upscale bilinear|sharpen] [tile pyramid file]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+};
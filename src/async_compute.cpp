@@ -0,0 +1,151 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "async_compute.h"
+
+void sAsyncCompute::init(sApp *application,
+                         const uint32_t frames_in_flight) {
+    app = application;
+    frame_count = frames_in_flight;
+
+    const sQueueFamilies &families = app->Vulkan.queues;
+    is_async = families.has_found_async_compute_family;
+    family_id = families.compute_family_id;
+    family_indices[0] = families.graphics_family_id;
+    family_indices[1] = families.compute_family_id;
+    family_count = (is_async) ? 2 : 1;
+
+    if (is_async) {
+        vkGetDeviceQueue(app->Vulkan.device,
+                         family_id,
+                         0,
+                         &queue);
+        own_timeline.init(&app->Vulkan.device);
+        queue_mutex = &own_queue_mutex;
+        timeline = &own_timeline;
+    } else {
+        queue = app->Vulkan.graphics_queue;
+        queue_mutex = &app->Vulkan.graphics_queue_mutex;
+        timeline = &app->Vulkan.graphics_timeline;
+    }
+
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = family_id
+    };
+    VK_OK(vkCreateCommandPool(app->Vulkan.device,
+                              &pool_info,
+                              NULL,
+                              &command_pool),
+          "Create compute command pool");
+
+    command_buffers = (VkCommandBuffer*) malloc(sizeof(VkCommandBuffer) * frame_count);
+    frame_values = (uint64_t*) malloc(sizeof(uint64_t) * frame_count);
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = frame_count
+    };
+    VK_OK(vkAllocateCommandBuffers(app->Vulkan.device,
+                                   &alloc_info,
+                                   command_buffers),
+          "Allocate compute command buffers");
+    for(uint32_t i = 0; i < frame_count; i++) {
+        frame_values[i] = 0;
+    }
+
+    std::cout << "Compute passes on the " << ((is_async) ? "async compute" : "graphics") << " queue (family " << family_id << ")" << std::endl;
+}
+
+uint32_t sAsyncCompute::add_pass(const char *name,
+                                 AsyncComputePassFunction function,
+                                 void *data,
+                                 const VkPipelineStageFlags consumer_stages) {
+    assert_msg(pass_count < ASYNC_COMPUTE_MAX_PASSES, "Too many compute passes");
+    passes[pass_count] = {
+        .name = name,
+        .function = function,
+        .data = data,
+        .consumer_stages = consumer_stages
+    };
+    return pass_count++;
+}
+
+bool sAsyncCompute::submit_frame(const uint32_t frame,
+                                 sGpuTimelineWait *graphics_wait) {
+    if (pass_count == 0) {
+        return false;
+    }
+
+    // Already done when the frame slot was waited for, since that frame waited on it
+    timeline->wait(frame_values[frame]);
+
+    const VkCommandBuffer &command_buffer = command_buffers[frame];
+    vkResetCommandBuffer(command_buffer,
+                         0);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = NULL
+    };
+    VK_OK(vkBeginCommandBuffer(command_buffer,
+                               &begin_info),
+          "Begin compute command buffer");
+
+    VkPipelineStageFlags consumer_stages = 0;
+    for(uint32_t i = 0; i < pass_count; i++) {
+        passes[i].function(command_buffer,
+                           frame,
+                           passes[i].data);
+        consumer_stages |= passes[i].consumer_stages;
+    }
+
+    VK_OK(vkEndCommandBuffer(command_buffer),
+          "End compute command buffer");
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = NULL,
+        .pWaitDstStageMask = NULL,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = NULL
+    };
+    {
+        std::lock_guard<std::mutex> lock(*queue_mutex);
+        frame_values[frame] = timeline->submit(queue,
+                                               submit_info);
+    }
+
+    // On the fallback this is the graphics timeline itself: an earlier value of the same
+    // queue, the wait is only the memory dependency
+    *graphics_wait = {
+        .semaphore = timeline->semaphore,
+        .value = frame_values[frame],
+        .stages = (consumer_stages != 0) ? consumer_stages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+    };
+    return true;
+}
+
+void sAsyncCompute::cleanup() {
+    vkDestroyCommandPool(app->Vulkan.device, command_pool, NULL);
+    free(command_buffers);
+    free(frame_values);
+    if (is_async) {
+        own_timeline.cleanup();
+    }
+}
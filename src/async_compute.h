@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <mutex>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+#include "gpu_timeline.h"
+
+#define ASYNC_COMPUTE_MAX_PASSES 16
+
+struct sApp;
+
+typedef void (*AsyncComputePassFunction)(const VkCommandBuffer &command_buffer,
+                                         const uint32_t frame,
+                                         void *data);
+
+struct sAsyncComputePass {
+    const char               *name;
+    AsyncComputePassFunction function;
+    void                     *data;
+    // Of the graphics work that uses its results, the rest of the frame does not wait for it
+    VkPipelineStageFlags     consumer_stages;
+};
+
+// The compute passes (post effects, culling, simulations...) of each frame, on a queue of
+// a compute only family when the device has one, so they overlap the rasterization of the
+// previous frame. The frame's graphics submit waits on their timeline value, only on the
+// stages that consume the results. Without an async family (or with --no-async-compute)
+// they go to the graphics queue & timeline instead, with the same waits.
+// NOTE: the resources shared with the graphics queue take get_sharing_mode() & family_indices,
+// concurrent across both families when async, so no ownership transfers are needed.
+// The passes write the frame's copy of them: the slot is free once the frame slot is
+struct sAsyncCompute {
+    bool              is_async = false;
+    uint32_t          family_id;
+    uint32_t          family_indices[2]; // Graphics & compute, for the shared resources
+    uint32_t          family_count = 1;
+    VkQueue           queue;
+    std::mutex        *queue_mutex = NULL; // The graphics ones on the fallback
+    sGpuTimeline      *timeline = NULL;
+    std::mutex        own_queue_mutex;
+    sGpuTimeline      own_timeline;
+
+    VkCommandPool     command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer   *command_buffers = NULL; // Per frame
+    uint64_t          *frame_values = NULL; // Of each frame's submit, on the timeline
+    uint32_t          frame_count = 0;
+
+    sAsyncComputePass passes[ASYNC_COMPUTE_MAX_PASSES];
+    uint32_t          pass_count = 0;
+
+    sApp              *app = NULL;
+
+    void init(sApp *application,
+              const uint32_t frames_in_flight);
+
+    uint32_t add_pass(const char *name,
+                      AsyncComputePassFunction function,
+                      void *data,
+                      const VkPipelineStageFlags consumer_stages);
+
+    // Records & submits the frame's passes. False when there is nothing to run,
+    // otherwise the wait of the frame's graphics submit is written on graphics_wait
+    bool submit_frame(const uint32_t frame,
+                      sGpuTimelineWait *graphics_wait);
+
+    inline VkSharingMode get_sharing_mode() const {
+        return (is_async) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    // NOTE: once the device is idle
+    void cleanup();
+};
@@ -0,0 +1,151 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "bindless.h"
+
+bool sApp::supports_descriptor_indexing() {
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(Vulkan.physical_device,
+                                  &properties);
+    // Core on 1.2, the extension alone is not enabled
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing_features = {};
+    indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexing_features;
+    vkGetPhysicalDeviceFeatures2(Vulkan.physical_device,
+                                 &features);
+
+    return indexing_features.runtimeDescriptorArray &&
+           indexing_features.descriptorBindingPartiallyBound &&
+           indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+           indexing_features.descriptorBindingUpdateUnusedWhilePending;
+}
+
+void sApp::_create_bindless_table() {
+    if (!Vulkan.use_bindless) {
+        return;
+    }
+    bindless_table.device = &Vulkan.device;
+
+    // ===================================
+    // TABLE SIZE ========================
+    // ===================================
+    {
+        VkPhysicalDeviceDescriptorIndexingProperties indexing_properties = {};
+        indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexing_properties;
+        vkGetPhysicalDeviceProperties2(Vulkan.physical_device,
+                                       &properties);
+
+        uint32_t capacity = BINDLESS_MAX_TEXTURES;
+        if (indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages < capacity) {
+            capacity = indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages;
+        }
+        if (indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages < capacity) {
+            capacity = indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages;
+        }
+        // Combined image samplers: each slot is a sampler too
+        if (indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers < capacity) {
+            capacity = indexing_properties.maxPerStageDescriptorUpdateAfterBindSamplers;
+        }
+        if (indexing_properties.maxDescriptorSetUpdateAfterBindSamplers < capacity) {
+            capacity = indexing_properties.maxDescriptorSetUpdateAfterBindSamplers;
+        }
+        // Shared with the other fragment stage resources: the texture of set 0
+        if (indexing_properties.maxPerStageUpdateAfterBindResources < capacity + 1) {
+            capacity = indexing_properties.maxPerStageUpdateAfterBindResources - 1;
+        }
+        bindless_table.capacity = capacity;
+        bindless_table._init_slots(Vulkan.frame_count);
+    }
+
+    // ===================================
+    // LAYOUT ============================
+    // ===================================
+    {
+        VkDescriptorSetLayoutBinding binding = {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = bindless_table.capacity,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = NULL, // Each texture brings its own, from the sampler cache
+        };
+
+        // Not every slot is written, and they can be written after the bind
+        VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                 VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                 VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .pNext = NULL,
+            .bindingCount = 1,
+            .pBindingFlags = &binding_flags
+        };
+
+        VkDescriptorSetLayoutCreateInfo layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &binding_flags_info,
+            .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            .bindingCount = 1,
+            .pBindings = &binding
+        };
+
+        VK_OK(vkCreateDescriptorSetLayout(Vulkan.device,
+                                          &layout_create_info,
+                                          NULL,
+                                          &bindless_table.layout),
+              "Create bindless set layout");
+    }
+
+    // ===================================
+    // POOL & SET ========================
+    // ===================================
+    {
+        VkDescriptorPoolSize pool_size = {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = bindless_table.capacity
+        };
+
+        VkDescriptorPoolCreateInfo pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size,
+        };
+
+        VK_OK(vkCreateDescriptorPool(Vulkan.device,
+                                     &pool_create_info,
+                                     NULL,
+                                     &bindless_table.pool),
+              "Create bindless descriptor pool");
+
+        VkDescriptorSetAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = NULL,
+            .descriptorPool = bindless_table.pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &bindless_table.layout
+        };
+
+        VK_OK(vkAllocateDescriptorSets(Vulkan.device,
+                                       &alloc_info,
+                                       &bindless_table.set),
+              "Allocate bindless descriptor set");
+    }
+}
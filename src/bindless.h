@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+
+// Upper bound of the texture array, clamped to the device's update-after-bind limits
+#define BINDLESS_MAX_TEXTURES 4096
+// The bindless set goes after the per-frame UBO set
+#define BINDLESS_SET_INDEX    1
+#define BINDLESS_INVALID_SLOT UINT32_MAX
+
+// Pushed per draw instead of binding a descriptor set, see resources/shaders/bindless.frag
+struct sBindlessPushConstants {
+    uint32_t texture_index;
+};
+
+// One big, partially bound array of combined image samplers (VK_EXT_descriptor_indexing,
+// core on Vulkan 1.2). It is bound once per command buffer, and the draws select the
+// texture by index. Since the set is update-after-bind, the slots can be written while
+// frames that use other slots are still in flight
+struct sBindlessTable {
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool      pool;
+    VkDescriptorSet       set;
+    uint32_t              capacity = 0;
+
+    // Free list of slots, plus the slots released on each frame: they may still
+    // be read by that frame's commands, so they are recycled on its next begin_frame
+    uint32_t              *free_slots = NULL;
+    uint32_t              free_count = 0;
+    uint32_t              *retired_slots = NULL; // capacity per frame
+    uint32_t              *retired_counts = NULL;
+    uint32_t              frame_count = 0;
+    uint32_t              frame_index = 0;
+
+    VkDevice              *device = NULL;
+
+    void _init_slots(const uint32_t frames_in_flight) {
+        frame_count = frames_in_flight;
+        free_slots = (uint32_t*) malloc(sizeof(uint32_t) * capacity);
+        // Reversed, so the lower slots are handed out first
+        for(uint32_t i = 0; i < capacity; i++) {
+            free_slots[i] = capacity - 1 - i;
+        }
+        free_count = capacity;
+
+        retired_slots = (uint32_t*) malloc(sizeof(uint32_t) * capacity * frame_count);
+        retired_counts = (uint32_t*) calloc(frame_count, sizeof(uint32_t));
+    }
+
+    // After waiting for the frame's timeline value
+    void begin_frame(const uint32_t current_frame) {
+        frame_index = current_frame;
+        const uint32_t *retired = &retired_slots[frame_index * capacity];
+        for(uint32_t i = 0; i < retired_counts[frame_index]; i++) {
+            free_slots[free_count++] = retired[i];
+        }
+        retired_counts[frame_index] = 0;
+    }
+
+    void write(const uint32_t slot,
+               const VkImageView &view,
+               const VkSampler &sampler) {
+        VkDescriptorImageInfo image_info = {
+            .sampler = sampler,
+            .imageView = view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+
+        VkWriteDescriptorSet descriptor_write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = set,
+            .dstBinding = 0,
+            .dstArrayElement = slot,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &image_info,
+            .pBufferInfo = NULL,
+            .pTexelBufferView = NULL
+        };
+
+        vkUpdateDescriptorSets(*device,
+                               1,
+                               &descriptor_write,
+                               0,
+                               NULL);
+    }
+
+    // NOTE: only from the render thread, like the rest of the descriptor updates
+    // BINDLESS_INVALID_SLOT when the table is full
+    uint32_t allocate(const VkImageView &view,
+                      const VkSampler &sampler) {
+        if (free_count == 0) {
+            return BINDLESS_INVALID_SLOT;
+        }
+        const uint32_t slot = free_slots[--free_count];
+        write(slot, view, sampler);
+        return slot;
+    }
+
+    void release(const uint32_t slot) {
+        retired_slots[frame_index * capacity + retired_counts[frame_index]++] = slot;
+    }
+
+    void cleanup() {
+        vkDestroyDescriptorPool(*device, pool, NULL);
+        vkDestroyDescriptorSetLayout(*device, layout, NULL);
+        free(free_slots);
+        free(retired_slots);
+        free(retired_counts);
+    }
+};
@@ -0,0 +1,117 @@
+#include "deletion_queue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <vulkan/vulkan_core.h>
+
+void sDeletionQueue::push(const VkObjectType type,
+                          const uint64_t handle) {
+    if (handle == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Not an assert: on release builds it would overwrite the head, leaking it.
+    // Full, so wait for the oldest entry, unless the frame being recorded still uses it
+    if (count == DELETION_QUEUE_CAPACITY) {
+        if (sealed_count == 0) {
+            std::cout << "Deletion queue is full, of " << DELETION_QUEUE_CAPACITY << " entries released this frame" << std::endl;
+            abort();
+        }
+
+        timeline->wait(entries[head].timeline_value);
+        _destroy(entries[head]);
+        head = (head + 1) % DELETION_QUEUE_CAPACITY;
+        count--;
+        sealed_count--;
+    }
+    entries[(head + count) % DELETION_QUEUE_CAPACITY] = {
+        .type = type,
+        .handle = handle,
+        .timeline_value = DELETION_QUEUE_UNSEALED
+    };
+    count++;
+}
+
+void sDeletionQueue::seal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sealed_count == count) {
+        return;
+    }
+
+    // The other threads push after their own submits, so this covers them too
+    const uint64_t value = timeline->last_submitted.load(std::memory_order_acquire);
+    for(; sealed_count < count; sealed_count++) {
+        entries[(head + sealed_count) % DELETION_QUEUE_CAPACITY].timeline_value = value;
+    }
+}
+
+void sDeletionQueue::collect(const uint32_t max_count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(uint32_t i = 0; i < max_count && sealed_count > 0; i++) {
+        const sDeletion &deletion = entries[head];
+        if (!timeline->is_complete(deletion.timeline_value)) {
+            break;
+        }
+
+        _destroy(deletion);
+        head = (head + 1) % DELETION_QUEUE_CAPACITY;
+        count--;
+        sealed_count--;
+    }
+}
+
+void sDeletionQueue::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(; count > 0; count--) {
+        _destroy(entries[head]);
+        head = (head + 1) % DELETION_QUEUE_CAPACITY;
+    }
+    sealed_count = 0;
+}
+
+void sDeletionQueue::_destroy(const sDeletion &deletion) {
+    switch(deletion.type) {
+        case VK_OBJECT_TYPE_BUFFER:
+            vkDestroyBuffer(*device, (VkBuffer) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_IMAGE:
+            vkDestroyImage(*device, (VkImage) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+            vkDestroyImageView(*device, (VkImageView) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+            vkFreeMemory(*device, (VkDeviceMemory) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+            vkDestroyFramebuffer(*device, (VkFramebuffer) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+            vkDestroySwapchainKHR(*device, (VkSwapchainKHR) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE:
+            vkDestroyPipeline(*device, (VkPipeline) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+            vkDestroyPipelineLayout(*device, (VkPipelineLayout) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            vkDestroyShaderModule(*device, (VkShaderModule) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_SAMPLER:
+            vkDestroySampler(*device, (VkSampler) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+            vkDestroyDescriptorPool(*device, (VkDescriptorPool) deletion.handle, NULL);
+            break;
+        case VK_OBJECT_TYPE_QUERY_POOL:
+            vkDestroyQueryPool(*device, (VkQueryPool) deletion.handle, NULL);
+            break;
+        default:
+            assert_msg(false, "Deletion of an unsupported object type " << deletion.type);
+    }
+}
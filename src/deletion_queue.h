@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <mutex>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+#include "gpu_timeline.h"
+
+#define DELETION_QUEUE_CAPACITY      1024
+// Destroys per collect(), so a big release (a resize, a streaming burst) is spread over frames
+#define DELETION_QUEUE_MAX_PER_FRAME 64
+// Not sealed yet: the frame being recorded may still use it
+#define DELETION_QUEUE_UNSEALED      UINT64_MAX
+
+struct sDeletion {
+    VkObjectType type;
+    uint64_t     handle; // The Vulkan handle, as on VkDebugUtilsObjectNameInfoEXT
+    uint64_t     timeline_value;
+};
+
+// Resources released mid-run, destroyed once the GPU is past every submit that could
+// use them, without waiting for the device. A push is sealed with the graphics timeline's
+// last value by the next seal(), after the frame that may still reference it is submitted,
+// so a release while recording is safe. FIFO, so the values only grow from head to tail,
+// and the push order is kept (the views before their image, the memory last...)
+struct sDeletionQueue {
+    sDeletion    entries[DELETION_QUEUE_CAPACITY];
+    uint32_t     head = 0;
+    uint32_t     count = 0;
+    uint32_t     sealed_count = 0; // From the head
+
+    std::mutex   mutex; // The streaming threads also release
+
+    VkDevice     *device = NULL;
+    sGpuTimeline *timeline = NULL;
+
+    void init(VkDevice *vk_device,
+              sGpuTimeline *gpu_timeline) {
+        device = vk_device;
+        timeline = gpu_timeline;
+    }
+
+    // From any thread. When full, waits for the GPU to be done with the oldest entry
+    void push(const VkObjectType type,
+              const uint64_t handle);
+
+    // After the frame's submit
+    void seal();
+
+    // Destroys up to max_count of the entries the GPU is done with
+    void collect(const uint32_t max_count = DELETION_QUEUE_MAX_PER_FRAME);
+
+    // NOTE: once the device is idle, everything
+    void flush();
+
+    void _destroy(const sDeletion &deletion);
+};
@@ -0,0 +1,408 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "dynamic_resolution.h"
+#include "shader.h"
+
+// Of the sharpen filter, on the upscale.frag unsharp mask
+#define UPSCALE_SHARPNESS 0.5f
+
+void sDynamicResolution::init(sApp *application,
+                              const uint32_t frames_in_flight,
+                              const double target_ms,
+                              const eUpscaleFilter upscale_filter) {
+    app = application;
+    frame_count = frames_in_flight;
+    is_enabled = target_ms > 0.0;
+    filter = upscale_filter;
+    controller.target_time = target_ms / 1000.0;
+
+    if (!is_enabled) {
+        return;
+    }
+
+    VkDevice device = app->Vulkan.device;
+
+    // Clamped, the texels past the rendered part are never blended in (see upscale.frag)
+    VkSamplerCreateInfo sampler_create_info = app->sampler_cache.default_create_info();
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.anisotropyEnable = VK_FALSE;
+    sampler_create_info.maxAnisotropy = 1.0f;
+    sampler_create_info.maxLod = 0.0f;
+    sampler = app->sampler_cache.acquire(sampler_create_info);
+
+    // ===============================
+    // DESCRIPTOR SETS ===============
+    // ===============================
+    {
+        VkDescriptorSetLayoutBinding binding = {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = &sampler // The sampler on the writes is ignored
+        };
+        VkDescriptorSetLayoutCreateInfo layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .bindingCount = 1,
+            .pBindings = &binding
+        };
+        VK_OK(vkCreateDescriptorSetLayout(device,
+                                          &layout_create_info,
+                                          NULL,
+                                          &descriptor_set_layout),
+              "Create upscale descriptor set layout");
+
+        VkDescriptorPoolSize pool_size = {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = frame_count
+        };
+        VkDescriptorPoolCreateInfo pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .maxSets = frame_count,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size
+        };
+        VK_OK(vkCreateDescriptorPool(device,
+                                     &pool_create_info,
+                                     NULL,
+                                     &descriptor_pool),
+              "Create upscale descriptor pool");
+
+        descriptor_sets = (VkDescriptorSet*) malloc(sizeof(VkDescriptorSet) * frame_count);
+        descriptor_generations = (uint64_t*) malloc(sizeof(uint64_t) * frame_count);
+        VkDescriptorSetLayout *set_layouts = (VkDescriptorSetLayout*) malloc(sizeof(VkDescriptorSetLayout) * frame_count);
+        for(uint32_t i = 0; i < frame_count; i++) {
+            set_layouts[i] = descriptor_set_layout;
+            descriptor_generations[i] = 0;
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = NULL,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = frame_count,
+            .pSetLayouts = set_layouts
+        };
+        VK_OK(vkAllocateDescriptorSets(device,
+                                       &alloc_info,
+                                       descriptor_sets),
+              "Allocate upscale descriptor sets");
+        free(set_layouts);
+    }
+
+    // ===============================
+    // PIPELINE ======================
+    // ===============================
+    {
+        VkPushConstantRange push_constant_range = {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(sUpscalePushConstants)
+        };
+        VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .setLayoutCount = 1,
+            .pSetLayouts = &descriptor_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range
+        };
+        VK_OK(vkCreatePipelineLayout(device,
+                                     &pipeline_layout_create_info,
+                                     NULL,
+                                     &pipeline_layout),
+              "Create upscale pipeline layout");
+
+        VkShaderModule vert_shader, frag_shader;
+        create_shader_module(device,
+                             "resources/shaders/upscale_vert.spv",
+                             &vert_shader);
+        create_shader_module(device,
+                             "resources/shaders/upscale_frag.spv",
+                             &frag_shader);
+
+        VkPipelineShaderStageCreateInfo shader_stages[2];
+        shader_stages[0] = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vert_shader,
+            .pName = "main"
+        };
+        shader_stages[1] = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = NULL,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = frag_shader,
+            .pName = "main"
+        };
+
+        // A fullscreen triangle from the vertex index, no vertex buffer
+        VkPipelineVertexInputStateCreateInfo vertex_input = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .vertexBindingDescriptionCount = 0,
+            .pVertexBindingDescriptions = NULL,
+            .vertexAttributeDescriptionCount = 0,
+            .pVertexAttributeDescriptions = NULL
+        };
+        VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .primitiveRestartEnable = VK_FALSE
+        };
+
+        // Set on record
+        VkDynamicState dynamic_states[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamic_state = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .dynamicStateCount = 2,
+            .pDynamicStates = dynamic_states
+        };
+        VkPipelineViewportStateCreateInfo viewport_state = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .viewportCount = 1,
+            .pViewports = NULL,
+            .scissorCount = 1,
+            .pScissors = NULL
+        };
+
+        VkPipelineRasterizationStateCreateInfo rasterizer_state = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .depthClampEnable = VK_FALSE,
+            .rasterizerDiscardEnable = VK_FALSE,
+            .polygonMode = VK_POLYGON_MODE_FILL,
+            .cullMode = VK_CULL_MODE_NONE,
+            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            .depthBiasEnable = VK_FALSE,
+            .depthBiasConstantFactor = 0.0f,
+            .depthBiasClamp = 0.0f,
+            .depthBiasSlopeFactor = 0.0f,
+            .lineWidth = 1.0f
+        };
+        VkPipelineMultisampleStateCreateInfo multisampling = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+            .sampleShadingEnable = VK_FALSE,
+            .minSampleShading = 1.0f,
+            .pSampleMask = NULL,
+            .alphaToCoverageEnable = VK_FALSE,
+            .alphaToOneEnable = VK_FALSE
+        };
+
+        VkPipelineColorBlendAttachmentState color_blend_attachment = {
+            .blendEnable = VK_FALSE,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+        };
+        VkPipelineColorBlendStateCreateInfo color_blend = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            .pNext = NULL,
+            .logicOpEnable = VK_FALSE,
+            .logicOp = VK_LOGIC_OP_COPY,
+            .attachmentCount = 1,
+            .pAttachments = &color_blend_attachment,
+            .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
+        };
+
+        // On the main render pass: same format, and the swapchain framebuffers
+        VkGraphicsPipelineCreateInfo pipeline_create_info = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .stageCount = 2,
+            .pStages = shader_stages,
+            .pVertexInputState = &vertex_input,
+            .pInputAssemblyState = &input_assembly,
+            .pViewportState = &viewport_state,
+            .pRasterizationState = &rasterizer_state,
+            .pMultisampleState = &multisampling,
+            .pDepthStencilState = NULL,
+            .pColorBlendState = &color_blend,
+            .pDynamicState = &dynamic_state,
+            .layout = pipeline_layout,
+            .renderPass = app->Vulkan.render_pass,
+            .subpass = 0,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1
+        };
+        VK_OK(vkCreateGraphicsPipelines(device,
+                                        NULL,
+                                        1,
+                                        &pipeline_create_info,
+                                        NULL,
+                                        &pipeline),
+              "Create upscale pipeline");
+
+        vkDestroyShaderModule(device, vert_shader, NULL);
+        vkDestroyShaderModule(device, frag_shader, NULL);
+    }
+
+    std::cout << "Dynamic resolution: " << target_ms << " ms GPU target, " << ((filter == UPSCALE_FILTER_SHARPEN) ? "sharpen" : "bilinear") << " upscale" << std::endl;
+}
+
+VkFramebuffer sDynamicResolution::get_framebuffer(const VkImageView &scene_view,
+                                                  const uint64_t transient_generation,
+                                                  const VkExtent2D &extent) {
+    if (transient_generation == framebuffer_generation) {
+        return framebuffer;
+    }
+
+    // The transient was remade (resize, or the graph changed), the old one may be in flight
+    if (framebuffer != VK_NULL_HANDLE) {
+        app->Vulkan.deletion_queue.push(VK_OBJECT_TYPE_FRAMEBUFFER,
+                                        (uint64_t) framebuffer);
+    }
+
+    VkFramebufferCreateInfo framebuffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .pNext = NULL,
+        .renderPass = app->Vulkan.render_pass,
+        .attachmentCount = 1,
+        .pAttachments = &scene_view,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1
+    };
+    VK_OK(vkCreateFramebuffer(app->Vulkan.device,
+                              &framebuffer_create_info,
+                              NULL,
+                              &framebuffer),
+          "Create scene target framebuffer");
+    framebuffer_generation = transient_generation;
+
+    return framebuffer;
+}
+
+void sDynamicResolution::record_upscale(const VkCommandBuffer &command_buffer,
+                                        const uint32_t frame,
+                                        const VkImageView &scene_view,
+                                        const uint64_t transient_generation,
+                                        const VkExtent2D &scene_extent,
+                                        const VkExtent2D &render_extent) {
+    // The frame slot is done on the GPU, so its set can be rewritten
+    if (descriptor_generations[frame] != transient_generation) {
+        VkDescriptorImageInfo image_info = {
+            .sampler = VK_NULL_HANDLE,
+            .imageView = scene_view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        };
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = NULL,
+            .dstSet = descriptor_sets[frame],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &image_info,
+            .pBufferInfo = NULL,
+            .pTexelBufferView = NULL
+        };
+        vkUpdateDescriptorSets(app->Vulkan.device,
+                               1,
+                               &write,
+                               0,
+                               NULL);
+        descriptor_generations[frame] = transient_generation;
+    }
+
+    vkCmdBindPipeline(command_buffer,
+                      VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline);
+
+    const VkExtent2D &output_extent = app->Vulkan.swapchain_info.swapchain_extent;
+    VkViewport viewport = {
+        .x = 0.0f, .y = 0.0f,
+        .width = (float) output_extent.width,
+        .height = (float) output_extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = output_extent
+    };
+    vkCmdSetViewport(command_buffer,
+                     0,
+                     1,
+                     &viewport);
+    vkCmdSetScissor(command_buffer,
+                    0,
+                    1,
+                    &scissor);
+
+    vkCmdBindDescriptorSets(command_buffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline_layout,
+                            0,
+                            1,
+                            &descriptor_sets[frame],
+                            0,
+                            NULL);
+
+    const sUpscalePushConstants push_constants = {
+        .uv_scale = glm::vec2((float) render_extent.width / scene_extent.width,
+                              (float) render_extent.height / scene_extent.height),
+        .texel_size = glm::vec2(1.0f / scene_extent.width,
+                                1.0f / scene_extent.height),
+        .sharpness = (filter == UPSCALE_FILTER_SHARPEN) ? UPSCALE_SHARPNESS : 0.0f
+    };
+    vkCmdPushConstants(command_buffer,
+                       pipeline_layout,
+                       VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0,
+                       sizeof(sUpscalePushConstants),
+                       &push_constants);
+
+    vkCmdDraw(command_buffer,
+              3,
+              1,
+              0,
+              0);
+}
+
+void sDynamicResolution::cleanup() {
+    if (!is_enabled) {
+        return;
+    }
+
+    VkDevice device = app->Vulkan.device;
+    if (framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(device, framebuffer, NULL);
+        framebuffer = VK_NULL_HANDLE;
+        framebuffer_generation = 0;
+    }
+    vkDestroyPipeline(device, pipeline, NULL);
+    vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, NULL);
+    app->sampler_cache.release(sampler);
+
+    free(descriptor_sets);
+    free(descriptor_generations);
+    descriptor_sets = NULL;
+    descriptor_generations = NULL;
+}
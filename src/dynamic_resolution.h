@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <math.h>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "utils.h"
+
+struct sApp;
+
+// Bounds & steps of the render scale, per axis. Quantized, so the noise of the
+// GPU timings does not turn into a different resolution every frame
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+#define DYNAMIC_RESOLUTION_SCALE_STEP 0.05f
+// Of the GPU timings, for the exponential average
+#define DYNAMIC_RESOLUTION_SMOOTHING 0.15
+// Fraction of the target aimed at when shrinking, and needed under it to grow
+#define DYNAMIC_RESOLUTION_HEADROOM 0.85
+// Frames in a row under the headroom before a step up
+#define DYNAMIC_RESOLUTION_GROW_FRAMES 30
+// After a change: the frames in flight still measure the old scale
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 4
+
+enum eUpscaleFilter : uint32_t {
+    UPSCALE_FILTER_BILINEAR = 0,
+    UPSCALE_FILTER_SHARPEN // Bilinear, and a clamped unsharp mask to get back some of the lost detail
+};
+
+// Same layout as the upscale.frag push constants
+struct sUpscalePushConstants {
+    glm::vec2 uv_scale; // Rendered part of the scene target
+    glm::vec2 texel_size; // Of the scene target
+    float     sharpness; // 0 is plain bilinear
+};
+
+// Picks the render scale from the measured GPU frame times, in seconds. The cost is
+// taken as proportional to the pixels (scale²). Over the target it shrinks right away,
+// to fit with some headroom; it only grows one step at a time, after a while under the
+// headroom, and when the larger step is predicted to fit. Between the two it holds,
+// so it does not oscillate around the target
+struct sResolutionController {
+    double   target_time = 0.0;
+    float    scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    double   filtered_time = 0.0;
+    bool     has_sample = false;
+    uint32_t frames_under = 0;
+    uint32_t settle_frames = 0;
+
+    inline float quantize(const float value) const {
+        const float steps = floorf(value / DYNAMIC_RESOLUTION_SCALE_STEP + 0.001f);
+        const float quantized = steps * DYNAMIC_RESOLUTION_SCALE_STEP;
+        if (quantized < DYNAMIC_RESOLUTION_MIN_SCALE) {
+            return DYNAMIC_RESOLUTION_MIN_SCALE;
+        }
+        return (quantized > DYNAMIC_RESOLUTION_MAX_SCALE) ? DYNAMIC_RESOLUTION_MAX_SCALE : quantized;
+    }
+
+    // True when the scale changed
+    inline bool update(const double gpu_time) {
+        if (gpu_time <= 0.0) {
+            return false;
+        }
+        if (settle_frames > 0) {
+            settle_frames--;
+            return false;
+        }
+
+        filtered_time = (has_sample) ? filtered_time + (gpu_time - filtered_time) * DYNAMIC_RESOLUTION_SMOOTHING : gpu_time;
+        has_sample = true;
+
+        float new_scale = scale;
+        if (filtered_time > target_time) {
+            // Down to the scale that fits on the headroom
+            new_scale = quantize(scale * (float) sqrt(target_time * DYNAMIC_RESOLUTION_HEADROOM / filtered_time));
+            frames_under = 0;
+        } else if (filtered_time < target_time * DYNAMIC_RESOLUTION_HEADROOM) {
+            frames_under++;
+            const float grown_scale = quantize(scale + DYNAMIC_RESOLUTION_SCALE_STEP);
+            const double grown_time = filtered_time * (grown_scale * grown_scale) / (scale * scale);
+            if (frames_under >= DYNAMIC_RESOLUTION_GROW_FRAMES && grown_time < target_time) {
+                new_scale = grown_scale;
+                frames_under = 0;
+            }
+        } else {
+            frames_under = 0;
+        }
+
+        if (new_scale == scale) {
+            return false;
+        }
+
+        // Restart the average on the new scale
+        scale = new_scale;
+        has_sample = false;
+        settle_frames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+        return true;
+    }
+};
+
+// The scene renders to a target of the swapchain size, but only on its top left part,
+// scaled by the controller; the upscale pass stretches that part to the swapchain image.
+// The target never changes size with the scale, so it stays the same render graph
+// transient (and framebuffer) from frame to frame
+struct sDynamicResolution {
+    bool                  is_enabled = false;
+    eUpscaleFilter        filter = UPSCALE_FILTER_BILINEAR;
+    sResolutionController controller;
+
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool      descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet       *descriptor_sets = NULL; // Per frame
+    uint64_t              *descriptor_generations = NULL; // Of the transients each frame's set points to, 0 for none
+    uint32_t              frame_count = 0;
+    VkSampler             sampler = VK_NULL_HANDLE;
+    VkPipelineLayout      pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline            pipeline = VK_NULL_HANDLE;
+
+    // Of the scene target, remade when its transient image is
+    VkFramebuffer         framebuffer = VK_NULL_HANDLE;
+    uint64_t              framebuffer_generation = 0; // See sRenderGraph::transient_generation
+
+    sApp                  *app = NULL;
+
+    // Off with a target of 0 ms
+    void init(sApp *application,
+              const uint32_t frames_in_flight,
+              const double target_ms,
+              const eUpscaleFilter upscale_filter);
+
+    // With the GPU time of the scene pass (see sFramePacer::record_scene_begin), before the frame is recorded
+    inline bool update(const double gpu_time) {
+        return is_enabled && controller.update(gpu_time);
+    }
+
+    inline float get_scale() const {
+        return (is_enabled) ? controller.scale : 1.0f;
+    }
+
+    inline VkExtent2D get_render_extent(const VkExtent2D &extent) const {
+        const float scale = get_scale();
+        const uint32_t width = (uint32_t) (extent.width * scale);
+        const uint32_t height = (uint32_t) (extent.height * scale);
+        return {
+            .width = (width > 0) ? width : 1,
+            .height = (height > 0) ? height : 1
+        };
+    }
+
+    // For the scene target's view, on the render pass of the main pass.
+    // With the graph's transient generation the view belongs to
+    VkFramebuffer get_framebuffer(const VkImageView &scene_view,
+                                  const uint64_t transient_generation,
+                                  const VkExtent2D &extent);
+
+    // Inside of a render pass on the swapchain image
+    void record_upscale(const VkCommandBuffer &command_buffer,
+                        const uint32_t frame,
+                        const VkImageView &scene_view,
+                        const uint64_t transient_generation,
+                        const VkExtent2D &scene_extent,
+                        const VkExtent2D &render_extent);
+
+    // NOTE: once the device is idle
+    void cleanup();
+};
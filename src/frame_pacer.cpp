@@ -0,0 +1,279 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vulkan/vulkan_core.h>
+
+#include "frame_pacer.h"
+
+static inline double get_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sleeps most of the way, and spins the rest, the OS wakes the thread late
+static void sleep_until(const double wake_time) {
+    const double sleep_time = wake_time - get_time() - FRAME_PACER_SPIN_TIME;
+    if (sleep_time > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(sleep_time));
+    }
+    while(get_time() < wake_time) {
+        std::this_thread::yield();
+    }
+}
+
+bool sApp::supports_present_wait() {
+    if (!has_device_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+        !has_device_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_id_features.pNext = &present_wait_features;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &present_id_features;
+    vkGetPhysicalDeviceFeatures2(Vulkan.physical_device,
+                                 &features);
+
+    return present_id_features.presentId && present_wait_features.presentWait;
+}
+
+void sFramePacer::init(sApp *application,
+                       const uint32_t frames_in_flight,
+                       const uint32_t target_fps) {
+    app = application;
+    frame_count = frames_in_flight;
+    min_frame_interval = (target_fps > 0) ? 1.0 / target_fps : 0.0;
+
+    // The vblank period, for aiming the frames with present wait
+    const GLFWvidmode *video_mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    refresh_interval = 1.0 / ((video_mode != NULL && video_mode->refreshRate > 0) ? video_mode->refreshRate : 60);
+
+    use_present_wait = app->Vulkan.use_present_wait;
+    if (use_present_wait) {
+        wait_for_present = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(app->Vulkan.device,
+                                                                         "vkWaitForPresentKHR");
+        use_present_wait = wait_for_present != NULL;
+    }
+
+    // ===================================
+    // TIMESTAMP QUERIES =================
+    // ===================================
+    {
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(app->Vulkan.physical_device,
+                                      &properties);
+
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(app->Vulkan.physical_device,
+                                                 &queue_family_count,
+                                                 NULL);
+        sScratchScope scratch(get_scratch_allocator());
+        VkQueueFamilyProperties *queue_families = scratch.alloc_array<VkQueueFamilyProperties>(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(app->Vulkan.physical_device,
+                                                 &queue_family_count,
+                                                 queue_families);
+        const uint32_t valid_bits = queue_families[app->Vulkan.queues.graphics_family_id].timestampValidBits;
+
+        // Without them, the GPU time is not predicted and the pacing relies on the cap & present wait
+        has_timestamps = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
+        if (!has_timestamps) {
+            return;
+        }
+        timestamp_period = properties.limits.timestampPeriod * 1e-9;
+        timestamp_mask = (valid_bits >= 64) ? UINT64_MAX : ((1ull << valid_bits) - 1);
+
+        VkQueryPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = FRAME_PACER_QUERY_COUNT * frame_count,
+            .pipelineStatistics = 0
+        };
+        VK_OK(vkCreateQueryPool(app->Vulkan.device,
+                                &pool_info,
+                                NULL,
+                                &query_pool),
+              "Create timestamp query pool");
+
+        is_query_written = (bool*) calloc(frame_count, sizeof(bool));
+    }
+}
+
+void sFramePacer::wait_for_next_frame() {
+    const double now = get_time();
+    const double predicted_cpu = cpu_times.predict();
+    const double predicted_gpu = gpu_times.predict();
+
+    double wake_time = now;
+    if (min_frame_interval > 0.0) {
+        wake_time = frame_start + min_frame_interval;
+    }
+
+    if (use_present_wait && present_id > 0 && present_swapchain == app->Vulkan.swapchain) {
+        // The previous frame on screen: its real latency, and the next vblank to aim for
+        const VkResult result = wait_for_present(app->Vulkan.device,
+                                                 present_swapchain,
+                                                 present_id,
+                                                 FRAME_PACER_PRESENT_WAIT_TIMEOUT);
+        if (result == VK_SUCCESS) {
+            const double presented = get_time();
+            latencies.push(presented - frame_start);
+
+            const double deadline = presented + refresh_interval - predicted_cpu - predicted_gpu - FRAME_PACER_SAFETY_MARGIN;
+            wake_time = (deadline > wake_time) ? deadline : wake_time;
+        }
+    } else {
+        // The submit should reach the GPU right when the queued frames are done
+        const double deadline = gpu_done_estimate - predicted_cpu - FRAME_PACER_SAFETY_MARGIN;
+        wake_time = (deadline > wake_time) ? deadline : wake_time;
+    }
+
+    sleep_until(wake_time);
+
+    const double previous_start = frame_start;
+    frame_start = get_time();
+    sleep_times.push(frame_start - now);
+    if (previous_start > 0.0) {
+        frame_intervals.push(frame_start - previous_start);
+    }
+}
+
+void sFramePacer::record_begin(const VkCommandBuffer &command_buffer,
+                               const uint32_t current_frame) {
+    if (!has_timestamps) {
+        return;
+    }
+
+    vkCmdResetQueryPool(command_buffer,
+                        query_pool,
+                        current_frame * FRAME_PACER_QUERY_COUNT,
+                        FRAME_PACER_QUERY_COUNT);
+    vkCmdWriteTimestamp(command_buffer,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        query_pool,
+                        current_frame * FRAME_PACER_QUERY_COUNT + FRAME_PACER_QUERY_FRAME_BEGIN);
+}
+
+void sFramePacer::record_end(const VkCommandBuffer &command_buffer,
+                             const uint32_t current_frame) {
+    if (!has_timestamps) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        query_pool,
+                        current_frame * FRAME_PACER_QUERY_COUNT + FRAME_PACER_QUERY_FRAME_END);
+}
+
+void sFramePacer::record_scene_begin(const VkCommandBuffer &command_buffer,
+                                     const uint32_t current_frame) {
+    if (!has_timestamps) {
+        return;
+    }
+
+    // The acquire waits on this stage, and the compute passes on earlier ones
+    vkCmdWriteTimestamp(command_buffer,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        query_pool,
+                        current_frame * FRAME_PACER_QUERY_COUNT + FRAME_PACER_QUERY_SCENE_BEGIN);
+}
+
+void sFramePacer::record_scene_end(const VkCommandBuffer &command_buffer,
+                                   const uint32_t current_frame) {
+    if (!has_timestamps) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        query_pool,
+                        current_frame * FRAME_PACER_QUERY_COUNT + FRAME_PACER_QUERY_SCENE_END);
+}
+
+double sFramePacer::read_gpu_time(const uint32_t current_frame,
+                                  double *scene_time) {
+    *scene_time = 0.0;
+    if (!has_timestamps || !is_query_written[current_frame]) {
+        return 0.0;
+    }
+    is_query_written[current_frame] = false;
+
+    uint64_t timestamps[FRAME_PACER_QUERY_COUNT] = {};
+    const VkResult result = vkGetQueryPoolResults(app->Vulkan.device,
+                                                  query_pool,
+                                                  current_frame * FRAME_PACER_QUERY_COUNT,
+                                                  FRAME_PACER_QUERY_COUNT,
+                                                  sizeof(timestamps),
+                                                  timestamps,
+                                                  sizeof(uint64_t),
+                                                  VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return 0.0;
+    }
+
+    const double gpu_time = ((timestamps[FRAME_PACER_QUERY_FRAME_END] - timestamps[FRAME_PACER_QUERY_FRAME_BEGIN]) & timestamp_mask) * timestamp_period;
+    gpu_times.push(gpu_time);
+
+    *scene_time = ((timestamps[FRAME_PACER_QUERY_SCENE_END] - timestamps[FRAME_PACER_QUERY_SCENE_BEGIN]) & timestamp_mask) * timestamp_period;
+    scene_times.push(*scene_time);
+    return gpu_time;
+}
+
+void sFramePacer::end_frame(const uint32_t current_frame,
+                            const bool is_presented) {
+    const double submitted = get_time();
+    cpu_times.push(submitted - frame_start);
+
+    if (has_timestamps) {
+        is_query_written[current_frame] = true;
+    }
+
+    // Queued behind the previous frames
+    const double gpu_start = (submitted > gpu_done_estimate) ? submitted : gpu_done_estimate;
+    gpu_done_estimate = gpu_start + gpu_times.predict();
+
+    if (use_present_wait) {
+        if (is_presented) {
+            present_id++;
+            present_swapchain = app->Vulkan.swapchain;
+        }
+    } else {
+        // Nothing tells when it is on screen, so up to the expected end of its GPU work
+        latencies.push(gpu_done_estimate - frame_start);
+    }
+}
+
+sFramePacerStats sFramePacer::get_stats() const {
+    return {
+        .cpu_time = cpu_times.get_mean() * 1000.0,
+        .gpu_time = gpu_times.get_mean() * 1000.0,
+        .scene_gpu_time = scene_times.get_mean() * 1000.0,
+        .predicted_gpu_time = gpu_times.predict() * 1000.0,
+        .latency = latencies.get_mean() * 1000.0,
+        .max_latency = latencies.get_max() * 1000.0,
+        .is_latency_measured = use_present_wait,
+        .frame_interval = frame_intervals.get_mean() * 1000.0,
+        .jitter = frame_intervals.get_deviation() * 1000.0,
+        .sleep_time = sleep_times.get_mean() * 1000.0
+    };
+}
+
+void sFramePacer::cleanup() {
+    if (has_timestamps) {
+        vkDestroyQueryPool(app->Vulkan.device, query_pool, NULL);
+        free(is_query_written);
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <math.h>
+#include <vulkan/vulkan_core.h>
+
+// Frames taken into account for the predictions & the stats
+#define FRAME_PACER_HISTORY       64
+// Added to the predicted frame, in seconds, so a slower frame does not miss its deadline
+#define FRAME_PACER_SAFETY_MARGIN 0.0005
+// The last part of a sleep is spinned, the OS sleeps overshoot by about this much
+#define FRAME_PACER_SPIN_TIME     0.001
+// Upper bound of a present wait, in nanoseconds, a hidden window may never present
+#define FRAME_PACER_PRESENT_WAIT_TIMEOUT 100000000
+
+// Timestamps of each frame slot: its whole command buffer, and the scene's render pass
+enum eFramePacerQuery : uint32_t {
+    FRAME_PACER_QUERY_FRAME_BEGIN = 0,
+    FRAME_PACER_QUERY_FRAME_END,
+    FRAME_PACER_QUERY_SCENE_BEGIN,
+    FRAME_PACER_QUERY_SCENE_END,
+    FRAME_PACER_QUERY_COUNT
+};
+
+struct sApp;
+
+// Ring of the last frame timings, in seconds
+struct sPacerHistory {
+    double   samples[FRAME_PACER_HISTORY];
+    uint32_t count = 0;
+    uint32_t next = 0;
+
+    inline void push(const double sample) {
+        samples[next] = sample;
+        next = (next + 1) % FRAME_PACER_HISTORY;
+        count = (count < FRAME_PACER_HISTORY) ? count + 1 : count;
+    }
+
+    inline double get_mean() const {
+        double sum = 0.0;
+        for(uint32_t i = 0; i < count; i++) {
+            sum += samples[i];
+        }
+        return (count > 0) ? sum / count : 0.0;
+    }
+
+    inline double get_deviation() const {
+        const double mean = get_mean();
+        double sum = 0.0;
+        for(uint32_t i = 0; i < count; i++) {
+            sum += (samples[i] - mean) * (samples[i] - mean);
+        }
+        return (count > 1) ? sqrt(sum / (count - 1)) : 0.0;
+    }
+
+    inline double get_max() const {
+        double max_sample = 0.0;
+        for(uint32_t i = 0; i < count; i++) {
+            max_sample = (samples[i] > max_sample) ? samples[i] : max_sample;
+        }
+        return max_sample;
+    }
+
+    // Pessimistic, but not as much as the worst frame: a spike should not delay every frame
+    inline double predict() const {
+        const double prediction = get_mean() + 2.0 * get_deviation();
+        const double max_sample = get_max();
+        return (prediction < max_sample) ? prediction : max_sample;
+    }
+};
+
+// In milliseconds, over the history
+struct sFramePacerStats {
+    double cpu_time; // Input sample to submit
+    double gpu_time; // From the timestamps, 0 without them
+    double scene_gpu_time; // Of the scene's render pass alone
+    double predicted_gpu_time;
+    double latency; // Input sample to on screen (present wait), or to the estimated GPU end
+    double max_latency;
+    bool   is_latency_measured; // Only with present wait
+    double frame_interval;
+    double jitter; // Deviation of the frame interval
+    double sleep_time;
+};
+
+// Paces the main loop: before polling the input, sleeps until the frame can start
+// without queuing behind the previous ones, so the input is sampled as late as possible.
+// The frame's GPU time is predicted from its timestamps, and with VK_KHR_present_wait the
+// frame aims for the vblank after the previous one was shown. Also caps the frame rate
+struct sFramePacer {
+    // Timestamps at the start & end of every frame's command buffer, and around its
+    // scene pass, FRAME_PACER_QUERY_COUNT per frame slot
+    VkQueryPool      query_pool = VK_NULL_HANDLE;
+    bool             has_timestamps = false;
+    double           timestamp_period = 0.0; // Seconds per tick
+    uint64_t         timestamp_mask = 0;
+    bool             *is_query_written = NULL;
+    uint32_t         frame_count = 0;
+
+    // Present wait, the frames are tagged with increasing present ids
+    bool             use_present_wait = false;
+    PFN_vkWaitForPresentKHR wait_for_present = NULL;
+    uint64_t         present_id = 0; // Of the last present
+    VkSwapchainKHR   present_swapchain = VK_NULL_HANDLE; // The ids are per swapchain
+
+    double           refresh_interval = 0.0;
+    double           min_frame_interval = 0.0; // From the fps cap, 0 when uncapped
+
+    // Seconds, on the steady clock
+    double           frame_start = 0.0; // When the input of the current frame is sampled
+    double           gpu_done_estimate = 0.0; // When the queued GPU work should end
+
+    sPacerHistory    cpu_times;
+    sPacerHistory    gpu_times;
+    sPacerHistory    scene_times;
+    sPacerHistory    latencies;
+    sPacerHistory    frame_intervals;
+    sPacerHistory    sleep_times;
+
+    sApp             *app = NULL;
+
+    void init(sApp *application,
+              const uint32_t frames_in_flight,
+              const uint32_t target_fps);
+
+    // Before polling the input
+    void wait_for_next_frame();
+
+    // At the start & end of the frame's command buffer, outside of a render pass
+    void record_begin(const VkCommandBuffer &command_buffer,
+                      const uint32_t current_frame);
+    void record_end(const VkCommandBuffer &command_buffer,
+                    const uint32_t current_frame);
+
+    // Right before & after the scene's render pass, outside of it. The begin one is on the
+    // color output, so it is written once the frame's waits (the swapchain image acquire,
+    // the compute passes) are through: the scene time is its work alone
+    void record_scene_begin(const VkCommandBuffer &command_buffer,
+                            const uint32_t current_frame);
+    void record_scene_end(const VkCommandBuffer &command_buffer,
+                          const uint32_t current_frame);
+
+    // Once the frame slot's timeline value is reached, so the results are there.
+    // The frame's GPU time in seconds, 0 when there is no new sample. The whole frame
+    // is for the pacing, with its waits; scene_time gets the one of the scene pass
+    double read_gpu_time(const uint32_t current_frame,
+                         double *scene_time);
+
+    // The id to chain on the present, with present wait
+    inline uint64_t get_next_present_id() const {
+        return present_id + 1;
+    }
+
+    // Right after the submit & present of the frame
+    void end_frame(const uint32_t current_frame,
+                   const bool is_presented);
+
+    sFramePacerStats get_stats() const;
+
+    void cleanup();
+};
@@ -0,0 +1,353 @@
+#include "frustum_culling.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+
+#include "utils.h"
+
+#ifdef FRUSTUM_CULLING_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(FRUSTUM_CULLING_AVX) && defined(__GNUC__)
+#define AVX_TARGET __attribute__((target("avx")))
+#else
+#define AVX_TARGET
+#endif
+
+// ===== FRUSTUM =====
+
+sFrustum extract_frustum(const glm::mat4 &proj,
+                         const glm::mat4 &view) {
+    const glm::mat4 clip = proj * view;
+
+    // glm is column major, so get the rows
+    glm::vec4 rows[4];
+    for(uint32_t i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    }
+
+    sFrustum frustum = {
+        .planes = {
+            rows[3] + rows[0], // Left
+            rows[3] - rows[0], // Right
+            rows[3] + rows[1], // Bottom (top, with the flipped Y)
+            rows[3] - rows[1], // Top
+            rows[2],           // Near, z goes from 0 to w on Vulkan
+            rows[3] - rows[2]  // Far
+        }
+    };
+
+    // Normalize, so the plane distances can be compared with the radius
+    for(uint32_t i = 0; i < 6; i++) {
+        const glm::vec4 &p = frustum.planes[i];
+        const float inv_length = 1.0f / sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        frustum.planes[i] = p * inv_length;
+    }
+
+    return frustum;
+}
+
+// ===== CULLING SET =====
+
+void sCullingSet::init(const uint32_t initial_capacity) {
+    count = 0;
+    capacity = 0;
+    memory = NULL;
+    _reserve(initial_capacity);
+}
+
+void sCullingSet::_reserve(const uint32_t min_capacity) {
+    const uint32_t new_capacity = (min_capacity + FRUSTUM_CULLING_LANES - 1) / FRUSTUM_CULLING_LANES * FRUSTUM_CULLING_LANES;
+
+    // 7 float arrays + the visibility bytes, plus space to align the start
+    const size_t floats_size = sizeof(float) * new_capacity;
+    const size_t alignment = sizeof(float) * FRUSTUM_CULLING_LANES;
+    void *new_memory = malloc(floats_size * 7 + new_capacity + alignment);
+    assert_msg(new_memory != NULL, "Could not allocate the culling set");
+    memset(new_memory, 0, floats_size * 7 + new_capacity + alignment);
+
+    // Since the capacity is multiple of the lanes, all the arrays stay aligned
+    uint8_t *base = (uint8_t*) (((uintptr_t) new_memory + alignment - 1) & ~(uintptr_t) (alignment - 1));
+    float *new_arrays[7];
+    for(uint32_t i = 0; i < 7; i++) {
+        new_arrays[i] = (float*) (base + floats_size * i);
+    }
+    uint8_t *new_is_visible = base + floats_size * 7;
+
+    // Keep the objects already added
+    if (memory != NULL) {
+        const float *old_arrays[7] = { center_x, center_y, center_z, radius, extent_x, extent_y, extent_z };
+        for(uint32_t i = 0; i < 7; i++) {
+            memcpy(new_arrays[i], old_arrays[i], sizeof(float) * count);
+        }
+        memcpy(new_is_visible, is_visible, count);
+        free(memory);
+    }
+
+    memory = new_memory;
+    capacity = new_capacity;
+    center_x = new_arrays[0];
+    center_y = new_arrays[1];
+    center_z = new_arrays[2];
+    radius   = new_arrays[3];
+    extent_x = new_arrays[4];
+    extent_y = new_arrays[5];
+    extent_z = new_arrays[6];
+    is_visible = new_is_visible;
+}
+
+uint32_t sCullingSet::add_sphere(const glm::vec3 &center,
+                                 const float sphere_radius) {
+    if (count == capacity) {
+        _reserve((capacity > 0) ? capacity * 2 : FRUSTUM_CULLING_LANES);
+    }
+    const uint32_t id = count++;
+    set_sphere(id, center, sphere_radius);
+    return id;
+}
+
+uint32_t sCullingSet::add_aabb(const glm::vec3 &min,
+                               const glm::vec3 &max) {
+    if (count == capacity) {
+        _reserve((capacity > 0) ? capacity * 2 : FRUSTUM_CULLING_LANES);
+    }
+    const uint32_t id = count++;
+    set_aabb(id, min, max);
+    return id;
+}
+
+void sCullingSet::set_sphere(const uint32_t id,
+                             const glm::vec3 &center,
+                             const float sphere_radius) {
+    center_x[id] = center.x;
+    center_y[id] = center.y;
+    center_z[id] = center.z;
+    radius[id] = sphere_radius;
+    // The AABB that contains the sphere
+    extent_x[id] = extent_y[id] = extent_z[id] = sphere_radius;
+}
+
+void sCullingSet::set_aabb(const uint32_t id,
+                           const glm::vec3 &min,
+                           const glm::vec3 &max) {
+    const glm::vec3 center = (min + max) * 0.5f;
+    const glm::vec3 extent = (max - min) * 0.5f;
+
+    center_x[id] = center.x;
+    center_y[id] = center.y;
+    center_z[id] = center.z;
+    extent_x[id] = extent.x;
+    extent_y[id] = extent.y;
+    extent_z[id] = extent.z;
+    // The sphere that contains the AABB
+    radius[id] = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+}
+
+// ===== KERNELS =====
+// Sphere: visible if dot(n, c) + w > -r for all the planes
+// AABB:   visible if dot(n, c) + w + dot(|n|, e) > 0 for all the planes
+
+#ifndef FRUSTUM_CULLING_SSE
+static void cull_range_scalar(const sFrustum &frustum,
+                              sCullingSet *set,
+                              const eCullingVolume volume,
+                              const uint32_t begin,
+                              const uint32_t end) {
+    for(uint32_t i = begin; i < end; i++) {
+        bool inside = true;
+        for(uint32_t p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            const float distance = plane.x * set->center_x[i] + plane.y * set->center_y[i] + plane.z * set->center_z[i] + plane.w;
+            const float reach = (volume == CULLING_SPHERES) ? set->radius[i] :
+                                fabsf(plane.x) * set->extent_x[i] + fabsf(plane.y) * set->extent_y[i] + fabsf(plane.z) * set->extent_z[i];
+            inside = inside && (distance > -reach);
+        }
+        set->is_visible[i] = inside ? 1 : 0;
+    }
+}
+#endif
+
+#ifdef FRUSTUM_CULLING_SSE
+static void cull_range_sse(const sFrustum &frustum,
+                           sCullingSet *set,
+                           const eCullingVolume volume,
+                           const uint32_t begin,
+                           const uint32_t end) {
+    // Broadcast the planes once
+    __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    __m128 abs_x[6], abs_y[6], abs_z[6];
+    for(uint32_t p = 0; p < 6; p++) {
+        plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+        plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+        plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+        plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+        abs_x[p] = _mm_set1_ps(fabsf(frustum.planes[p].x));
+        abs_y[p] = _mm_set1_ps(fabsf(frustum.planes[p].y));
+        abs_z[p] = _mm_set1_ps(fabsf(frustum.planes[p].z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    for(uint32_t i = begin; i < end; i += 4) {
+        const __m128 cx = _mm_load_ps(&set->center_x[i]);
+        const __m128 cy = _mm_load_ps(&set->center_y[i]);
+        const __m128 cz = _mm_load_ps(&set->center_z[i]);
+
+        __m128 inside;
+        if (volume == CULLING_SPHERES) {
+            const __m128 neg_radius = _mm_sub_ps(zero, _mm_load_ps(&set->radius[i]));
+            inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for(uint32_t p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(plane_x[p], cx), plane_w[p]);
+                distance = _mm_add_ps(_mm_mul_ps(plane_y[p], cy), distance);
+                distance = _mm_add_ps(_mm_mul_ps(plane_z[p], cz), distance);
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, neg_radius));
+            }
+        } else {
+            const __m128 ex = _mm_load_ps(&set->extent_x[i]);
+            const __m128 ey = _mm_load_ps(&set->extent_y[i]);
+            const __m128 ez = _mm_load_ps(&set->extent_z[i]);
+            inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for(uint32_t p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(plane_x[p], cx), plane_w[p]);
+                distance = _mm_add_ps(_mm_mul_ps(plane_y[p], cy), distance);
+                distance = _mm_add_ps(_mm_mul_ps(plane_z[p], cz), distance);
+                distance = _mm_add_ps(_mm_mul_ps(abs_x[p], ex), distance);
+                distance = _mm_add_ps(_mm_mul_ps(abs_y[p], ey), distance);
+                distance = _mm_add_ps(_mm_mul_ps(abs_z[p], ez), distance);
+                inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, zero));
+            }
+        }
+
+        // Lane masks (0 or -1) to bytes (0 or 1)
+        __m128i mask = _mm_castps_si128(inside);
+        mask = _mm_packs_epi32(mask, mask);
+        mask = _mm_packs_epi16(mask, mask);
+        mask = _mm_and_si128(mask, _mm_set1_epi8(1));
+        const int32_t bytes = _mm_cvtsi128_si32(mask);
+        memcpy(&set->is_visible[i], &bytes, 4);
+    }
+}
+#endif
+
+#ifdef FRUSTUM_CULLING_AVX
+AVX_TARGET
+static void cull_range_avx(const sFrustum &frustum,
+                           sCullingSet *set,
+                           const eCullingVolume volume,
+                           const uint32_t begin,
+                           const uint32_t end) {
+    __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    __m256 abs_x[6], abs_y[6], abs_z[6];
+    for(uint32_t p = 0; p < 6; p++) {
+        plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+        plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+        plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+        plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+        abs_x[p] = _mm256_set1_ps(fabsf(frustum.planes[p].x));
+        abs_y[p] = _mm256_set1_ps(fabsf(frustum.planes[p].y));
+        abs_z[p] = _mm256_set1_ps(fabsf(frustum.planes[p].z));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    for(uint32_t i = begin; i < end; i += 8) {
+        const __m256 cx = _mm256_load_ps(&set->center_x[i]);
+        const __m256 cy = _mm256_load_ps(&set->center_y[i]);
+        const __m256 cz = _mm256_load_ps(&set->center_z[i]);
+
+        __m256 inside;
+        if (volume == CULLING_SPHERES) {
+            const __m256 neg_radius = _mm256_sub_ps(zero, _mm256_load_ps(&set->radius[i]));
+            inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ); // All ones
+            for(uint32_t p = 0; p < 6; p++) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(plane_x[p], cx), plane_w[p]);
+                distance = _mm256_add_ps(_mm256_mul_ps(plane_y[p], cy), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(plane_z[p], cz), distance);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GT_OQ));
+            }
+        } else {
+            const __m256 ex = _mm256_load_ps(&set->extent_x[i]);
+            const __m256 ey = _mm256_load_ps(&set->extent_y[i]);
+            const __m256 ez = _mm256_load_ps(&set->extent_z[i]);
+            inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for(uint32_t p = 0; p < 6; p++) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(plane_x[p], cx), plane_w[p]);
+                distance = _mm256_add_ps(_mm256_mul_ps(plane_y[p], cy), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(plane_z[p], cz), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(abs_x[p], ex), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(abs_y[p], ey), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(abs_z[p], ez), distance);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+            }
+        }
+
+        // No 256 bit integer packs without AVX2, so pack the halves
+        const __m128i low = _mm_castps_si128(_mm256_castps256_ps128(inside));
+        const __m128i high = _mm_castps_si128(_mm256_extractf128_ps(inside, 1));
+        __m128i mask = _mm_packs_epi32(low, high);
+        mask = _mm_packs_epi16(mask, mask);
+        mask = _mm_and_si128(mask, _mm_set1_epi8(1));
+        _mm_storel_epi64((__m128i*) &set->is_visible[i], mask);
+    }
+}
+
+static bool has_avx() {
+#if defined(__AVX__)
+    return true;
+#else
+    static const bool is_supported = __builtin_cpu_supports("avx");
+    return is_supported;
+#endif
+}
+#endif
+
+void cull_range(const sFrustum &frustum,
+                sCullingSet *set,
+                const eCullingVolume volume,
+                const uint32_t begin,
+                const uint32_t end) {
+    assert_msg(begin % FRUSTUM_CULLING_LANES == 0, "Culling ranges need to start aligned to the SIMD width");
+    // Run over the padding instead of having a tail loop
+    const uint32_t padded_end = (end + FRUSTUM_CULLING_LANES - 1) / FRUSTUM_CULLING_LANES * FRUSTUM_CULLING_LANES;
+
+#if defined(FRUSTUM_CULLING_AVX)
+    if (has_avx()) {
+        cull_range_avx(frustum, set, volume, begin, padded_end);
+        return;
+    }
+#endif
+#if defined(FRUSTUM_CULLING_SSE)
+    cull_range_sse(frustum, set, volume, begin, padded_end);
+#else
+    cull_range_scalar(frustum, set, volume, begin, end);
+#endif
+}
+
+struct sCullingJob {
+    const sFrustum  *frustum;
+    sCullingSet     *set;
+    eCullingVolume  volume;
+};
+
+void cull(const sFrustum &frustum,
+          sCullingSet *set,
+          const eCullingVolume volume,
+          sWorkerPool *worker_pool) {
+    sCullingJob job = {
+        .frustum = &frustum,
+        .set = set,
+        .volume = volume
+    };
+
+    worker_pool->parallel_for([](void *data, const uint32_t begin, const uint32_t end) {
+                                  const sCullingJob *job = (sCullingJob*) data;
+                                  cull_range(*job->frustum, job->set, job->volume, begin, end);
+                              },
+                              &job,
+                              set->count,
+                              FRUSTUM_CULLING_BATCH_SIZE);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <glm/glm.hpp>
+
+#include "worker_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FRUSTUM_CULLING_SSE 1
+// AVX is selected at runtime on GCC/Clang, MSVC needs /arch:AVX
+#if defined(__GNUC__) || defined(__AVX__)
+#define FRUSTUM_CULLING_AVX 1
+#endif
+#endif
+
+// Widest SIMD width, the SoA arrays are padded to it so the kernels have no tail
+#define FRUSTUM_CULLING_LANES      8
+// Objects per worker job: big enough to amortize the dispatch, small enough to balance
+#define FRUSTUM_CULLING_BATCH_SIZE 16384
+
+enum eCullingVolume : uint8_t {
+    CULLING_SPHERES = 0, // Cheapest, conservative for long objects
+    CULLING_AABBS        // Tighter, costs three more multiply-adds per plane
+};
+
+// Normalized planes (xyz normal pointing inside, w distance), in world space
+struct sFrustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb-Hartmann extraction from the projection * view matrix
+// Uses the Vulkan [0, 1] depth range for the near plane
+sFrustum extract_frustum(const glm::mat4 &proj,
+                         const glm::mat4 &view);
+
+// World space bounding volumes on structure of arrays form
+// Each object has both a sphere and an AABB, sharing the center
+struct sCullingSet {
+    float    *center_x = NULL;
+    float    *center_y = NULL;
+    float    *center_z = NULL;
+    float    *radius = NULL;
+    float    *extent_x = NULL; // AABB half sizes
+    float    *extent_y = NULL;
+    float    *extent_z = NULL;
+    uint8_t  *is_visible = NULL; // Result of the last cull, 1 or 0
+
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+
+    void    *memory = NULL; // Single block for all the arrays
+
+    // Grows on the adds, doubling. Not while a cull runs
+    void init(const uint32_t initial_capacity = FRUSTUM_CULLING_LANES);
+
+    uint32_t add_sphere(const glm::vec3 &center,
+                        const float sphere_radius);
+
+    uint32_t add_aabb(const glm::vec3 &min,
+                      const glm::vec3 &max);
+
+    void set_sphere(const uint32_t id,
+                    const glm::vec3 &center,
+                    const float sphere_radius);
+
+    void set_aabb(const uint32_t id,
+                  const glm::vec3 &min,
+                  const glm::vec3 &max);
+
+    void _reserve(const uint32_t min_capacity);
+
+    void clear() {
+        count = 0;
+    }
+
+    void clean() {
+        free(memory);
+        memory = NULL;
+        count = capacity = 0;
+    }
+};
+
+// Tests a range of objects against the frustum, using the widest SIMD available
+void cull_range(const sFrustum &frustum,
+                sCullingSet *set,
+                const eCullingVolume volume,
+                const uint32_t begin,
+                const uint32_t end);
+
+// Splits the set on FRUSTUM_CULLING_BATCH_SIZE jobs over the worker pool
+void cull(const sFrustum &frustum,
+          sCullingSet *set,
+          const eCullingVolume volume,
+          sWorkerPool *worker_pool);
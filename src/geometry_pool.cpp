@@ -0,0 +1,162 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#include "geometry_pool.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+void sApp::_create_geometry_pool() {
+    geometry_pool.device = &Vulkan.device;
+    // The meshes are stored quantized, see Geometry::sVertex2DCompact
+    geometry_pool.vertex_stride = sizeof(Geometry::sVertex2DCompact);
+
+    create_buffer(geometry_pool.vertex_stride * GEOMETRY_POOL_VERTEX_CAPACITY,
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  &geometry_pool.vertex_buffer,
+                  &geometry_pool.vertex_buffer_memory);
+
+    create_buffer(sizeof(uint16_t) * GEOMETRY_POOL_INDEX_CAPACITY,
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  &geometry_pool.index_buffer,
+                  &geometry_pool.index_buffer_memory);
+
+    geometry_pool.vertex_ranges.init(GEOMETRY_POOL_VERTEX_CAPACITY);
+    geometry_pool.index_ranges.init(GEOMETRY_POOL_INDEX_CAPACITY);
+}
+
+sMeshHandle sApp::upload_mesh(const Geometry::sVertex2D *vertices,
+                              const uint32_t vertex_count,
+                              const uint32_t *indices,
+                              const uint32_t index_count) {
+    sMeshHandle mesh = {
+        .vertex_count = vertex_count,
+        .index_count = index_count,
+        .index_type = Geometry::choose_index_type(vertex_count)
+    };
+
+    const uint32_t index_size = Geometry::index_type_size(mesh.index_type);
+    const uint32_t slots_per_index = index_size / sizeof(uint16_t);
+
+    // Reserve the space on the shared buffers
+    uint32_t vertex_offset, index_slot;
+    assert_msg(geometry_pool.vertex_ranges.alloc(vertex_count, 1, &vertex_offset), "Geometry pool out of vertex space");
+    assert_msg(geometry_pool.index_ranges.alloc(index_count * slots_per_index, slots_per_index, &index_slot), "Geometry pool out of index space");
+    mesh.vertex_offset = (int32_t) vertex_offset;
+    mesh.first_index = index_slot / slots_per_index;
+
+    // Upload both vertices and indices on a single staging buffer
+    const VkDeviceSize vertices_size = (VkDeviceSize) geometry_pool.vertex_stride * vertex_count;
+    const VkDeviceSize indices_size = (VkDeviceSize) index_size * index_count;
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_buffer_memory;
+
+    create_buffer(vertices_size + indices_size,
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  &staging_buffer,
+                  &staging_buffer_memory);
+
+    uint8_t *upload_data;
+    VK_OK(vkMapMemory(Vulkan.device,
+                      staging_buffer_memory,
+                      0,
+                      vertices_size + indices_size,
+                      0,
+                      (void**) &upload_data),
+          "Mapping memory");
+
+    // Quantize the vertices directly on the staging memory
+    Geometry::sVertex2DCompact *compact_vertices = (Geometry::sVertex2DCompact*) upload_data;
+    for(uint32_t i = 0; i < vertex_count; i++) {
+        compact_vertices[i] = Geometry::encode_compact(vertices[i]);
+    }
+
+    if (mesh.index_type == VK_INDEX_TYPE_UINT16) {
+        uint16_t *short_indices = (uint16_t*) (upload_data + vertices_size);
+        for(uint32_t i = 0; i < index_count; i++) {
+            short_indices[i] = (uint16_t) indices[i];
+        }
+    } else {
+        memcpy(upload_data + vertices_size,
+               indices,
+               indices_size);
+    }
+
+    vkUnmapMemory(Vulkan.device,
+                  staging_buffer_memory);
+
+    // Copy each part on its sub-allocated range
+    {
+        VkCommandBuffer command_buffer = being_single_time_commands();
+
+        VkBufferCopy vertex_region = {
+            .srcOffset = 0,
+            .dstOffset = (VkDeviceSize) geometry_pool.vertex_stride * vertex_offset,
+            .size = vertices_size
+        };
+        vkCmdCopyBuffer(command_buffer,
+                        staging_buffer,
+                        geometry_pool.vertex_buffer,
+                        1,
+                        &vertex_region);
+
+        VkBufferCopy index_region = {
+            .srcOffset = vertices_size,
+            .dstOffset = (VkDeviceSize) sizeof(uint16_t) * index_slot,
+            .size = indices_size
+        };
+        vkCmdCopyBuffer(command_buffer,
+                        staging_buffer,
+                        geometry_pool.index_buffer,
+                        1,
+                        &index_region);
+
+        end_single_time_commands(command_buffer);
+    }
+
+    vkDestroyBuffer(Vulkan.device,
+                    staging_buffer,
+                    NULL);
+    vkFreeMemory(Vulkan.device,
+                 staging_buffer_memory,
+                 NULL);
+
+    return mesh;
+}
+
+sMeshHandle sApp::import_mesh(const char *mesh_name,
+                              const Geometry::sVertex2D *vertices,
+                              const uint32_t vertex_count,
+                              const uint32_t *indices,
+                              const uint32_t index_count) {
+    // Work on a copy, since the source meshes are usually const data
+    Geometry::sVertex2D *optimized_vertices = (Geometry::sVertex2D*) malloc(sizeof(Geometry::sVertex2D) * vertex_count);
+    uint32_t *optimized_indices = (uint32_t*) malloc(sizeof(uint32_t) * index_count);
+    memcpy(optimized_vertices, vertices, sizeof(Geometry::sVertex2D) * vertex_count);
+    memcpy(optimized_indices, indices, sizeof(uint32_t) * index_count);
+
+    uint32_t optimized_vertex_count = vertex_count;
+    Geometry::Optimizer::sMeshOptimizationReport report = Geometry::Optimizer::optimize_mesh(optimized_vertices,
+                                                                                             &optimized_vertex_count,
+                                                                                             optimized_indices,
+                                                                                             index_count);
+    Geometry::Optimizer::print_report(mesh_name, report);
+
+    sMeshHandle mesh = upload_mesh(optimized_vertices,
+                                   optimized_vertex_count,
+                                   optimized_indices,
+                                   index_count);
+
+    free(optimized_vertices);
+    free(optimized_indices);
+
+    return mesh;
+}
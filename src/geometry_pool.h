@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+
+// Capacity of the shared buffers, in vertices and in 16 bit index slots
+#define GEOMETRY_POOL_VERTEX_CAPACITY (1 << 20)
+#define GEOMETRY_POOL_INDEX_CAPACITY  (1 << 23)
+#define GEOMETRY_POOL_MAX_FREE_RANGES 1024
+
+struct sRange {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// First-fit sub allocator, the free ranges are sorted by offset
+// so the freed ranges can be merged with their neighbours
+struct sRangeAllocator {
+    sRange   *free_ranges = NULL;
+    uint32_t free_range_count = 0;
+    uint32_t total_size = 0;
+
+    void init(const uint32_t size) {
+        total_size = size;
+        free_ranges = (sRange*) malloc(sizeof(sRange) * GEOMETRY_POOL_MAX_FREE_RANGES);
+        free_ranges[0] = { .offset = 0, .size = size };
+        free_range_count = 1;
+    }
+
+    bool alloc(const uint32_t size,
+               const uint32_t alignment,
+               uint32_t *offset) {
+        for(uint32_t i = 0; i < free_range_count; i++) {
+            const sRange range = free_ranges[i];
+            const uint32_t aligned_offset = (range.offset + alignment - 1) / alignment * alignment;
+            const uint32_t padding = aligned_offset - range.offset;
+
+            if (range.size < size + padding) {
+                continue;
+            }
+
+            *offset = aligned_offset;
+            free_ranges[i].offset += size + padding;
+            free_ranges[i].size -= size + padding;
+
+            // Remove the range if its been used completely
+            if (free_ranges[i].size == 0) {
+                memmove(&free_ranges[i],
+                        &free_ranges[i + 1],
+                        sizeof(sRange) * (free_range_count - i - 1));
+                free_range_count--;
+            }
+
+            // Give back the space skipped for the alignment
+            if (padding > 0) {
+                free(range.offset, padding);
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    void free(const uint32_t offset,
+              const uint32_t size) {
+        // Find the insertion point
+        uint32_t i = 0;
+        for(; i < free_range_count && free_ranges[i].offset < offset; i++) {}
+
+        const bool merges_prev = i > 0 && free_ranges[i - 1].offset + free_ranges[i - 1].size == offset;
+        const bool merges_next = i < free_range_count && offset + size == free_ranges[i].offset;
+
+        if (merges_prev && merges_next) {
+            free_ranges[i - 1].size += size + free_ranges[i].size;
+            memmove(&free_ranges[i],
+                    &free_ranges[i + 1],
+                    sizeof(sRange) * (free_range_count - i - 1));
+            free_range_count--;
+        } else if (merges_prev) {
+            free_ranges[i - 1].size += size;
+        } else if (merges_next) {
+            free_ranges[i].offset = offset;
+            free_ranges[i].size += size;
+        } else {
+            assert_msg(free_range_count < GEOMETRY_POOL_MAX_FREE_RANGES, "Geometry pool too fragmented");
+            memmove(&free_ranges[i + 1],
+                    &free_ranges[i],
+                    sizeof(sRange) * (free_range_count - i));
+            free_ranges[i] = { .offset = offset, .size = size };
+            free_range_count++;
+        }
+    }
+
+    void clean() {
+        ::free(free_ranges);
+    }
+};
+
+// A mesh inside the pool, addressed by its offsets on the shared buffers
+struct sMeshHandle {
+    int32_t     vertex_offset = 0;
+    uint32_t    vertex_count = 0;
+    uint32_t    first_index = 0; // In units of the index type
+    uint32_t    index_count = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+};
+
+struct sGeometryPool {
+    VkBuffer       vertex_buffer;
+    VkDeviceMemory vertex_buffer_memory;
+    VkBuffer       index_buffer;
+    VkDeviceMemory index_buffer_memory;
+
+    uint32_t       vertex_stride = 0;
+
+    sRangeAllocator vertex_ranges; // In vertices
+    sRangeAllocator index_ranges;  // In 16 bit slots, 32 bit indices use two
+
+    VkIndexType    bound_index_type;
+
+    VkDevice       *device = NULL;
+
+    // Bind all the geometry once, and the meshes are selected on the draw
+    // The index buffer is only rebound when the index type changes
+    void bind(const VkCommandBuffer &command_buffer) {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(command_buffer,
+                               0,
+                               1,
+                               &vertex_buffer,
+                               &offset);
+
+        vkCmdBindIndexBuffer(command_buffer,
+                             index_buffer,
+                             0,
+                             VK_INDEX_TYPE_UINT16);
+        bound_index_type = VK_INDEX_TYPE_UINT16;
+    }
+
+    void draw(const VkCommandBuffer &command_buffer,
+              const sMeshHandle &mesh,
+              const uint32_t instance_count = 1) {
+        if (mesh.index_type != bound_index_type) {
+            vkCmdBindIndexBuffer(command_buffer,
+                                 index_buffer,
+                                 0,
+                                 mesh.index_type);
+            bound_index_type = mesh.index_type;
+        }
+
+        vkCmdDrawIndexed(command_buffer,
+                         mesh.index_count,
+                         instance_count,
+                         mesh.first_index,
+                         mesh.vertex_offset,
+                         0);
+    }
+
+    // The counts come from the buffer, see sGpuCulling
+    void draw_indirect(const VkCommandBuffer &command_buffer,
+                       const sMeshHandle &mesh,
+                       const VkBuffer &draw_buffer,
+                       const VkDeviceSize offset) {
+        if (mesh.index_type != bound_index_type) {
+            vkCmdBindIndexBuffer(command_buffer,
+                                 index_buffer,
+                                 0,
+                                 mesh.index_type);
+            bound_index_type = mesh.index_type;
+        }
+
+        vkCmdDrawIndexedIndirect(command_buffer,
+                                 draw_buffer,
+                                 offset,
+                                 1,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    // NOTE: the ranges are reused on the next upload, so the GPU needs to be done with the mesh
+    void free_mesh(sMeshHandle *mesh) {
+        vertex_ranges.free((uint32_t) mesh->vertex_offset,
+                           mesh->vertex_count);
+        const uint32_t slots_per_index = (mesh->index_type == VK_INDEX_TYPE_UINT16) ? 1 : 2;
+        index_ranges.free(mesh->first_index * slots_per_index,
+                          mesh->index_count * slots_per_index);
+        *mesh = {};
+    }
+
+    void cleanup() {
+        vkDestroyBuffer(*device, vertex_buffer, NULL);
+        vkFreeMemory(*device, vertex_buffer_memory, NULL);
+        vkDestroyBuffer(*device, index_buffer, NULL);
+        vkFreeMemory(*device, index_buffer_memory, NULL);
+
+        vertex_ranges.clean();
+        index_ranges.clean();
+    }
+};
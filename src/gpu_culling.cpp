@@ -0,0 +1,340 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "gpu_culling.h"
+#include "shader.h"
+
+// Recorded on the frame's compute command buffer (see sAsyncCompute::submit_frame)
+static void record_culling_pass(const VkCommandBuffer &command_buffer,
+                                const uint32_t frame,
+                                void *data) {
+    const sGpuCulling *culling = (const sGpuCulling*) data;
+    if (culling->draw_count == 0) {
+        return;
+    }
+
+    vkCmdBindPipeline(command_buffer,
+                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                      culling->pipeline);
+    vkCmdBindDescriptorSets(command_buffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            culling->pipeline_layout,
+                            0,
+                            1,
+                            &culling->descriptor_sets[frame],
+                            0,
+                            NULL);
+
+    sGpuCullingPushConstants push_constants = {
+        .draw_count = culling->draw_count
+    };
+    for(uint32_t i = 0; i < 6; i++) {
+        push_constants.planes[i] = culling->frustums[frame].planes[i];
+    }
+    vkCmdPushConstants(command_buffer,
+                       culling->pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(sGpuCullingPushConstants),
+                       &push_constants);
+
+    vkCmdDispatch(command_buffer,
+                  (culling->draw_count + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE,
+                  1,
+                  1);
+}
+
+void sGpuCulling::init(sApp *application,
+                       sCullingSet *set,
+                       const uint32_t frames_in_flight) {
+    app = application;
+    culling_set = set;
+    frame_count = frames_in_flight;
+    is_enabled = app->async_compute.is_async;
+
+    if (!is_enabled) {
+        return;
+    }
+
+    VkDevice device = app->Vulkan.device;
+    const sAsyncCompute &async_compute = app->async_compute;
+
+    // ===============================
+    // PER-FRAME BUFFERS =============
+    // ===============================
+    {
+        const VkDeviceSize bounds_size = sizeof(glm::vec4) * GPU_CULLING_MAX_DRAWS;
+        const VkDeviceSize draws_size = sizeof(VkDrawIndexedIndirectCommand) * GPU_CULLING_MAX_DRAWS;
+
+        bounds_buffers = (VkBuffer*) malloc(sizeof(VkBuffer) * frame_count);
+        bounds_memories = (VkDeviceMemory*) malloc(sizeof(VkDeviceMemory) * frame_count);
+        bounds_mapped = (glm::vec4**) malloc(sizeof(glm::vec4*) * frame_count);
+        draw_buffers = (VkBuffer*) malloc(sizeof(VkBuffer) * frame_count);
+        draw_memories = (VkDeviceMemory*) malloc(sizeof(VkDeviceMemory) * frame_count);
+        draw_mapped = (VkDrawIndexedIndirectCommand**) malloc(sizeof(VkDrawIndexedIndirectCommand*) * frame_count);
+        frustums = (sFrustum*) malloc(sizeof(sFrustum) * frame_count);
+
+        for(uint32_t i = 0; i < frame_count; i++) {
+            app->create_buffer(bounds_size,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               &bounds_buffers[i],
+                               &bounds_memories[i],
+                               async_compute.get_sharing_mode(),
+                               async_compute.family_count,
+                               async_compute.family_indices);
+            VK_OK(vkMapMemory(device,
+                              bounds_memories[i],
+                              0,
+                              bounds_size,
+                              0,
+                              (void**) &bounds_mapped[i]),
+                  "Mapping culling bounds buffer");
+
+            // Written by the compute queue, read by the graphics one as the indirect draws
+            app->create_buffer(draws_size,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               &draw_buffers[i],
+                               &draw_memories[i],
+                               async_compute.get_sharing_mode(),
+                               async_compute.family_count,
+                               async_compute.family_indices);
+            VK_OK(vkMapMemory(device,
+                              draw_memories[i],
+                              0,
+                              draws_size,
+                              0,
+                              (void**) &draw_mapped[i]),
+                  "Mapping culling draw buffer");
+        }
+    }
+
+    // ===============================
+    // DESCRIPTOR SETS ===============
+    // ===============================
+    {
+        VkDescriptorSetLayoutBinding bindings[2] = {
+            {
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
+            },
+            {
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
+            }
+        };
+        VkDescriptorSetLayoutCreateInfo layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .bindingCount = 2,
+            .pBindings = bindings
+        };
+        VK_OK(vkCreateDescriptorSetLayout(device,
+                                          &layout_create_info,
+                                          NULL,
+                                          &descriptor_set_layout),
+              "Create culling descriptor set layout");
+
+        VkDescriptorPoolSize pool_size = {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = frame_count * 2
+        };
+        VkDescriptorPoolCreateInfo pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .maxSets = frame_count,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size
+        };
+        VK_OK(vkCreateDescriptorPool(device,
+                                     &pool_create_info,
+                                     NULL,
+                                     &descriptor_pool),
+              "Create culling descriptor pool");
+
+        descriptor_sets = (VkDescriptorSet*) malloc(sizeof(VkDescriptorSet) * frame_count);
+        VkDescriptorSetLayout *set_layouts = (VkDescriptorSetLayout*) malloc(sizeof(VkDescriptorSetLayout) * frame_count);
+        for(uint32_t i = 0; i < frame_count; i++) {
+            set_layouts[i] = descriptor_set_layout;
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = NULL,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = frame_count,
+            .pSetLayouts = set_layouts
+        };
+        VK_OK(vkAllocateDescriptorSets(device,
+                                       &alloc_info,
+                                       descriptor_sets),
+              "Allocate culling descriptor sets");
+        free(set_layouts);
+
+        // The buffers never change, written once
+        for(uint32_t i = 0; i < frame_count; i++) {
+            VkDescriptorBufferInfo buffer_infos[2] = {
+                {
+                    .buffer = bounds_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                },
+                {
+                    .buffer = draw_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                }
+            };
+            VkWriteDescriptorSet writes[2];
+            for(uint32_t j = 0; j < 2; j++) {
+                writes[j] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = NULL,
+                    .dstSet = descriptor_sets[i],
+                    .dstBinding = j,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pImageInfo = NULL,
+                    .pBufferInfo = &buffer_infos[j],
+                    .pTexelBufferView = NULL
+                };
+            }
+            vkUpdateDescriptorSets(device,
+                                   2,
+                                   writes,
+                                   0,
+                                   NULL);
+        }
+    }
+
+    // ===============================
+    // PIPELINE ======================
+    // ===============================
+    {
+        VkPushConstantRange push_constant_range = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(sGpuCullingPushConstants)
+        };
+        VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .setLayoutCount = 1,
+            .pSetLayouts = &descriptor_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_constant_range
+        };
+        VK_OK(vkCreatePipelineLayout(device,
+                                     &pipeline_layout_create_info,
+                                     NULL,
+                                     &pipeline_layout),
+              "Create culling pipeline layout");
+
+        VkShaderModule shader_module;
+        create_shader_module(device,
+                             "resources/shaders/cull_comp.spv",
+                             &shader_module);
+
+        VkComputePipelineCreateInfo pipeline_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = NULL,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = NULL,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main"
+            },
+            .layout = pipeline_layout
+        };
+        VK_OK(vkCreateComputePipelines(device,
+                                       VK_NULL_HANDLE,
+                                       1,
+                                       &pipeline_create_info,
+                                       NULL,
+                                       &pipeline),
+              "Create culling pipeline");
+
+        vkDestroyShaderModule(device, shader_module, NULL);
+    }
+
+    // The indirect draws read what it writes, the rest of the frame does not wait for it
+    app->async_compute.add_pass("Culling",
+                                record_culling_pass,
+                                this,
+                                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+}
+
+uint32_t sGpuCulling::add_draw(const sMeshHandle &mesh,
+                               const uint32_t cull_id) {
+    assert_msg(draw_count < GPU_CULLING_MAX_DRAWS, "Too many culled draws");
+    meshes[draw_count] = mesh;
+    cull_ids[draw_count] = cull_id;
+    return draw_count++;
+}
+
+void sGpuCulling::begin_frame(const uint32_t frame,
+                              const sFrustum &frustum) {
+    frustums[frame] = frustum;
+
+    // The frame slot was waited for, so its compute pass & draws are done with these.
+    // The instance counts are left to the pass
+    glm::vec4 *bounds = bounds_mapped[frame];
+    VkDrawIndexedIndirectCommand *draws = draw_mapped[frame];
+    for(uint32_t i = 0; i < draw_count; i++) {
+        const uint32_t id = cull_ids[i];
+        bounds[i] = glm::vec4(culling_set->center_x[id],
+                              culling_set->center_y[id],
+                              culling_set->center_z[id],
+                              culling_set->radius[id]);
+        draws[i] = {
+            .indexCount = meshes[i].index_count,
+            .instanceCount = 0,
+            .firstIndex = meshes[i].first_index,
+            .vertexOffset = meshes[i].vertex_offset,
+            .firstInstance = 0
+        };
+    }
+}
+
+void sGpuCulling::cleanup() {
+    if (!is_enabled) {
+        return;
+    }
+
+    VkDevice device = app->Vulkan.device;
+
+    vkDestroyPipeline(device, pipeline, NULL);
+    vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, NULL);
+    free(descriptor_sets);
+
+    for(uint32_t i = 0; i < frame_count; i++) {
+        vkDestroyBuffer(device, bounds_buffers[i], NULL);
+        vkFreeMemory(device, bounds_memories[i], NULL);
+        vkDestroyBuffer(device, draw_buffers[i], NULL);
+        vkFreeMemory(device, draw_memories[i], NULL);
+    }
+    free(bounds_buffers);
+    free(bounds_memories);
+    free(bounds_mapped);
+    free(draw_buffers);
+    free(draw_memories);
+    free(draw_mapped);
+    free(frustums);
+}
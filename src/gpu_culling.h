@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "utils.h"
+#include "frustum_culling.h"
+#include "geometry_pool.h"
+
+#define GPU_CULLING_MAX_DRAWS  1024
+#define GPU_CULLING_GROUP_SIZE 64
+
+struct sApp;
+
+// Same layout as the cull.comp push constants
+struct sGpuCullingPushConstants {
+    glm::vec4 planes[6];
+    uint32_t  draw_count;
+};
+
+// Frustum culling of the culling set on the GPU, as a pass of the async compute queue
+// (see async_compute.h). Each draw is an object of the set and a mesh: the compute pass
+// writes the instance count of its indirect draw, 0 when the sphere is outside, and the
+// frame's graphics work waits for it on the draw indirect stage.
+// The per frame buffers are host visible and shared by both queue families: the CPU
+// writes the bounds & the draw commands, the compute pass only their instance counts.
+// Only with an async compute family: without one, cull() on the worker pool is cheaper
+// than a dispatch on the graphics queue, and the draws are direct
+struct sGpuCulling {
+    bool                  is_enabled = false;
+    sMeshHandle           meshes[GPU_CULLING_MAX_DRAWS];
+    uint32_t              cull_ids[GPU_CULLING_MAX_DRAWS]; // On the culling set
+    uint32_t              draw_count = 0;
+
+    VkBuffer              *bounds_buffers = NULL; // Per frame, a vec4 (center, radius) per draw
+    VkDeviceMemory        *bounds_memories = NULL;
+    glm::vec4             **bounds_mapped = NULL;
+    VkBuffer              *draw_buffers = NULL; // Per frame, a VkDrawIndexedIndirectCommand per draw
+    VkDeviceMemory        *draw_memories = NULL;
+    VkDrawIndexedIndirectCommand **draw_mapped = NULL;
+    sFrustum              *frustums = NULL; // Per frame, for the pass
+    uint32_t              frame_count = 0;
+
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool      descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet       *descriptor_sets = NULL;
+    VkPipelineLayout      pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline            pipeline = VK_NULL_HANDLE;
+
+    sCullingSet           *culling_set = NULL;
+    sApp                  *app = NULL;
+
+    // After the async compute init, it adds its pass there. Off without an async family
+    void init(sApp *application,
+              sCullingSet *set,
+              const uint32_t frames_in_flight);
+
+    uint32_t add_draw(const sMeshHandle &mesh,
+                      const uint32_t cull_id);
+
+    // Before the frame's compute submit: the current bounds, and the frustum to test them on
+    void begin_frame(const uint32_t frame,
+                     const sFrustum &frustum);
+
+    // On the frame's graphics command buffer, after the geometry pool bind
+    inline void draw(const VkCommandBuffer &command_buffer,
+                     const uint32_t frame,
+                     const uint32_t draw_id,
+                     sGeometryPool *geometry_pool) const {
+        geometry_pool->draw_indirect(command_buffer,
+                                     meshes[draw_id],
+                                     draw_buffers[frame],
+                                     sizeof(VkDrawIndexedIndirectCommand) * draw_id);
+    }
+
+    // NOTE: once the device is idle
+    void cleanup();
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+
+// Binary semaphores a submit can signal, besides the timeline
+#define GPU_TIMELINE_MAX_SIGNALS 4
+// Semaphores a submit can wait on, binary & timeline ones
+#define GPU_TIMELINE_MAX_WAITS   4
+
+// A value of a timeline (of another queue, or of this one) that a submit waits for
+struct sGpuTimelineWait {
+    VkSemaphore          semaphore;
+    uint64_t             value;
+    VkPipelineStageFlags stages; // Only these stages of the submit wait
+};
+
+// A timeline semaphore (core on Vulkan 1.2) per queue: every submit signals the next
+// value, so "is this work done" is a single comparison against the completed value.
+// It replaces the fences per frame & per upload, and vkQueueWaitIdle
+struct sGpuTimeline {
+    VkSemaphore           semaphore = VK_NULL_HANDLE;
+    std::atomic<uint64_t> last_submitted = {0};
+    std::atomic<uint64_t> last_completed = {0}; // Cached, refreshed on the queries
+
+    VkDevice              *device = NULL;
+
+    void init(VkDevice *vk_device) {
+        device = vk_device;
+
+        VkSemaphoreTypeCreateInfo type_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext = NULL,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        };
+        VkSemaphoreCreateInfo create_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &type_info,
+        };
+        VK_OK(vkCreateSemaphore(*device,
+                                &create_info,
+                                NULL,
+                                &semaphore),
+              "Create timeline semaphore");
+    }
+
+    // Signals the next value after the submit's own semaphores (the binary ones of the swapchain),
+    // and waits for the timeline values besides the submit's binary waits.
+    // NOTE: with the queue's lock held, so the values reach the queue in order
+    uint64_t submit(const VkQueue &queue,
+                    const VkSubmitInfo &submit_info,
+                    const sGpuTimelineWait *timeline_waits = NULL,
+                    const uint32_t timeline_wait_count = 0) {
+        assert_msg(submit_info.signalSemaphoreCount < GPU_TIMELINE_MAX_SIGNALS, "Too many semaphores signaled on a submit");
+        assert_msg(submit_info.waitSemaphoreCount + timeline_wait_count <= GPU_TIMELINE_MAX_WAITS, "Too many semaphores waited on a submit");
+
+        const uint64_t value = last_submitted.load(std::memory_order_relaxed) + 1;
+
+        VkSemaphore signal_semaphores[GPU_TIMELINE_MAX_SIGNALS];
+        uint64_t signal_values[GPU_TIMELINE_MAX_SIGNALS] = {}; // Ignored for the binary ones
+        const uint32_t signal_count = submit_info.signalSemaphoreCount + 1;
+        for(uint32_t i = 0; i < submit_info.signalSemaphoreCount; i++) {
+            signal_semaphores[i] = submit_info.pSignalSemaphores[i];
+        }
+        signal_semaphores[signal_count - 1] = semaphore;
+        signal_values[signal_count - 1] = value;
+
+        // The timeline waits after the binary ones
+        VkSemaphore wait_semaphores[GPU_TIMELINE_MAX_WAITS];
+        VkPipelineStageFlags wait_stages[GPU_TIMELINE_MAX_WAITS];
+        uint64_t wait_values[GPU_TIMELINE_MAX_WAITS] = {}; // Ignored for the binary ones
+        const uint32_t wait_count = submit_info.waitSemaphoreCount + timeline_wait_count;
+        for(uint32_t i = 0; i < submit_info.waitSemaphoreCount; i++) {
+            wait_semaphores[i] = submit_info.pWaitSemaphores[i];
+            wait_stages[i] = submit_info.pWaitDstStageMask[i];
+        }
+        for(uint32_t i = 0; i < timeline_wait_count; i++) {
+            wait_semaphores[submit_info.waitSemaphoreCount + i] = timeline_waits[i].semaphore;
+            wait_stages[submit_info.waitSemaphoreCount + i] = timeline_waits[i].stages;
+            wait_values[submit_info.waitSemaphoreCount + i] = timeline_waits[i].value;
+        }
+
+        VkTimelineSemaphoreSubmitInfo timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .pNext = submit_info.pNext,
+            .waitSemaphoreValueCount = (timeline_wait_count > 0) ? wait_count : 0,
+            .pWaitSemaphoreValues = (timeline_wait_count > 0) ? wait_values : NULL,
+            .signalSemaphoreValueCount = signal_count,
+            .pSignalSemaphoreValues = signal_values
+        };
+
+        VkSubmitInfo timeline_submit = submit_info;
+        timeline_submit.pNext = &timeline_info;
+        timeline_submit.waitSemaphoreCount = wait_count;
+        timeline_submit.pWaitSemaphores = wait_semaphores;
+        timeline_submit.pWaitDstStageMask = wait_stages;
+        timeline_submit.signalSemaphoreCount = signal_count;
+        timeline_submit.pSignalSemaphores = signal_semaphores;
+
+        VK_OK(vkQueueSubmit(queue,
+                            1,
+                            &timeline_submit,
+                            VK_NULL_HANDLE),
+              "Submit on the timeline");
+
+        last_submitted.store(value, std::memory_order_release);
+        return value;
+    }
+
+    bool is_complete(const uint64_t value) {
+        if (value <= last_completed.load(std::memory_order_acquire)) {
+            return true;
+        }
+
+        uint64_t completed = 0;
+        VK_OK(vkGetSemaphoreCounterValue(*device,
+                                         semaphore,
+                                         &completed),
+              "Query timeline value");
+        _store_completed(completed);
+        return value <= completed;
+    }
+
+    // Blocks until the GPU reaches the value, 0 returns immediately
+    void wait(const uint64_t value) {
+        if (is_complete(value)) {
+            return;
+        }
+
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &semaphore,
+            .pValues = &value
+        };
+        VK_OK(vkWaitSemaphores(*device,
+                               &wait_info,
+                               UINT64_MAX),
+              "Wait for the timeline");
+        _store_completed(value);
+    }
+
+    void cleanup() {
+        vkDestroySemaphore(*device, semaphore, NULL);
+    }
+
+    // Several threads query it, never let the cache go back
+    inline void _store_completed(const uint64_t value) {
+        uint64_t cached = last_completed.load(std::memory_order_relaxed);
+        while(cached < value &&
+              !last_completed.compare_exchange_weak(cached, value, std::memory_order_release)) {}
+    }
+};
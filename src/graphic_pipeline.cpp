@@ -2,6 +2,7 @@
 #include "shader.h"
 #include <cstddef>
 #include <stdint.h>
+#include <math.h>
 #include <vulkan/vulkan_core.h>
 
 #include "mesh.h"
@@ -22,8 +23,9 @@ void sApp::_create_graphics_pipeline() {
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR // This is used the color of the swapchain
+            // The transitions from the acquire & to present are on the render graph barriers
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
         };
     }
 
@@ -45,16 +47,7 @@ void sApp::_create_graphics_pipeline() {
     // RENDER-PASS: RENDERPASS CREATE ====
     // ===================================
     {
-         // Subpass transition (??)
-        VkSubpassDependency dependency = {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = 0,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
-        };
-
+        // No subpass dependency: the render graph places the barrier with the acquire
         VkRenderPassCreateInfo renderpass_create_info = {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
             .pNext = NULL,
@@ -62,8 +55,8 @@ void sApp::_create_graphics_pipeline() {
             .pAttachments = &color_attachments,
             .subpassCount = 1,
             .pSubpasses = &render_subpass,
-            .dependencyCount = 1,
-            .pDependencies = &dependency
+            .dependencyCount = 0,
+            .pDependencies = NULL
         };
 
         VK_OK(vkCreateRenderPass(Vulkan.device, 
@@ -84,8 +77,9 @@ void sApp::_create_graphics_pipeline() {
                         "resources/shaders/vertex.spv", 
                         &vert_shader);
 
+        // The bindless one indexes the texture table with a push constant
         create_shader_module(Vulkan.device, 
-                            "resources/shaders/frag.spv", 
+                            (Vulkan.use_bindless) ? "resources/shaders/bindless_frag.spv" : "resources/shaders/frag.spv", 
                             &frag_shader);
 
         shader_stages_create_info[0] = {
@@ -109,18 +103,13 @@ void sApp::_create_graphics_pipeline() {
     // ===================================
     // VERTEX INPUT STAGE ================
     // ===================================
+    // Meshes of the geometry pool are stored quantized, but the streamed sprites
+    // are full float sVertex2D, so they get their own pipeline
     VkPipelineVertexInputStateCreateInfo vertex_input_stage_create_info;
+    VkPipelineVertexInputStateCreateInfo sprite_vertex_input_stage_create_info;
     {
-        // TODO: no vertecies for now, so this is kinda empty
-        uint32_t biding_descr, attribute_descr;
-        vertex_input_stage_create_info = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .pNext = NULL,
-            .vertexBindingDescriptionCount = 1,
-            .pVertexBindingDescriptions = Geometry::get_2D_biding_description(&biding_descr),
-            .vertexAttributeDescriptionCount = 3,
-            .pVertexAttributeDescriptions = Geometry::get_2D_attribute_description(&attribute_descr)
-        };
+        vertex_input_stage_create_info = Geometry::sVertex2DCompactLayout::input_state();
+        sprite_vertex_input_stage_create_info = Geometry::sVertex2DLayout::input_state();
     }
 
     // ===================================
@@ -258,13 +247,21 @@ void sApp::_create_graphics_pipeline() {
     // PIPELINE LAYOUT ===================
     // ===================================
     {
+        VkDescriptorSetLayout set_layouts[2] = { Vulkan.descriptor_set_layout, bindless_table.layout };
+
+        VkPushConstantRange push_constant_range = {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(sBindlessPushConstants)
+        };
+
         VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .pNext = NULL,
-            .setLayoutCount = 1,
-            .pSetLayouts = &Vulkan.descriptor_set_layout,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = NULL
+            .setLayoutCount = (Vulkan.use_bindless) ? 2u : 1u,
+            .pSetLayouts = set_layouts,
+            .pushConstantRangeCount = (Vulkan.use_bindless) ? 1u : 0u,
+            .pPushConstantRanges = &push_constant_range
         };
 
         VK_OK(vkCreatePipelineLayout(Vulkan.device, 
@@ -279,7 +276,8 @@ void sApp::_create_graphics_pipeline() {
     // CREATE PIPELINE ===================
     // ===================================
     {
-        VkGraphicsPipelineCreateInfo pipeline_create_info = {
+        VkGraphicsPipelineCreateInfo pipeline_create_info[2];
+        pipeline_create_info[0] = {
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = NULL,
             .flags = 0,
@@ -300,13 +298,21 @@ void sApp::_create_graphics_pipeline() {
             .basePipelineIndex = -1
         };
 
+        // Same state, different vertex input
+        pipeline_create_info[1] = pipeline_create_info[0];
+        pipeline_create_info[1].pVertexInputState = &sprite_vertex_input_stage_create_info;
+
+        VkPipeline pipelines[2];
         VK_OK(vkCreateGraphicsPipelines(Vulkan.device, 
                                         NULL, 
-                                        1, 
-                                        &pipeline_create_info, 
+                                        2, 
+                                        pipeline_create_info, 
                                         NULL, 
-                                        &Vulkan.graphics_pipeline),
+                                        pipelines),
               "Creating graphcis pipeline");
+
+        Vulkan.graphics_pipeline = pipelines[0];
+        Vulkan.sprite_pipeline = pipelines[1];
     }
 }
 
@@ -341,106 +347,6 @@ void sApp::_create_framebuffers() {
     }
 }
 
-uint32_t find_memmory_type(const VkPhysicalDevice &phys_device,
-                           const  uint32_t type_filter, 
-                           const VkMemoryPropertyFlags &properties);
-
-void sApp::_create_vertex_buffer() {
-    VkDeviceSize buffer_size = sizeof(Geometry::Meshes::Quad::vertices);
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    create_buffer(buffer_size, 
-                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  &staging_buffer, 
-                  &staging_buffer_memory);
-
-    // Upload Data to the stating buffer's memory
-    void *upload_data;
-    VK_OK(vkMapMemory(Vulkan.device, 
-                     staging_buffer_memory,
-                     0, // Offset on the memory
-                     buffer_size, 
-                     0, // Flags, but there are none on the api
-                     &upload_data), 
-         "Mapping memory");
-    
-    memcpy(upload_data, 
-           (void*) Geometry::Meshes::Quad::vertices, 
-           buffer_size);
-    
-    vkUnmapMemory(Vulkan.device, 
-                  staging_buffer_memory);
-    
-    
-    create_buffer(buffer_size, 
-                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, // More optimal layout in memory
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-                  &Vulkan.vertex_buffer, 
-                  &Vulkan.vertex_buffer_memmory);
-
-    copy_buffer(staging_buffer, 
-                Vulkan.vertex_buffer, 
-                buffer_size);
-
-    vkDestroyBuffer(Vulkan.device, 
-                    staging_buffer, 
-                    NULL);
-    vkFreeMemory(Vulkan.device, 
-                 staging_buffer_memory, 
-                 NULL);
-}
-
-void sApp::_create_index_buffer() {
-    VkDeviceSize buffer_size = sizeof(Geometry::Meshes::Quad::indices);
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    create_buffer(buffer_size, 
-                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  &staging_buffer, 
-                  &staging_buffer_memory);
-
-    // Upload Data to the stating buffer's memory
-    void *upload_data;
-    VK_OK(vkMapMemory(Vulkan.device, 
-                     staging_buffer_memory,
-                     0, // Offset on the memory
-                     buffer_size, 
-                     0, // Flags, but there are none on the api
-                     &upload_data), 
-         "Mapping memory");
-    
-    memcpy(upload_data, 
-           (void*) Geometry::Meshes::Quad::indices, 
-           buffer_size);
-    
-    vkUnmapMemory(Vulkan.device, 
-                  staging_buffer_memory);
-    
-    
-    create_buffer(buffer_size, 
-                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, // More optimal layout in memory
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-                  &Vulkan.index_buffer, 
-                  &Vulkan.index_buffer_memory);
-
-    copy_buffer(staging_buffer, 
-                Vulkan.index_buffer, 
-                buffer_size);
-
-    vkDestroyBuffer(Vulkan.device, 
-                    staging_buffer, 
-                    NULL);
-    vkFreeMemory(Vulkan.device, 
-                 staging_buffer_memory, 
-                 NULL);
-}
-
 void sApp::_create_command_buffers() {
     // ===================================
     // CREATE CMD POOL ===================
@@ -463,15 +369,32 @@ void sApp::_create_command_buffers() {
     // ===================================
     // Vertex & indices buffer ===========
     // ===================================
-    sApp::_create_vertex_buffer();
-    sApp::_create_index_buffer();
-    sApp::_create_uniform_buffers();
+    sApp::_create_geometry_pool();
+    quad_mesh = import_mesh("Quad",
+                            Geometry::Meshes::Quad::vertices,
+                            Geometry::Meshes::Quad::vertices_count,
+                            Geometry::Meshes::Quad::indices,
+                            Geometry::Meshes::Quad::indices_count);
 
-    create_image("resources/bop.jpg", 
-                 &texture);
+    // The quad spins around Z, so bound it with a sphere
+    {
+        culling_set.init();
+
+        float max_length = 0.0f;
+        for(uint32_t i = 0; i < Geometry::Meshes::Quad::vertices_count; i++) {
+            const glm::vec2 &position = Geometry::Meshes::Quad::vertices[i].position;
+            max_length = glm::max(max_length, sqrtf(position.x * position.x + position.y * position.y));
+        }
+        quad_cull_id = culling_set.add_sphere(glm::vec3(0.0f, 0.0f, 0.0f),
+                                              max_length);
+    }
+    sApp::_create_sprite_batcher();
+    sApp::_create_uniform_buffers();
 
-    texture.create_image_view();
-    texture.create_sampler();
+    // The texture is decoded & uploaded on the background, the placeholder is bound meanwhile
+    texture_streamer.init(this, 
+                          &worker_pool);
+    main_texture = texture_streamer.request("resources/bop.jpg");
 
     sApp::_create_descriptor_pool_and_set();
 
@@ -483,9 +406,11 @@ void sApp::_create_command_buffers() {
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
             .commandPool = Vulkan.command_pool,
             .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY, // Sbumited directly, not from other command buffers (?)
-            .commandBufferCount = MAX_FRAMES_IN_FLIGHT
+            .commandBufferCount = Vulkan.frame_count
         };
 
+        Vulkan.command_buffers = (VkCommandBuffer*) malloc(sizeof(VkCommandBuffer) * Vulkan.frame_count);
+
         VK_OK(vkAllocateCommandBuffers(Vulkan.device, 
                                        &command_buff_alloc_info, 
                                        Vulkan.command_buffers),
@@ -497,56 +422,98 @@ void sApp::_create_command_buffers() {
 // ===================================
 // COMMAND BUFFER FUNCS
 
-void sApp::record_command_buffer(const VkCommandBuffer &command_buffer,
-                                 const VkRenderPass &render_pass,
-                                 const uint32_t image_index) {
-    VkCommandBufferBeginInfo cmd_buff_begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = NULL,
-        .flags = 0,
-        .pInheritanceInfo = NULL,
-    };
+struct sMainPassData {
+    sApp         *app;
+    VkRenderPass render_pass;
+    uint32_t     image_index;
+    // With dynamic resolution: the scene target, rendered on render_extent of it
+    uint32_t     scene_target;
+    VkExtent2D   render_extent;
+};
+
+struct sUpscalePassData {
+    sApp       *app;
+    uint32_t   image_index;
+    uint32_t   scene_target;
+    VkExtent2D render_extent;
+};
+
+struct sShrinkPassData {
+    sTextureStreamer *texture_streamer;
+    uint32_t         index;
+};
+
+// The tiles that finished loading, on the atlas
+static void record_tile_upload_pass(const VkCommandBuffer &command_buffer,
+                                    const sRenderGraph &graph,
+                                    void *data) {
+    sTileCache *tile_cache = (sTileCache*) data;
+    tile_cache->record_transfers(command_buffer);
+}
 
-    VK_OK(vkBeginCommandBuffer(command_buffer, 
-                              &cmd_buff_begin_info), 
-          "Begin recording of command buffer");
+// A texture shrunk this frame, before it is sampled
+static void record_shrink_pass(const VkCommandBuffer &command_buffer,
+                               const sRenderGraph &graph,
+                               void *data) {
+    const sShrinkPassData *shrink_pass = (const sShrinkPassData*) data;
+    shrink_pass->texture_streamer->record_shrink(command_buffer,
+                                                 shrink_pass->index);
+}
+
+static void record_main_pass(const VkCommandBuffer &command_buffer,
+                             const sRenderGraph &graph,
+                             void *data) {
+    const sMainPassData *main_pass = (const sMainPassData*) data;
+    sApp *app = main_pass->app;
+
+    // Straight to the swapchain image, or to the scene target of the upscale
+    VkFramebuffer framebuffer = app->Vulkan.framebuffers[main_pass->image_index];
+    if (app->dynamic_resolution.is_enabled) {
+        framebuffer = app->dynamic_resolution.get_framebuffer(graph.get_image_view(main_pass->scene_target),
+                                                              graph.transient_generation,
+                                                              app->Vulkan.swapchain_info.swapchain_extent);
+    }
 
     // Config the render pass
     VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
     VkRenderPassBeginInfo render_pass_begin_info = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .pNext = NULL,
-        .renderPass = render_pass,
-        .framebuffer = Vulkan.framebuffers[image_index],
+        .renderPass = main_pass->render_pass,
+        .framebuffer = framebuffer,
         .renderArea = { 
             .offset = {0, 0},
-            .extent = Vulkan.swapchain_info.swapchain_extent
+            .extent = main_pass->render_extent
         },
         .clearValueCount = 1,
         .pClearValues = &clear_color
     };
 
+    // The scene's own GPU time, for the render scale
+    app->frame_pacer.record_scene_begin(command_buffer,
+                                        app->Vulkan.current_frame);
+
     vkCmdBeginRenderPass(command_buffer, 
                          &render_pass_begin_info, 
                          VK_SUBPASS_CONTENTS_INLINE); // The commands will be embedded on the primery command buffer
     
     vkCmdBindPipeline(command_buffer, 
                       VK_PIPELINE_BIND_POINT_GRAPHICS, // Graphis pipeline, not compute
-                      Vulkan.graphics_pipeline);
+                      app->Vulkan.graphics_pipeline);
 
     // Set the viewport and the scissor
     {
         VkViewport viewport = {
             .x = 0.0f, .y = 0.0f,
-            .width = (float) Vulkan.swapchain_info.swapchain_extent.width,
-            .height = (float) Vulkan.swapchain_info.swapchain_extent.height,
+            .width = (float) main_pass->render_extent.width,
+            .height = (float) main_pass->render_extent.height,
             .minDepth = 0.0f,
             .maxDepth = 1.0f
         };
 
         VkRect2D scissor = {
             .offset = {0, 0},
-            .extent = Vulkan.swapchain_info.swapchain_extent
+            .extent = main_pass->render_extent
         };
 
         vkCmdSetViewport(command_buffer, 
@@ -559,45 +526,272 @@ void sApp::record_command_buffer(const VkCommandBuffer &command_buffer,
                         &scissor);
     }
 
-    // Bind the vertex buffer =======================
-    {
-        vkCmdBindPipeline(command_buffer, 
-                         VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                         Vulkan.graphics_pipeline);
-        
-        VkBuffer vertex_buffers[] = {Vulkan.vertex_buffer};
-        VkDeviceSize offsets[] = {0, 0};
-
-        vkCmdBindVertexBuffers(command_buffer, 
-                               0, 
-                               1, 
-                               vertex_buffers, 
-                               offsets);
-
-        vkCmdBindIndexBuffer(command_buffer, 
-                            Vulkan.index_buffer, 
-                            0, // offset
-                            VK_INDEX_TYPE_UINT32);
-    }
+    // Bind the shared geometry buffers =============
+    app->geometry_pool.bind(command_buffer);
 
     vkCmdBindDescriptorSets(command_buffer, 
                             VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                            Vulkan.pipeline_layout, 
+                            app->Vulkan.pipeline_layout, 
                             0, 
                             1, 
-                            &Vulkan.descriptor_sets[Vulkan.current_frame], 
+                            &app->Vulkan.descriptor_sets[app->Vulkan.current_frame], 
                             0, 
                             NULL);
 
-    vkCmdDrawIndexed(command_buffer, 
-                     Geometry::Meshes::Quad::indices_count, // Vertex count 
-                     1, // instance count instanced rendering
-                     0, // first vertex
-                     0,
-                     0); // first isntance
+    // The whole texture table, once per command buffer. The draws only push the index
+    if (app->Vulkan.use_bindless) {
+        vkCmdBindDescriptorSets(command_buffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                app->Vulkan.pipeline_layout,
+                                BINDLESS_SET_INDEX,
+                                1,
+                                &app->bindless_table.set,
+                                0,
+                                NULL);
+
+        const sBindlessPushConstants push_constants = {
+            .texture_index = app->texture_streamer.get_bindless_index(app->main_texture)
+        };
+        vkCmdPushConstants(command_buffer,
+                           app->Vulkan.pipeline_layout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0,
+                           sizeof(sBindlessPushConstants),
+                           &push_constants);
+    }
+
+    // The instance count comes from the frame's culling pass, 0 when it is outside.
+    // Otherwise skip what was culled on _render_frame
+    if (!app->tile_cache.is_open) {
+        if (app->gpu_culling.is_enabled) {
+            app->gpu_culling.draw(command_buffer,
+                                  app->Vulkan.current_frame,
+                                  app->quad_draw_id,
+                                  &app->geometry_pool);
+        } else if (app->culling_set.is_visible[app->quad_cull_id]) {
+            app->geometry_pool.draw(command_buffer, 
+                                    app->quad_mesh);
+        }
+    }
+
+    // Streamed sprites of this frame, one draw per texture/pipeline change
+    app->sprite_batcher.flush(command_buffer, 
+                              app->Vulkan.pipeline_layout);
             
     vkCmdEndRenderPass(command_buffer);
 
+    app->frame_pacer.record_scene_end(command_buffer,
+                                      app->Vulkan.current_frame);
+}
+
+// The scene target stretched to the swapchain image, on the same render pass
+static void record_upscale_pass(const VkCommandBuffer &command_buffer,
+                                const sRenderGraph &graph,
+                                void *data) {
+    const sUpscalePassData *upscale_pass = (const sUpscalePassData*) data;
+    sApp *app = upscale_pass->app;
+
+    VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = NULL,
+        .renderPass = app->Vulkan.render_pass,
+        .framebuffer = app->Vulkan.framebuffers[upscale_pass->image_index],
+        .renderArea = {
+            .offset = {0, 0},
+            .extent = app->Vulkan.swapchain_info.swapchain_extent
+        },
+        .clearValueCount = 1,
+        .pClearValues = &clear_color
+    };
+
+    vkCmdBeginRenderPass(command_buffer,
+                         &render_pass_begin_info,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    app->dynamic_resolution.record_upscale(command_buffer,
+                                           app->Vulkan.current_frame,
+                                           graph.get_image_view(upscale_pass->scene_target),
+                                           graph.transient_generation,
+                                           app->Vulkan.swapchain_info.swapchain_extent,
+                                           upscale_pass->render_extent);
+
+    vkCmdEndRenderPass(command_buffer);
+}
+
+void sApp::record_command_buffer(const VkCommandBuffer &command_buffer,
+                                 const VkRenderPass &render_pass,
+                                 const uint32_t image_index) {
+    VkCommandBufferBeginInfo cmd_buff_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = 0,
+        .pInheritanceInfo = NULL,
+    };
+
+    VK_OK(vkBeginCommandBuffer(command_buffer, 
+                              &cmd_buff_begin_info), 
+          "Begin recording of command buffer");
+
+    // The frame's passes, and the barriers in between (see render_graph.h)
+    {
+        render_graph.reset();
+
+        // Available once the acquire semaphore is waited, on the color output stage
+        const sRGState acquired_state = {
+            .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .write_stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .write_access = 0,
+            .read_stages = 0
+        };
+        const uint32_t swapchain_image = render_graph.import_image("Swapchain",
+                                                                   Vulkan.swapchain_images[image_index],
+                                                                   Vulkan.swapchain_image_views[image_index],
+                                                                   Vulkan.swapchain_info.selected_format.format,
+                                                                   Vulkan.swapchain_info.swapchain_extent,
+                                                                   acquired_state,
+                                                                   VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                                   true);
+
+        // Sampled by the previous frames, which are before on the queue
+        const sRGState sampled_state = {
+            .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .write_stages = 0,
+            .write_access = 0,
+            .read_stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT
+        };
+
+        // The copies of the frame, and the textures the main pass samples after them
+        uint32_t sampled_images[RG_MAX_PASS_ACCESSES];
+        uint32_t sampled_image_count = 0;
+
+        if (tile_cache.is_open) {
+            uint32_t atlas = render_graph.import_image("Tile atlas",
+                                                       tile_cache.atlas.texture_image,
+                                                       tile_cache.atlas.texture_image_view,
+                                                       tile_cache.atlas.format,
+                                                       { tile_cache.atlas.width, tile_cache.atlas.height },
+                                                       sampled_state,
+                                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                       true);
+            if (tile_cache.copy_count > 0) {
+                const uint32_t upload_pass = render_graph.add_pass("Tile uploads",
+                                                                   record_tile_upload_pass,
+                                                                   &tile_cache);
+                atlas = render_graph.write(upload_pass,
+                                           atlas,
+                                           RG_ACCESS_TRANSFER_WRITE);
+            }
+            sampled_images[sampled_image_count++] = atlas;
+        }
+
+        // The old image is retired after the copy, so it is left on TRANSFER_SRC
+        const sRGState new_image_state = {
+            .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .write_stages = 0,
+            .write_access = 0,
+            .read_stages = 0
+        };
+        for(uint32_t i = 0; i < texture_streamer.shrink_count; i++) {
+            const sTextureShrink &shrink = texture_streamer.shrinks[i];
+            const VkExtent2D target_extent = { shrink.width, shrink.height };
+            // The extents of the imported images are not used, only their barriers
+            const uint32_t source = render_graph.import_image("Shrink source",
+                                                              shrink.source,
+                                                              VK_NULL_HANDLE,
+                                                              shrink.format,
+                                                              target_extent,
+                                                              sampled_state,
+                                                              VK_IMAGE_LAYOUT_UNDEFINED,
+                                                              false);
+            const uint32_t target = render_graph.import_image("Shrink target",
+                                                              shrink.target,
+                                                              VK_NULL_HANDLE,
+                                                              shrink.format,
+                                                              target_extent,
+                                                              new_image_state,
+                                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                              true);
+
+            sShrinkPassData *shrink_pass_data = frame_allocator.alloc_array<sShrinkPassData>(1);
+            *shrink_pass_data = {
+                .texture_streamer = &texture_streamer,
+                .index = i
+            };
+            const uint32_t shrink_pass = render_graph.add_pass("Texture shrink",
+                                                               record_shrink_pass,
+                                                               shrink_pass_data);
+            render_graph.read(shrink_pass,
+                              source,
+                              RG_ACCESS_TRANSFER_READ);
+            sampled_images[sampled_image_count++] = render_graph.write(shrink_pass,
+                                                                       target,
+                                                                       RG_ACCESS_TRANSFER_WRITE);
+        }
+
+        // Full size, only its top left render_extent is drawn. So it does not
+        // change with the scale, and neither does its framebuffer
+        const VkExtent2D &swapchain_extent = Vulkan.swapchain_info.swapchain_extent;
+        const VkExtent2D render_extent = dynamic_resolution.get_render_extent(swapchain_extent);
+        uint32_t scene_target = swapchain_image;
+        if (dynamic_resolution.is_enabled) {
+            scene_target = render_graph.create_image("Scene",
+                                                     Vulkan.swapchain_info.selected_format.format,
+                                                     swapchain_extent);
+        }
+
+        // Read on execute, so it lives on the frame allocator
+        sMainPassData *main_pass_data = frame_allocator.alloc_array<sMainPassData>(1);
+        const uint32_t main_pass = render_graph.add_pass("Main",
+                                                         record_main_pass,
+                                                         main_pass_data);
+        scene_target = render_graph.write(main_pass,
+                                          scene_target,
+                                          RG_ACCESS_COLOR_ATTACHMENT);
+        for(uint32_t i = 0; i < sampled_image_count; i++) {
+            render_graph.read(main_pass,
+                              sampled_images[i],
+                              RG_ACCESS_FRAGMENT_SAMPLED);
+        }
+        *main_pass_data = {
+            .app = this,
+            .render_pass = render_pass,
+            .image_index = image_index,
+            .scene_target = scene_target,
+            .render_extent = render_extent
+        };
+
+        if (dynamic_resolution.is_enabled) {
+            sUpscalePassData *upscale_pass_data = frame_allocator.alloc_array<sUpscalePassData>(1);
+            *upscale_pass_data = {
+                .app = this,
+                .image_index = image_index,
+                .scene_target = scene_target,
+                .render_extent = render_extent
+            };
+            const uint32_t upscale_pass = render_graph.add_pass("Upscale",
+                                                                record_upscale_pass,
+                                                                upscale_pass_data);
+            render_graph.read(upscale_pass,
+                              scene_target,
+                              RG_ACCESS_FRAGMENT_SAMPLED);
+            render_graph.write(upscale_pass,
+                               swapchain_image,
+                               RG_ACCESS_COLOR_ATTACHMENT);
+        }
+
+        render_graph.compile();
+    }
+
+    // The GPU time of the whole frame, for the pacer's predictions
+    frame_pacer.record_begin(command_buffer,
+                             Vulkan.current_frame);
+
+    render_graph.execute(command_buffer);
+
+    frame_pacer.record_end(command_buffer,
+                           Vulkan.current_frame);
+
     VK_OK(vkEndCommandBuffer(command_buffer), 
           "End Command buffer");
 }
@@ -609,15 +803,13 @@ void sApp::_create_sync_objects() {
         .pNext = NULL,
     };
 
-    VkFenceCreateInfo fence_create_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .pNext = NULL,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
-    };
+    Vulkan.image_available_semaphore = (VkSemaphore*) malloc(sizeof(VkSemaphore) * Vulkan.frame_count);
+    Vulkan.render_finished_semaphore = (VkSemaphore*) malloc(sizeof(VkSemaphore) * Vulkan.frame_count);
+    // Nothing submitted yet, the value 0 is already reached
+    Vulkan.frame_timeline_values = (uint64_t*) calloc(Vulkan.frame_count, sizeof(uint64_t));
 
-    for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
         VK_OK(vkCreateSemaphore(Vulkan.device, &semaphore_create_info, NULL, &Vulkan.image_available_semaphore[i]), "Create semaphore");
         VK_OK(vkCreateSemaphore(Vulkan.device, &semaphore_create_info, NULL, &Vulkan.render_finished_semaphore[i]), "Create semaphore");
-        VK_OK(vkCreateFence(Vulkan.device, &fence_create_info, NULL, &Vulkan.in_flight_fence[i]), "Create fence");
     }
 }
\ No newline at end of file
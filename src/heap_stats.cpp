@@ -0,0 +1,69 @@
+#include "heap_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// Plain data, so using it from inside malloc never allocates
+static thread_local uint64_t thread_allocation_count = 0;
+static std::atomic<uint64_t> allocation_count = {0};
+
+static inline void count_allocation() {
+    thread_allocation_count++;
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t get_thread_heap_allocation_count() {
+    return thread_allocation_count;
+}
+
+uint64_t get_heap_allocation_count() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+// Interposed over glibc's, for this code, the libraries & operator new (which uses malloc)
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void *pointer, size_t size);
+
+    void* malloc(size_t size) noexcept {
+        count_allocation();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept {
+        count_allocation();
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void *pointer, size_t size) noexcept {
+        count_allocation();
+        return __libc_realloc(pointer, size);
+    }
+}
+#else
+// Without glibc only operator new is counted, the rest of the new & delete operators
+// are defined with it, and free() matches its malloc()
+void* operator new(size_t size) {
+    count_allocation();
+    void *pointer = malloc((size > 0) ? size : 1);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer,
+                     size_t size) noexcept {
+    free(pointer);
+}
+#endif
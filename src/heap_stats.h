@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+
+// Counts of heap allocations (malloc, calloc, realloc & operator new), to check that
+// the frame loop does not allocate: the difference of the thread's count around it
+
+// Of the calling thread, since it started
+uint64_t get_thread_heap_allocation_count();
+
+// Of every thread, since the start
+uint64_t get_heap_allocation_count();
@@ -25,14 +25,19 @@ void sApp::create_buffer(const VkDeviceSize &size,
                          const VkBufferUsageFlags usage,
                          const VkMemoryPropertyFlags memmory_properties, 
                          VkBuffer *buffer, 
-                         VkDeviceMemory *buffer_memory) {
+                         VkDeviceMemory *buffer_memory,
+                         const VkSharingMode sharing_mode,
+                         const uint32_t family_count,
+                         const uint32_t *family_indices) {
     // Create Buffer
     VkBufferCreateInfo vertex_buffer_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = NULL,
         .size = size,
         .usage = usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+        .sharingMode = sharing_mode,
+        .queueFamilyIndexCount = (sharing_mode == VK_SHARING_MODE_CONCURRENT) ? family_count : 0,
+        .pQueueFamilyIndices = (sharing_mode == VK_SHARING_MODE_CONCURRENT) ? family_indices : NULL
     };
 
     VK_OK(vkCreateBuffer(Vulkan.device, 
@@ -127,12 +132,15 @@ void sApp::end_single_time_commands(const VkCommandBuffer &command_buffer) {
         .pCommandBuffers = &command_buffer
     };
 
-    vkQueueSubmit(Vulkan.graphics_queue, 
-                  1,
-                  &submit_info, 
-                  VK_NULL_HANDLE);
+    uint64_t submitted_value;
+    {
+        std::lock_guard<std::mutex> lock(Vulkan.graphics_queue_mutex);
+        submitted_value = Vulkan.graphics_timeline.submit(Vulkan.graphics_queue,
+                                                          submit_info);
+    }
 
-    vkQueueWaitIdle(Vulkan.graphics_queue); // Note a fence could allow multiple transfers at the same time!
+    // Only for this submit, not the frames in flight (unlike vkQueueWaitIdle)
+    Vulkan.graphics_timeline.wait(submitted_value);
 
     vkFreeCommandBuffers(Vulkan.device, 
                          Vulkan.command_pool, 
@@ -146,7 +154,8 @@ void sApp::end_single_time_commands(const VkCommandBuffer &command_buffer) {
 void sApp::transition_image_layout(const VkImage &image, 
                                    const VkFormat &format, 
                                    const VkImageLayout &old_layout, 
-                                   const VkImageLayout &new_layout) {
+                                   const VkImageLayout &new_layout,
+                                   const uint32_t mip_levels) {
     VkCommandBuffer command_buffer = being_single_time_commands();
 
     VkAccessFlags source_access_mask;
@@ -188,7 +197,7 @@ void sApp::transition_image_layout(const VkImage &image,
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, // Only get the color data
             .baseMipLevel = 0, // For mipmapping
-            .levelCount = 1,
+            .levelCount = mip_levels,
             .baseArrayLayer = 0, // for layered / 3d textures
             .layerCount = 1
         }
@@ -9,25 +9,42 @@
 
 
 #include "utils.h"
+#include "texture_loader.h"
 
 void sApp::create_image(const char* image_name, 
                         sTexture* texture) {
-    // Load texture & store it to a satging buffer
+    // LOAD TEXTURE ==========================
+    // With its own channels: stb would expand to RGBA on another buffer,
+    // instead it is done while writting the staging memory
     int text_width, text_height, text_channel_count;
+    unsigned char* raw_pixels = stbi_load(image_name, 
+                                          &text_width, 
+                                          &text_height, 
+                                          &text_channel_count, 
+                                          0);
+
+    assert_msg(raw_pixels != NULL, "Error loading image");
+
+    create_image_from_pixels(raw_pixels,
+                             text_width,
+                             text_height,
+                             texture,
+                             text_channel_count);
+
+    stbi_image_free(raw_pixels);
+}
+
+void sApp::create_image_from_pixels(const uint8_t *raw_pixels,
+                                    const uint32_t text_width,
+                                    const uint32_t text_height,
+                                    sTexture *texture,
+                                    const uint32_t channel_count) {
+    // Store the texture to a satging buffer
     VkDeviceSize image_size;
     VkBuffer staging_buffer;
     VkDeviceMemory staging_memory;
     {
-        // LOAD TEXTURE ==========================
-        unsigned char* raw_pixels = stbi_load(image_name, 
-                                            &text_width, 
-                                            &text_height, 
-                                            &text_channel_count, 
-                                            STBI_rgb_alpha);
-
-        assert_msg(raw_pixels != NULL, "Error loading image");
-
-        image_size = text_width * text_height * 4; // 4 bits per pixel
+        image_size = text_width * text_height * 4; // 4 bytes per pixel, after the expansion
 
         // COPY THE MEMORY TO A STAGINIG BUFFER ===================
         create_buffer(image_size, 
@@ -44,37 +61,116 @@ void sApp::create_image(const char* image_name,
                     0, 
                     &staging_memory_address);
         
-        memcpy(staging_memory_address, 
-            raw_pixels, 
-            image_size);
+        expand_to_rgba8((uint8_t*) staging_memory_address,
+                        raw_pixels,
+                        (size_t) text_width * text_height,
+                        channel_count);
 
         vkUnmapMemory(Vulkan.device, 
                     staging_memory);
+    }
+    
+
+    // Create the VkImage & reserve its memory
+    VkImage texture_image;
+    VkDeviceMemory texture_image_memory;
+    uint32_t mip_levels = get_mip_level_count(text_width, text_height);
+    const bool use_blit = supports_linear_blit(VK_FORMAT_R8G8B8A8_SRGB);
+    const bool use_compute = !use_blit && supports_storage_image(VK_FORMAT_R8G8B8A8_UNORM);
+    {
+        // The levels are made by blits, or as a fallback written on compute through UNORM views.
+        // Without either, only the first level
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        VkImageCreateFlags flags = 0;
+        if (use_blit) {
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        } else if (use_compute) {
+            // sRGB has no storage support, the usage is only valid on the UNORM views
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+        } else {
+            mip_levels = 1;
+        }
 
+        _create_texture_image(text_width,
+                              text_height,
+                              mip_levels,
+                              VK_FORMAT_R8G8B8A8_SRGB,
+                              usage,
+                              flags,
+                              &texture_image,
+                              &texture_image_memory);
+    }
+   
+    // Transition the image layout
+    {
+        // Set the layout to be written to
+        transition_image_layout(texture_image, 
+                                VK_FORMAT_R8G8B8A8_SRGB, 
+                                VK_IMAGE_LAYOUT_UNDEFINED, 
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                mip_levels);
         
-        //stbi_free((stbi_uc*)raw_pixels);
+        // Write to
+        copy_buffer_to_image(staging_buffer, 
+                             texture_image, 
+                             text_width, 
+                             text_height, 
+                             1);
+
+        // Fill the rest of the chain from the level 0, and set all the levels
+        // as a optimal layout for sampling
+        generate_mipmaps(texture_image, 
+                         VK_FORMAT_R8G8B8A8_SRGB, 
+                         text_width, 
+                         text_height, 
+                         mip_levels);
     }
-    
 
+    // Cleanup
+    vkDestroyBuffer(Vulkan.device, staging_buffer, NULL);
+    vkFreeMemory(Vulkan.device, staging_memory, NULL);
+
+    // Return the texture
+    texture->width = text_width;
+    texture->height = text_height;
+    texture->depth = 1;
+    texture->mip_levels = mip_levels;
+    texture->device = &Vulkan.device;
+    texture->physical_device = &Vulkan.physical_device;
+    texture->format = VK_FORMAT_R8G8B8A8_SRGB;
+    texture->texture_image = texture_image;
+    texture->texture_image_memory = texture_image_memory;
+}
+
+
+void sApp::_create_texture_image(const uint32_t width,
+                                 const uint32_t height,
+                                 const uint32_t mip_levels,
+                                 const VkFormat format,
+                                 const VkImageUsageFlags usage,
+                                 const VkImageCreateFlags flags,
+                                 VkImage *texture_image,
+                                 VkDeviceMemory *texture_image_memory,
+                                 const uint32_t array_layers) {
     // Create the VkImage
-    VkImage texture_image;
     {
         VkImageCreateInfo image_create_info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             .pNext = NULL,
-            .flags = 0,
+            .flags = flags,
             .imageType = VK_IMAGE_TYPE_2D,
-            .format = VK_FORMAT_R8G8B8A8_SRGB,
+            .format = format,
             .extent = {
-                .width = (uint32_t) text_width,
-                .height = (uint32_t) text_height,
+                .width = width,
+                .height = height,
                 .depth = 1,
             },
-            .mipLevels = 1,
-            .arrayLayers = 1,
+            .mipLevels = mip_levels,
+            .arrayLayers = array_layers,
             .samples = VK_SAMPLE_COUNT_1_BIT,
             .tiling = VK_IMAGE_TILING_OPTIMAL, // Changes for reading / writting??
-            .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // transfer the memmory to, and set the sampler
+            .usage = usage, // transfer the memmory to, and set the sampler
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE, // Exclusive to the graphics queue
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, // Discard the contents on memory after the first Layout transition
         };
@@ -82,18 +178,17 @@ void sApp::create_image(const char* image_name,
         VK_OK(vkCreateImage(Vulkan.device, 
                             &image_create_info, 
                             NULL, 
-                            &texture_image),
+                            texture_image),
               "Creating Vulkan Image");
     }
     
 
     // Reserve the memory for the VkImage
-    VkDeviceMemory texture_image_memory;
     {
         // Get the requirements
         VkMemoryRequirements image_mem_requerements;
         vkGetImageMemoryRequirements(Vulkan.device, 
-                                    texture_image, 
+                                    *texture_image, 
                                     &image_mem_requerements);
 
         VkMemoryAllocateInfo alloc_info = {
@@ -108,49 +203,184 @@ void sApp::create_image(const char* image_name,
         VK_OK(vkAllocateMemory(Vulkan.device, 
                                &alloc_info, 
                                NULL, 
-                               &texture_image_memory), 
+                               texture_image_memory), 
               "Allocating vk memeory for the iamge");
         
         // Bind the memmory and the image representation
         vkBindImageMemory(Vulkan.device, 
-                          texture_image, 
-                          texture_image_memory, 
+                          *texture_image, 
+                          *texture_image_memory, 
                           0);
     }
-   
-    // Transition the image layout
+}
+
+bool sApp::is_texture_format_supported(const VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(Vulkan.physical_device,
+                                        format,
+                                        &properties);
+
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+// The blocks and their pre built mips are copied as they are, no decoding
+void sApp::create_compressed_image(const sTextureFile &texture_file,
+                                   sTexture *texture) {
+    // All the levels, packed on a single staging buffer
+    VkDeviceSize image_size = 0;
+    VkDeviceSize staging_offsets[TEXTURE_FILE_MAX_LEVELS];
+    for(uint32_t i = 0; i < texture_file.mip_levels; i++) {
+        staging_offsets[i] = image_size;
+        // Keep the level starts aligned to the texel block size (max 16 bytes)
+        image_size += (texture_file.level_sizes[i] + 15) & ~((VkDeviceSize) 15);
+    }
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    create_buffer(image_size, 
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+                  &staging_buffer, 
+                  &staging_memory);
+
+    uint8_t *staging_memory_address;
+    VK_OK(vkMapMemory(Vulkan.device, 
+                      staging_memory, 
+                      0, 
+                      image_size, 
+                      0, 
+                      (void**) &staging_memory_address),
+          "Mapping texture staging memory");
+    for(uint32_t i = 0; i < texture_file.mip_levels; i++) {
+        memcpy(staging_memory_address + staging_offsets[i], 
+               texture_file.data + texture_file.level_offsets[i], 
+               texture_file.level_sizes[i]);
+    }
+    vkUnmapMemory(Vulkan.device, 
+                  staging_memory);
+
+    VkImage texture_image;
+    VkDeviceMemory texture_image_memory;
+    _create_texture_image(texture_file.width,
+                          texture_file.height,
+                          texture_file.mip_levels,
+                          texture_file.format,
+                          VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          0,
+                          &texture_image,
+                          &texture_image_memory);
+
+    transition_image_layout(texture_image, 
+                            texture_file.format, 
+                            VK_IMAGE_LAYOUT_UNDEFINED, 
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            texture_file.mip_levels);
+
+    // One copy region per level
     {
-        // Set the layout to be written to
-        transition_image_layout(texture_image, 
-                                VK_FORMAT_R8G8B8A8_SRGB, 
-                                VK_IMAGE_LAYOUT_UNDEFINED, 
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        
-        // Write to
-        copy_buffer_to_image(staging_buffer, 
-                             texture_image, 
-                             text_width, 
-                             text_height, 
-                             1);
+        VkCommandBuffer command_buffer = being_single_time_commands();
 
-        // Set the layout as a optimal layout for sampling
-        transition_image_layout(texture_image, 
-                                VK_FORMAT_R8G8B8A8_SRGB, 
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        VkBufferImageCopy regions[TEXTURE_FILE_MAX_LEVELS];
+        for(uint32_t i = 0; i < texture_file.mip_levels; i++) {
+            regions[i] = {
+                .bufferOffset = staging_offsets[i],
+                .bufferRowLength = 0, // Tightly packed
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = i,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { .x = 0, .y = 0, .z = 0 },
+                .imageExtent = {
+                    .width = (texture_file.width >> i) > 0 ? texture_file.width >> i : 1,
+                    .height = (texture_file.height >> i) > 0 ? texture_file.height >> i : 1,
+                    .depth = 1
+                }
+            };
+        }
+
+        vkCmdCopyBufferToImage(command_buffer, 
+                               staging_buffer, 
+                               texture_image, 
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+                               texture_file.mip_levels, 
+                               regions);
+
+        end_single_time_commands(command_buffer);
     }
 
-    // Cleanup
+    transition_image_layout(texture_image, 
+                            texture_file.format, 
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            texture_file.mip_levels);
+
     vkDestroyBuffer(Vulkan.device, staging_buffer, NULL);
     vkFreeMemory(Vulkan.device, staging_memory, NULL);
 
-    // Return the texture
-    texture->width = text_width;
-    texture->height = text_height;
+    texture->width = texture_file.width;
+    texture->height = texture_file.height;
     texture->depth = 1;
+    texture->mip_levels = texture_file.mip_levels;
     texture->device = &Vulkan.device;
     texture->physical_device = &Vulkan.physical_device;
-    texture->format = VK_FORMAT_R8G8B8A8_SRGB;
+    texture->format = texture_file.format;
     texture->texture_image = texture_image;
     texture->texture_image_memory = texture_image_memory;
-}
\ No newline at end of file
+}
+
+// Compressed siblings of a source image, by order of preference
+static const char* COMPRESSED_TEXTURE_EXTENSIONS[] = {
+    ".astc.ktx2",
+    ".bc7.ktx2",
+    ".ktx2",
+    ".dds"
+};
+
+bool sApp::find_compressed_texture(const char *image_name,
+                                   sTextureFile *texture_file) {
+    // Strip the extension of the source image
+    char base_name[512];
+    strncpy(base_name, image_name, sizeof(base_name) - 1);
+    base_name[sizeof(base_name) - 1] = '\0';
+    char *extension = strrchr(base_name, '.');
+    if (extension != NULL) {
+        *extension = '\0';
+    }
+
+    // The first file whose format the GPU can sample wins
+    for(uint32_t i = 0; i < sizeof(COMPRESSED_TEXTURE_EXTENSIONS) / sizeof(COMPRESSED_TEXTURE_EXTENSIONS[0]); i++) {
+        char file_name[600];
+        snprintf(file_name, sizeof(file_name), "%s%s", base_name, COMPRESSED_TEXTURE_EXTENSIONS[i]);
+
+        if (!load_texture_file(file_name, texture_file)) {
+            continue;
+        }
+
+        if (is_texture_format_supported(texture_file->format)) {
+            return true;
+        }
+
+        std::cout << "Skipping " << file_name << ", format " << texture_file->format << " is not supported" << std::endl;
+        texture_file->clean();
+    }
+
+    return false;
+}
+
+void sApp::load_texture(const char *image_name,
+                        sTexture *texture) {
+    sTextureFile texture_file;
+    if (find_compressed_texture(image_name, &texture_file)) {
+        create_compressed_image(texture_file, texture);
+        texture_file.clean();
+        return;
+    }
+
+    // No usable compressed version, decode the source
+    create_image(image_name, texture);
+}
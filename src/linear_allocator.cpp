@@ -0,0 +1,23 @@
+#include "linear_allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+
+// Freed when its thread exits
+struct sThreadScratch {
+    sLinearAllocator allocator;
+
+    ~sThreadScratch() {
+        allocator.cleanup();
+    }
+};
+
+static thread_local sThreadScratch thread_scratch;
+
+sLinearAllocator* get_scratch_allocator() {
+    if (thread_scratch.allocator.memory == NULL) {
+        thread_scratch.allocator.init(SCRATCH_ALLOCATOR_SIZE);
+    }
+    return &thread_scratch.allocator;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <memory_resource>
+
+#include "utils.h"
+
+// Transient CPU data of a frame (see sApp::frame_allocator)
+#define FRAME_ALLOCATOR_SIZE   (1024 * 1024)
+// Per call temporary arrays of each thread (see get_scratch_allocator)
+#define SCRATCH_ALLOCATOR_SIZE (256 * 1024)
+
+// Bump allocator over a single block: an allocation is an aligned add, and everything
+// is freed at once by moving the offset back. Running out is an error, not a fallback
+// to the heap (it aborts, on every build), so the size has to cover the worst frame (see high_water)
+struct sLinearAllocator {
+    uint8_t  *memory = NULL;
+    size_t   capacity = 0;
+    size_t   offset = 0;
+    size_t   high_water = 0; // Most bytes used since init
+    uint32_t allocation_count = 0; // Since the last reset
+
+    void init(const size_t size) {
+        memory = (uint8_t*) malloc(size);
+        capacity = size;
+        offset = 0;
+        high_water = 0;
+        allocation_count = 0;
+    }
+
+    inline void* alloc(const size_t size,
+                       const size_t alignment = alignof(max_align_t)) {
+        const size_t begin = (offset + alignment - 1) & ~(alignment - 1);
+        // Not an assert: on release builds it would write past the block
+        if (begin + size > capacity) {
+            std::cout << "Linear allocator out of memory: " << begin + size << " of " << capacity << " bytes" << std::endl;
+            abort();
+        }
+
+        offset = begin + size;
+        high_water = (offset > high_water) ? offset : high_water;
+        allocation_count++;
+        return memory + begin;
+    }
+
+    // Uninitialized
+    template<typename T>
+    inline T* alloc_array(const size_t count) {
+        return (T*) alloc(sizeof(T) * count, alignof(T));
+    }
+
+    inline size_t get_marker() const {
+        return offset;
+    }
+
+    // Frees everything allocated after the marker
+    inline void rewind(const size_t marker) {
+        offset = marker;
+    }
+
+    inline void reset() {
+        offset = 0;
+        allocation_count = 0;
+    }
+
+    void cleanup() {
+        free(memory);
+        memory = NULL;
+        capacity = 0;
+        offset = 0;
+    }
+};
+
+// Everything allocated through it is freed when it leaves the scope. They nest, as
+// long as the inner one ends first
+struct sScratchScope {
+    sLinearAllocator *allocator;
+    size_t           marker;
+
+    sScratchScope(sLinearAllocator *scratch_allocator) : allocator(scratch_allocator), marker(scratch_allocator->get_marker()) {}
+    ~sScratchScope() {
+        allocator->rewind(marker);
+    }
+
+    sScratchScope(const sScratchScope&) = delete;
+    sScratchScope& operator=(const sScratchScope&) = delete;
+
+    template<typename T>
+    inline T* alloc_array(const size_t count) {
+        return allocator->alloc_array<T>(count);
+    }
+};
+
+// For the std containers, std::pmr::vector<T> list(&resource). The deallocations do
+// nothing, the memory comes back with the allocator's reset or rewind
+struct sLinearMemoryResource : public std::pmr::memory_resource {
+    sLinearAllocator *allocator;
+
+    sLinearMemoryResource(sLinearAllocator *linear_allocator) : allocator(linear_allocator) {}
+
+    void* do_allocate(size_t bytes,
+                      size_t alignment) override {
+        return allocator->alloc(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer,
+                       size_t bytes,
+                       size_t alignment) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// The calling thread's scratch allocator, made on its first use
+sLinearAllocator* get_scratch_allocator();
@@ -6,9 +6,14 @@
 #include "app.h"
 
 
-int main() {
+int main(int argc, char **argv) {
     sApp app = {};
 
+    // Frame depth, present policy & a tile pyramid (see tools/tile_pyramid.cpp) to show instead of the quad
+    if (!app.config.parse(argc, argv)) {
+        return 1;
+    }
+
     app.run();
 
     return 0;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <stdint.h>
 #include <vulkan/vulkan_core.h>
 #include <cassert>
@@ -8,6 +9,7 @@
 #include <glm/glm.hpp>
 
 #include "utils.h"
+#include "vertex_format.h"
 
 namespace Geometry {
     
@@ -49,40 +51,34 @@ namespace Geometry {
     // =============================
     // GEOMETRY DESCRIPTORS
     // =============================
-    static VkVertexInputBindingDescription* get_2D_biding_description(uint32_t *count) {
-        VkVertexInputBindingDescription* biding_descriptor = (VkVertexInputBindingDescription*) malloc(sizeof(VkVertexInputBindingDescription));
-        biding_descriptor[0] = {
-            .binding = 0, // Only in the first array
-            .stride = sizeof(sVertex2D),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX // For using vertex OR isntancing
-        };
+    typedef sVertexLayout<sFloat2, sFloat3, sFloat2> sVertex2DLayout;
+    static_assert(sizeof(sVertex2D) == sVertex2DLayout::stride, "sVertex2D does not match its layout");
+    static_assert(offsetof(sVertex2D, text_coord) == sVertex2DLayout::attributes[2].offset, "sVertex2D does not match its layout");
 
-        return biding_descriptor;
-    }
+    // Quantized sVertex2D: 12 bytes instead of 28
+    struct sVertex2DCompact {
+        sHalf2     position;
+        sUnorm8x4  color;
+        sUnorm16x2 text_coord; // NOTE: only for UVs on the [0, 1] range
+    };
 
-    static VkVertexInputAttributeDescription* get_2D_attribute_description(uint32_t *count) {
-        // Atribute config
-        *count = 3;
-        VkVertexInputAttributeDescription *attribute_description = (VkVertexInputAttributeDescription*) malloc(sizeof(VkVertexInputAttributeDescription) * 3);
-        attribute_description[0] = {
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(sVertex2D, position)
-        };
-        attribute_description[1] = {
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = offsetof(sVertex2D, color)
-        };
-        attribute_description[2] = {
-            .location = 2,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(sVertex2D, text_coord)
+    typedef sVertexLayout<sHalf2, sUnorm8x4, sUnorm16x2> sVertex2DCompactLayout;
+    static_assert(sizeof(sVertex2DCompact) == sVertex2DCompactLayout::stride, "sVertex2DCompact does not match its layout");
+
+    inline sVertex2DCompact encode_compact(const sVertex2D &vertex) {
+        return {
+            .position = sHalf2::encode(vertex.position),
+            .color = sUnorm8x4::encode(vertex.color),
+            .text_coord = sUnorm16x2::encode(vertex.text_coord)
         };
+    }
+
+    // 16 bit indices are enough when all the vertices can be addressed with them
+    inline VkIndexType choose_index_type(const uint32_t vertex_count) {
+        return (vertex_count < 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
 
-        return attribute_description;
+    inline uint32_t index_type_size(const VkIndexType index_type) {
+        return (index_type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
     }
 };
@@ -0,0 +1,484 @@
+#include "mesh_optimizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+
+#include "utils.h"
+
+#define INVALID_INDEX 0xffffffffu
+
+namespace Geometry {
+    namespace Optimizer {
+
+        // ===================================
+        // ANALYSIS
+        // ===================================
+        sVertexCacheStats analyze_vertex_cache(const uint32_t *indices,
+                                               const uint32_t index_count,
+                                               const uint32_t vertex_count,
+                                               const uint32_t cache_size) {
+            sVertexCacheStats stats = {};
+            if (index_count == 0) {
+                return stats;
+            }
+
+            // FIFO via timestamps: a vertex is on the cache if it was inserted less than cache_size misses ago
+            uint32_t *cache_timestamps = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+            bool *is_used = (bool*) calloc(vertex_count, sizeof(bool));
+            for(uint32_t i = 0; i < vertex_count; i++) {
+                cache_timestamps[i] = INVALID_INDEX;
+            }
+
+            uint32_t misses = 0, unique_vertices = 0;
+            for(uint32_t i = 0; i < index_count; i++) {
+                const uint32_t v = indices[i];
+
+                if (cache_timestamps[v] == INVALID_INDEX || misses - cache_timestamps[v] >= cache_size) {
+                    cache_timestamps[v] = misses++;
+                }
+
+                if (!is_used[v]) {
+                    is_used[v] = true;
+                    unique_vertices++;
+                }
+            }
+
+            free(cache_timestamps);
+            free(is_used);
+
+            stats.transformed_vertices = misses;
+            stats.acmr = misses / (float) (index_count / 3);
+            stats.atvr = misses / (float) unique_vertices;
+            return stats;
+        }
+
+        // ===================================
+        // VERTEX DEDUPLICATION
+        // ===================================
+        inline uint32_t hash_vertex(const uint8_t *vertex,
+                                    const uint32_t vertex_stride) {
+            // FNV-1a
+            uint32_t hash = 2166136261u;
+            for(uint32_t i = 0; i < vertex_stride; i++) {
+                hash = (hash ^ vertex[i]) * 16777619u;
+            }
+            return hash;
+        }
+
+        uint32_t generate_deduplication_remap(uint32_t *remap,
+                                              const void *vertices,
+                                              const uint32_t vertex_count,
+                                              const uint32_t vertex_stride) {
+            const uint8_t *vertex_data = (const uint8_t*) vertices;
+
+            // Open addressing table, at least twice the size of the vertices
+            uint32_t table_size = 1;
+            while(table_size < vertex_count * 2) {
+                table_size *= 2;
+            }
+            uint32_t *table = (uint32_t*) malloc(sizeof(uint32_t) * table_size);
+            for(uint32_t i = 0; i < table_size; i++) {
+                table[i] = INVALID_INDEX;
+            }
+
+            uint32_t unique_count = 0;
+            for(uint32_t i = 0; i < vertex_count; i++) {
+                const uint8_t *vertex = vertex_data + (size_t) i * vertex_stride;
+                uint32_t slot = hash_vertex(vertex, vertex_stride) & (table_size - 1);
+
+                while(true) {
+                    if (table[slot] == INVALID_INDEX) {
+                        // New vertex
+                        table[slot] = i;
+                        remap[i] = unique_count++;
+                        break;
+                    }
+
+                    const uint32_t candidate = table[slot];
+                    if (memcmp(vertex, vertex_data + (size_t) candidate * vertex_stride, vertex_stride) == 0) {
+                        remap[i] = remap[candidate];
+                        break;
+                    }
+
+                    slot = (slot + 1) & (table_size - 1);
+                }
+            }
+
+            free(table);
+            return unique_count;
+        }
+
+        // ===================================
+        // VERTEX CACHE OPTIMIZATION (TIPSIFY)
+        // ===================================
+        inline uint32_t skip_dead_end(const uint32_t *live_triangles,
+                                      uint32_t *dead_end_stack,
+                                      uint32_t *dead_end_count,
+                                      uint32_t *cursor,
+                                      const uint32_t vertex_count) {
+            // Recently used vertices first, that still have triangles
+            while(*dead_end_count > 0) {
+                const uint32_t v = dead_end_stack[--(*dead_end_count)];
+                if (live_triangles[v] > 0) {
+                    return v;
+                }
+            }
+
+            // Otherwise, the next vertex in input order
+            for(; *cursor < vertex_count; (*cursor)++) {
+                if (live_triangles[*cursor] > 0) {
+                    return *cursor;
+                }
+            }
+
+            return INVALID_INDEX;
+        }
+
+        uint32_t optimize_vertex_cache(uint32_t *result_indices,
+                                       uint32_t *cluster_starts,
+                                       const uint32_t *indices,
+                                       const uint32_t index_count,
+                                       const uint32_t vertex_count,
+                                       const uint32_t cache_size) {
+            const uint32_t triangle_count = index_count / 3;
+
+            // Vertex -> triangles adjacency
+            uint32_t *live_triangles = (uint32_t*) calloc(vertex_count, sizeof(uint32_t));
+            uint32_t *adjacency_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (vertex_count + 1));
+            uint32_t *adjacency = (uint32_t*) malloc(sizeof(uint32_t) * index_count);
+
+            for(uint32_t i = 0; i < index_count; i++) {
+                live_triangles[indices[i]]++;
+            }
+            adjacency_offsets[0] = 0;
+            for(uint32_t v = 0; v < vertex_count; v++) {
+                adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+            }
+            {
+                uint32_t *fill = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+                memcpy(fill, adjacency_offsets, sizeof(uint32_t) * vertex_count);
+                for(uint32_t i = 0; i < index_count; i++) {
+                    adjacency[fill[indices[i]]++] = i / 3;
+                }
+                free(fill);
+            }
+
+            uint32_t *cache_timestamps = (uint32_t*) calloc(vertex_count, sizeof(uint32_t));
+            uint32_t *dead_end_stack = (uint32_t*) malloc(sizeof(uint32_t) * index_count);
+            uint32_t *candidates = (uint32_t*) malloc(sizeof(uint32_t) * index_count);
+            bool *is_emitted = (bool*) calloc(triangle_count, sizeof(bool));
+
+            uint32_t dead_end_count = 0, cursor = 0, output_count = 0, cluster_count = 0;
+            uint32_t timestamp = cache_size + 1;
+
+            uint32_t fanning_vertex = skip_dead_end(live_triangles, dead_end_stack, &dead_end_count, &cursor, vertex_count);
+            if (fanning_vertex != INVALID_INDEX) {
+                cluster_starts[cluster_count++] = 0;
+            }
+
+            while(fanning_vertex != INVALID_INDEX) {
+                uint32_t candidate_count = 0;
+
+                // Emit all the triangles around the fanning vertex
+                for(uint32_t a = adjacency_offsets[fanning_vertex]; a < adjacency_offsets[fanning_vertex + 1]; a++) {
+                    const uint32_t triangle = adjacency[a];
+                    if (is_emitted[triangle]) {
+                        continue;
+                    }
+
+                    for(uint32_t k = 0; k < 3; k++) {
+                        const uint32_t v = indices[triangle * 3 + k];
+                        result_indices[output_count++] = v;
+                        dead_end_stack[dead_end_count++] = v;
+                        candidates[candidate_count++] = v;
+                        live_triangles[v]--;
+
+                        if (timestamp - cache_timestamps[v] > cache_size) {
+                            cache_timestamps[v] = timestamp++;
+                        }
+                    }
+                    is_emitted[triangle] = true;
+                }
+
+                // Next fanning vertex: the candidate that will stay longer in the cache
+                uint32_t best_vertex = INVALID_INDEX;
+                int32_t best_priority = -1;
+                for(uint32_t c = 0; c < candidate_count; c++) {
+                    const uint32_t v = candidates[c];
+                    if (live_triangles[v] == 0) {
+                        continue;
+                    }
+
+                    int32_t priority = 0;
+                    if (timestamp - cache_timestamps[v] + 2 * live_triangles[v] <= cache_size) {
+                        priority = (int32_t) (timestamp - cache_timestamps[v]);
+                    }
+                    if (priority > best_priority) {
+                        best_priority = priority;
+                        best_vertex = v;
+                    }
+                }
+
+                if (best_vertex == INVALID_INDEX) {
+                    // Dead end: hard boundary for the overdraw clusters
+                    best_vertex = skip_dead_end(live_triangles, dead_end_stack, &dead_end_count, &cursor, vertex_count);
+                    if (best_vertex != INVALID_INDEX) {
+                        cluster_starts[cluster_count++] = output_count / 3;
+                    }
+                }
+
+                fanning_vertex = best_vertex;
+            }
+
+            free(live_triangles);
+            free(adjacency_offsets);
+            free(adjacency);
+            free(cache_timestamps);
+            free(dead_end_stack);
+            free(candidates);
+            free(is_emitted);
+
+            return cluster_count;
+        }
+
+        // ===================================
+        // OVERDRAW OPTIMIZATION
+        // ===================================
+        struct sCluster {
+            uint32_t start; // In triangles
+            uint32_t count;
+            float    sort_key;
+        };
+
+        inline void get_position(float *result,
+                                 const float *positions,
+                                 const uint32_t position_components,
+                                 const uint32_t position_stride,
+                                 const uint32_t vertex) {
+            const float *position = (const float*) ((const uint8_t*) positions + (size_t) vertex * position_stride);
+            result[0] = position[0];
+            result[1] = position[1];
+            result[2] = (position_components > 2) ? position[2] : 0.0f;
+        }
+
+        void optimize_overdraw(uint32_t *result_indices,
+                               const uint32_t *indices,
+                               const uint32_t index_count,
+                               const uint32_t *cluster_starts,
+                               const uint32_t cluster_count,
+                               const float *positions,
+                               const uint32_t position_components,
+                               const uint32_t position_stride,
+                               const uint32_t vertex_count,
+                               const uint32_t cache_size,
+                               const float threshold) {
+            const uint32_t triangle_count = index_count / 3;
+            if (triangle_count == 0) {
+                return;
+            }
+
+            // Soft boundaries: inside each hard cluster, split as soon as the
+            // local ACMR is good enough that the split does not hurt the cache
+            const float target_acmr = analyze_vertex_cache(indices, index_count, vertex_count, cache_size).acmr * threshold;
+
+            sCluster *clusters = (sCluster*) malloc(sizeof(sCluster) * triangle_count);
+            uint32_t *cache_timestamps = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+            // The cluster of each timestamp: a new cluster empties the cache, without touching every vertex
+            uint32_t *cache_clusters = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+            for(uint32_t i = 0; i < vertex_count; i++) {
+                cache_clusters[i] = INVALID_INDEX;
+            }
+            uint32_t split_cluster_count = 0;
+
+            for(uint32_t c = 0; c < cluster_count; c++) {
+                const uint32_t start = cluster_starts[c];
+                const uint32_t end = (c + 1 < cluster_count) ? cluster_starts[c + 1] : triangle_count;
+
+                uint32_t misses = 0, cluster_start = start;
+                for(uint32_t t = start; t < end; t++) {
+                    for(uint32_t k = 0; k < 3; k++) {
+                        const uint32_t v = indices[t * 3 + k];
+                        if (cache_clusters[v] != split_cluster_count || misses - cache_timestamps[v] >= cache_size) {
+                            cache_clusters[v] = split_cluster_count;
+                            cache_timestamps[v] = misses++;
+                        }
+                    }
+
+                    const uint32_t cluster_triangles = t - cluster_start + 1;
+                    if (t + 1 < end && misses <= target_acmr * cluster_triangles) {
+                        clusters[split_cluster_count++] = { .start = cluster_start, .count = cluster_triangles };
+                        cluster_start = t + 1;
+                        misses = 0;
+                    }
+                }
+                clusters[split_cluster_count++] = { .start = cluster_start, .count = end - cluster_start };
+            }
+            free(cache_timestamps);
+            free(cache_clusters);
+
+            // Mesh centroid
+            float mesh_centroid[3] = { 0.0f, 0.0f, 0.0f };
+            for(uint32_t i = 0; i < index_count; i++) {
+                float p[3];
+                get_position(p, positions, position_components, position_stride, indices[i]);
+                mesh_centroid[0] += p[0] / index_count;
+                mesh_centroid[1] += p[1] / index_count;
+                mesh_centroid[2] += p[2] / index_count;
+            }
+
+            // Sort the clusters by how much they face outwards
+            for(uint32_t c = 0; c < split_cluster_count; c++) {
+                sCluster &cluster = clusters[c];
+                float centroid[3] = { 0.0f, 0.0f, 0.0f };
+                float normal[3] = { 0.0f, 0.0f, 0.0f };
+
+                for(uint32_t t = cluster.start; t < cluster.start + cluster.count; t++) {
+                    float p0[3], p1[3], p2[3];
+                    get_position(p0, positions, position_components, position_stride, indices[t * 3 + 0]);
+                    get_position(p1, positions, position_components, position_stride, indices[t * 3 + 1]);
+                    get_position(p2, positions, position_components, position_stride, indices[t * 3 + 2]);
+
+                    const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                    const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                    // Area weighted normal
+                    normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+                    normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+                    normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+
+                    for(uint32_t k = 0; k < 3; k++) {
+                        centroid[k] += (p0[k] + p1[k] + p2[k]) / (3.0f * cluster.count);
+                    }
+                }
+
+                cluster.sort_key = (centroid[0] - mesh_centroid[0]) * normal[0] +
+                                   (centroid[1] - mesh_centroid[1]) * normal[1] +
+                                   (centroid[2] - mesh_centroid[2]) * normal[2];
+            }
+
+            std::stable_sort(clusters,
+                             clusters + split_cluster_count,
+                             [](const sCluster &a, const sCluster &b) { return a.sort_key > b.sort_key; });
+
+            uint32_t output_count = 0;
+            for(uint32_t c = 0; c < split_cluster_count; c++) {
+                memcpy(&result_indices[output_count],
+                       &indices[clusters[c].start * 3],
+                       sizeof(uint32_t) * clusters[c].count * 3);
+                output_count += clusters[c].count * 3;
+            }
+
+            free(clusters);
+        }
+
+        // ===================================
+        // VERTEX FETCH OPTIMIZATION
+        // ===================================
+        uint32_t optimize_vertex_fetch(void *result_vertices,
+                                       uint32_t *indices,
+                                       const uint32_t index_count,
+                                       const void *vertices,
+                                       const uint32_t vertex_count,
+                                       const uint32_t vertex_stride) {
+            uint32_t *remap = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+            for(uint32_t i = 0; i < vertex_count; i++) {
+                remap[i] = INVALID_INDEX;
+            }
+
+            uint32_t next_vertex = 0;
+            for(uint32_t i = 0; i < index_count; i++) {
+                const uint32_t v = indices[i];
+                if (remap[v] == INVALID_INDEX) {
+                    remap[v] = next_vertex++;
+                    memcpy((uint8_t*) result_vertices + (size_t) remap[v] * vertex_stride,
+                           (const uint8_t*) vertices + (size_t) v * vertex_stride,
+                           vertex_stride);
+                }
+                indices[i] = remap[v];
+            }
+
+            free(remap);
+            return next_vertex;
+        }
+
+        // ===================================
+        // IMPORT PIPELINE
+        // ===================================
+        sMeshOptimizationReport optimize_mesh(sVertex2D *vertices,
+                                              uint32_t *vertex_count,
+                                              uint32_t *indices,
+                                              const uint32_t index_count) {
+            sMeshOptimizationReport report = {
+                .vertex_count_before = *vertex_count,
+                .before = analyze_vertex_cache(indices, index_count, *vertex_count),
+            };
+
+            uint32_t *scratch_indices = (uint32_t*) malloc(sizeof(uint32_t) * index_count);
+            uint32_t *cluster_starts = (uint32_t*) malloc(sizeof(uint32_t) * (index_count / 3 + 1));
+            sVertex2D *scratch_vertices = (sVertex2D*) malloc(sizeof(sVertex2D) * *vertex_count);
+
+            // 1. Merge the duplicated vertices
+            {
+                uint32_t *remap = (uint32_t*) malloc(sizeof(uint32_t) * *vertex_count);
+                generate_deduplication_remap(remap, vertices, *vertex_count, sizeof(sVertex2D));
+                for(uint32_t i = 0; i < index_count; i++) {
+                    indices[i] = remap[indices[i]];
+                }
+                // The first copy of each vertex is the one that survives, and unique
+                // vertices are numbered in order, so the compaction can be done in place
+                for(uint32_t i = 0; i < *vertex_count; i++) {
+                    vertices[remap[i]] = vertices[i];
+                }
+                free(remap);
+            }
+
+            // 2. Triangle order for the post-transform cache
+            const uint32_t cluster_count = optimize_vertex_cache(scratch_indices,
+                                                                 cluster_starts,
+                                                                 indices,
+                                                                 index_count,
+                                                                 *vertex_count);
+
+            // 3. Cluster order for overdraw
+            optimize_overdraw(indices,
+                              scratch_indices,
+                              index_count,
+                              cluster_starts,
+                              cluster_count,
+                              &vertices[0].position.x,
+                              2,
+                              sizeof(sVertex2D),
+                              *vertex_count);
+
+            // 4. Vertex order for the fetch locality
+            *vertex_count = optimize_vertex_fetch(scratch_vertices,
+                                                  indices,
+                                                  index_count,
+                                                  vertices,
+                                                  *vertex_count,
+                                                  sizeof(sVertex2D));
+            memcpy(vertices, scratch_vertices, sizeof(sVertex2D) * *vertex_count);
+
+            free(scratch_indices);
+            free(cluster_starts);
+            free(scratch_vertices);
+
+            report.vertex_count_after = *vertex_count;
+            report.after = analyze_vertex_cache(indices, index_count, *vertex_count);
+            return report;
+        }
+
+        void print_report(const char *mesh_name,
+                          const sMeshOptimizationReport &report) {
+            std::cout << "Mesh optimization of " << mesh_name << ":" << std::endl;
+            std::cout << " - Vertices: " << report.vertex_count_before << " -> " << report.vertex_count_after << std::endl;
+            std::cout << " - ACMR: " << report.before.acmr << " -> " << report.after.acmr << std::endl;
+            std::cout << " - ATVR: " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+        }
+
+    };
+};
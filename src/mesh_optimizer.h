@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+
+#include "mesh.h"
+
+// Default size of the simulated post-transform vertex cache (FIFO)
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+// A cluster is split when its local ACMR stays under this factor of the mesh's ACMR
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+
+namespace Geometry {
+    namespace Optimizer {
+
+        struct sVertexCacheStats {
+            float acmr = 0.0f; // Average cache miss ratio: transformed vertices per triangle
+            float atvr = 0.0f; // Average transform to vertex ratio: transformed vertices per unique vertex
+            uint32_t transformed_vertices = 0;
+        };
+
+        // Simulates a FIFO post-transform cache over the index buffer
+        sVertexCacheStats analyze_vertex_cache(const uint32_t *indices,
+                                               const uint32_t index_count,
+                                               const uint32_t vertex_count,
+                                               const uint32_t cache_size = MESH_OPTIMIZER_CACHE_SIZE);
+
+        // Builds a remap table that merges binary identical vertices, returns the unique vertex count
+        uint32_t generate_deduplication_remap(uint32_t *remap,
+                                              const void *vertices,
+                                              const uint32_t vertex_count,
+                                              const uint32_t vertex_stride);
+
+        // Tipsify (Sander et al. 2007): reorders the triangles for post-transform cache reuse
+        // The cluster starts (in triangles) are the hard boundaries found, where the algorithm
+        // had to jump to a non-local vertex. Returns the cluster count
+        uint32_t optimize_vertex_cache(uint32_t *result_indices,
+                                       uint32_t *cluster_starts,
+                                       const uint32_t *indices,
+                                       const uint32_t index_count,
+                                       const uint32_t vertex_count,
+                                       const uint32_t cache_size = MESH_OPTIMIZER_CACHE_SIZE);
+
+        // Splits the clusters where the cache efficiency allows it, and sorts them
+        // so the outward facing clusters are drawn first, reducing overdraw
+        void optimize_overdraw(uint32_t *result_indices,
+                               const uint32_t *indices,
+                               const uint32_t index_count,
+                               const uint32_t *cluster_starts,
+                               const uint32_t cluster_count,
+                               const float *positions,
+                               const uint32_t position_components, // 2 or 3
+                               const uint32_t position_stride, // in bytes
+                               const uint32_t vertex_count,
+                               const uint32_t cache_size = MESH_OPTIMIZER_CACHE_SIZE,
+                               const float threshold = MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
+
+        // Reorders the vertices in the order they are first used by the indices (updating them)
+        // Unreferenced vertices are dropped, returns the new vertex count
+        uint32_t optimize_vertex_fetch(void *result_vertices,
+                                       uint32_t *indices,
+                                       const uint32_t index_count,
+                                       const void *vertices,
+                                       const uint32_t vertex_count,
+                                       const uint32_t vertex_stride);
+
+        struct sMeshOptimizationReport {
+            uint32_t vertex_count_before;
+            uint32_t vertex_count_after;
+            sVertexCacheStats before;
+            sVertexCacheStats after;
+        };
+
+        // Full import pipeline, in place: dedup, vertex cache, overdraw and vertex fetch
+        sMeshOptimizationReport optimize_mesh(sVertex2D *vertices,
+                                              uint32_t *vertex_count,
+                                              uint32_t *indices,
+                                              const uint32_t index_count);
+
+        void print_report(const char *mesh_name,
+                          const sMeshOptimizationReport &report);
+    };
+};
@@ -0,0 +1,468 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "shader.h"
+#include "utils.h"
+
+#define DOWNSAMPLE_GROUP_SIZE 8
+
+struct sDownsamplePushConstants {
+    int32_t dst_width;
+    int32_t dst_height;
+    int32_t is_srgb;
+};
+
+bool sApp::supports_linear_blit(const VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(Vulkan.physical_device,
+                                        format,
+                                        &properties);
+
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                          VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+// For the compute fallback, on the UNORM views it writes through
+bool sApp::supports_storage_image(const VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(Vulkan.physical_device,
+                                        format,
+                                        &properties);
+
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+void record_blit_mip_chain(const VkCommandBuffer &command_buffer,
+                           const VkImage &image,
+                           const uint32_t width,
+                           const uint32_t height,
+                           const uint32_t mip_levels,
+                           const uint32_t layer_count) {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = layer_count
+        }
+    };
+
+    int32_t level_width = (int32_t) width;
+    int32_t level_height = (int32_t) height;
+
+    for(uint32_t level = 1; level < mip_levels; level++) {
+        // The previous level has been written, make it the blit source
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        const int32_t next_width = (level_width > 1) ? level_width / 2 : 1;
+        const int32_t next_height = (level_height > 1) ? level_height / 2 : 1;
+
+        VkImageBlit blit = {
+            .srcSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level - 1,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count
+            },
+            .srcOffsets = { {0, 0, 0}, {level_width, level_height, 1} },
+            .dstSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count
+            },
+            .dstOffsets = { {0, 0, 0}, {next_width, next_height, 1} }
+        };
+
+        vkCmdBlitImage(command_buffer,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit,
+                       VK_FILTER_LINEAR);
+
+        // The previous level is done, hand it to the fragment shaders
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        level_width = next_width;
+        level_height = next_height;
+    }
+
+    // The last level was only written
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         0, NULL,
+                         0, NULL,
+                         1, &barrier);
+}
+
+// Fallback, for formats without linear blits. Each level is written by a compute
+// dispatch reading the previous one, both through UNORM storage views
+// NOTE: the pipeline is created per call, since this is only hit on rare formats at load time
+void sApp::_generate_mipmaps_compute(const VkImage &image,
+                                     const VkFormat format,
+                                     const uint32_t width,
+                                     const uint32_t height,
+                                     const uint32_t mip_levels) {
+    // The storage views need a non sRGB format, the image needs the MUTABLE_FORMAT flag
+    VkFormat storage_format;
+    bool is_srgb;
+    switch(format) {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            storage_format = VK_FORMAT_R8G8B8A8_UNORM;
+            is_srgb = true;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            storage_format = VK_FORMAT_R8G8B8A8_UNORM;
+            is_srgb = false;
+            break;
+        default:
+            assert_msg(false, "No compute mip generation for this format");
+            return;
+    }
+
+    const uint32_t level_transitions = mip_levels - 1;
+
+    // ===== PIPELINE =====
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    {
+        VkDescriptorSetLayoutBinding bindings[2] = {
+            {
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
+            },
+            {
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = NULL
+            }
+        };
+
+        VkDescriptorSetLayoutCreateInfo set_layout_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .bindingCount = 2,
+            .pBindings = bindings
+        };
+        VK_OK(vkCreateDescriptorSetLayout(Vulkan.device,
+                                          &set_layout_info,
+                                          NULL,
+                                          &set_layout),
+              "Create downsample set layout");
+
+        VkPushConstantRange push_range = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(sDownsamplePushConstants)
+        };
+
+        VkPipelineLayoutCreateInfo layout_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = NULL,
+            .setLayoutCount = 1,
+            .pSetLayouts = &set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &push_range
+        };
+        VK_OK(vkCreatePipelineLayout(Vulkan.device,
+                                     &layout_info,
+                                     NULL,
+                                     &pipeline_layout),
+              "Create downsample pipeline layout");
+
+        VkShaderModule shader_module;
+        create_shader_module(Vulkan.device,
+                             "resources/shaders/downsample.spv",
+                             &shader_module);
+
+        VkComputePipelineCreateInfo pipeline_info = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = NULL,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = NULL,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main"
+            },
+            .layout = pipeline_layout
+        };
+        VK_OK(vkCreateComputePipelines(Vulkan.device,
+                                       VK_NULL_HANDLE,
+                                       1,
+                                       &pipeline_info,
+                                       NULL,
+                                       &pipeline),
+              "Create downsample pipeline");
+
+        vkDestroyShaderModule(Vulkan.device, shader_module, NULL);
+    }
+
+    // ===== VIEWS & DESCRIPTORS =====
+    // One single level view per mip, and one set per level transition
+    VkImageView *level_views = (VkImageView*) malloc(sizeof(VkImageView) * mip_levels);
+    VkDescriptorSet *sets = (VkDescriptorSet*) malloc(sizeof(VkDescriptorSet) * level_transitions);
+    VkDescriptorPool pool;
+    {
+        for(uint32_t level = 0; level < mip_levels; level++) {
+            VkImageViewCreateInfo view_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = NULL,
+                .image = image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = storage_format,
+                .components = {
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY
+                },
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = level,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                }
+            };
+            VK_OK(vkCreateImageView(Vulkan.device,
+                                    &view_info,
+                                    NULL,
+                                    &level_views[level]),
+                  "Create mip level view");
+        }
+
+        VkDescriptorPoolSize pool_size = {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 2 * level_transitions
+        };
+        VkDescriptorPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .maxSets = level_transitions,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size
+        };
+        VK_OK(vkCreateDescriptorPool(Vulkan.device,
+                                     &pool_info,
+                                     NULL,
+                                     &pool),
+              "Create downsample descriptor pool");
+
+        for(uint32_t i = 0; i < level_transitions; i++) {
+            VkDescriptorSetAllocateInfo alloc_info = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext = NULL,
+                .descriptorPool = pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &set_layout
+            };
+            VK_OK(vkAllocateDescriptorSets(Vulkan.device,
+                                           &alloc_info,
+                                           &sets[i]),
+                  "Allocate downsample set");
+
+            VkDescriptorImageInfo image_infos[2] = {
+                { .sampler = VK_NULL_HANDLE, .imageView = level_views[i], .imageLayout = VK_IMAGE_LAYOUT_GENERAL },
+                { .sampler = VK_NULL_HANDLE, .imageView = level_views[i + 1], .imageLayout = VK_IMAGE_LAYOUT_GENERAL }
+            };
+
+            VkWriteDescriptorSet writes[2];
+            for(uint32_t j = 0; j < 2; j++) {
+                writes[j] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = NULL,
+                    .dstSet = sets[i],
+                    .dstBinding = j,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                    .pImageInfo = &image_infos[j],
+                    .pBufferInfo = NULL,
+                    .pTexelBufferView = NULL
+                };
+            }
+            vkUpdateDescriptorSets(Vulkan.device,
+                                   2,
+                                   writes,
+                                   0,
+                                   NULL);
+        }
+    }
+
+    // ===== DISPATCHES =====
+    {
+        VkCommandBuffer command_buffer = being_single_time_commands();
+
+        // Everything to GENERAL: the level 0 keeps its content
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = mip_levels,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        vkCmdBindPipeline(command_buffer,
+                          VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline);
+
+        uint32_t level_width = width;
+        uint32_t level_height = height;
+        for(uint32_t i = 0; i < level_transitions; i++) {
+            level_width = (level_width > 1) ? level_width / 2 : 1;
+            level_height = (level_height > 1) ? level_height / 2 : 1;
+
+            sDownsamplePushConstants push_constants = {
+                .dst_width = (int32_t) level_width,
+                .dst_height = (int32_t) level_height,
+                .is_srgb = is_srgb ? 1 : 0
+            };
+
+            vkCmdBindDescriptorSets(command_buffer,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    pipeline_layout,
+                                    0,
+                                    1,
+                                    &sets[i],
+                                    0,
+                                    NULL);
+            vkCmdPushConstants(command_buffer,
+                               pipeline_layout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(sDownsamplePushConstants),
+                               &push_constants);
+            vkCmdDispatch(command_buffer,
+                          (level_width + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+                          (level_height + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+                          1);
+
+            // The written level is read on the next dispatch
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.subresourceRange.baseMipLevel = i + 1;
+            barrier.subresourceRange.levelCount = 1;
+            vkCmdPipelineBarrier(command_buffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0,
+                                 0, NULL,
+                                 0, NULL,
+                                 1, &barrier);
+        }
+
+        // The whole chain to be sampled
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mip_levels;
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        end_single_time_commands(command_buffer);
+    }
+
+    // Cleanup, the queue is idle after the single time commands
+    for(uint32_t level = 0; level < mip_levels; level++) {
+        vkDestroyImageView(Vulkan.device, level_views[level], NULL);
+    }
+    free(level_views);
+    free(sets);
+    vkDestroyDescriptorPool(Vulkan.device, pool, NULL);
+    vkDestroyPipeline(Vulkan.device, pipeline, NULL);
+    vkDestroyPipelineLayout(Vulkan.device, pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(Vulkan.device, set_layout, NULL);
+}
+
+void sApp::generate_mipmaps(const VkImage &image,
+                            const VkFormat format,
+                            const uint32_t width,
+                            const uint32_t height,
+                            const uint32_t mip_levels) {
+    // With a single level, the blit path only does the layout transition
+    if (mip_levels == 1 || supports_linear_blit(format)) {
+        VkCommandBuffer command_buffer = being_single_time_commands();
+        record_blit_mip_chain(command_buffer,
+                              image,
+                              width,
+                              height,
+                              mip_levels);
+        end_single_time_commands(command_buffer);
+    } else {
+        _generate_mipmaps_compute(image,
+                                  format,
+                                  width,
+                                  height,
+                                  mip_levels);
+    }
+}
@@ -3,40 +3,73 @@
 #include <cstddef>
 #include <cstdint>
 #include <vulkan/vulkan_core.h>
-#include <chrono>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "uniform_structs.h"
 
 
 void sApp::_render_frame() {
-    // Wait for the prev frame is finished
-    vkWaitForFences(Vulkan.device,
-                    1,
-                    &Vulkan.in_flight_fence[Vulkan.current_frame],
-                    VK_TRUE,
-                    UINT64_MAX);
-    vkResetFences(Vulkan.device,
-                  1,
-                  &Vulkan.in_flight_fence[Vulkan.current_frame]);
-    // Adquire swapchian image
-    vkAcquireNextImageKHR(Vulkan.device,
-                          Vulkan.swapchain,
-                          UINT64_MAX,
-                          Vulkan.image_available_semaphore[Vulkan.current_frame],
-                          VK_NULL_HANDLE,
-                          &Vulkan.swapchain_images_index);
+    // Minimized, retry until the window has a size again
+    if (Vulkan.is_swapchain_stale) {
+        _recreate_swapchain();
+        if (Vulkan.is_swapchain_stale) {
+            return;
+        }
+    }
+
+    // Wait for the prev frame on this slot to be finished
+    Vulkan.graphics_timeline.wait(Vulkan.frame_timeline_values[Vulkan.current_frame]);
+    // The render scale of this frame follows the GPU time of its scene pass, without the
+    // vsync & compute waits of the whole frame
+    double scene_time;
+    frame_pacer.read_gpu_time(Vulkan.current_frame,
+                              &scene_time);
+    dynamic_resolution.update(scene_time);
+
+    // Adquire swapchian image. Before anything of the frame starts, so it can be
+    // skipped if the swapchain is out of date
+    const VkResult acquire_result = vkAcquireNextImageKHR(Vulkan.device,
+                                                          Vulkan.swapchain,
+                                                          UINT64_MAX,
+                                                          Vulkan.image_available_semaphore[Vulkan.current_frame],
+                                                          VK_NULL_HANDLE,
+                                                          &Vulkan.swapchain_images_index);
+    if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+        _recreate_swapchain();
+        return;
+    }
+    // Suboptimal still signals the semaphore, it is recreated after the present
+    assert_msg(acquire_result == VK_SUCCESS || acquire_result == VK_SUBOPTIMAL_KHR, "Acquiring swapchain image");
+
+    // What was released (replaced swapchains, transient images...) and no frame in flight uses anymore
+    Vulkan.deletion_queue.collect();
+
+    // The GPU is done with this frame's sprite vertex buffer, so it can be rewritten
+    sprite_batcher.begin_frame(Vulkan.current_frame);
+
+    // And with the textures it used: evictions & reloads, with the frame's texture uses
+    texture_streamer.begin_frame(Vulkan.current_frame);
+    texture_streamer.mark_used(main_texture);
+    if (tile_cache.is_open) {
+        tile_cache.begin_frame(Vulkan.current_frame);
+    }
+
+    // And with its descriptor set, so the streamed textures can be swapped in
+    if (Vulkan.use_bindless) {
+        bindless_table.begin_frame(Vulkan.current_frame);
+        texture_streamer.update_bindless(&bindless_table);
+    } else {
+        _update_texture_descriptors();
+    }
 
     // Update the uniform buffers
     {
-        // Eeegghhhhhjjjjjj
-        static auto startTime = std::chrono::high_resolution_clock::now();
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+        // The latest ticks of the simulation thread, interpolated to now
+        const sSceneState scene = simulation.get_interpolated(sSimulation::get_time());
 
         sUniformBufferObject ubo = {
             .model = glm::rotate(glm::mat4(1.0f), 
-                                 time * glm::radians(90.0f), 
+                                 scene.quad_rotation, 
                                  glm::vec3(0.0f, 0.0f, 1.0f)),
             .view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), 
                                 glm::vec3(0.0f, 0.0f, 0.0f), 
@@ -49,12 +82,39 @@ void sApp::_render_frame() {
         // Invert the Y coordnate, since glm is  made with opengl in mind
         ubo.proj[1][1] *= -1.0f;
 
+        // The tiled image is flat, on texels of its level 0, and replaces the quad
+        if (tile_cache.is_open) {
+            ubo.model = glm::mat4(1.0f);
+            ubo.view = tiled_image_view.get_view();
+            ubo.proj = tiled_image_view.get_projection(Vulkan.swapchain_info.swapchain_extent);
+            tile_cache.draw(ubo.proj * ubo.view,
+                            Vulkan.swapchain_info.swapchain_extent,
+                            &sprite_batcher,
+                            Vulkan.sprite_pipeline);
+        }
+
+        // Visibility of the scene bounds: tested by this frame's compute pass for its indirect
+        // draws, or on the worker pool for the draws recorded this frame
+        const sFrustum frustum = extract_frustum(ubo.proj,
+                                                 ubo.view);
+        if (gpu_culling.is_enabled) {
+            gpu_culling.begin_frame(Vulkan.current_frame,
+                                    frustum);
+        } else {
+            cull(frustum,
+                 &culling_set,
+                 CULLING_SPHERES,
+                 &worker_pool);
+        }
+
         // Copy to the mapped memmory 
         memcpy(Vulkan.uniform_buffers_mapped[Vulkan.current_frame], 
                &ubo, 
                sizeof(ubo));
     }
 
+    sprite_batcher.end_frame();
+
     // Add teh command buffer
     vkResetCommandBuffer(Vulkan.command_buffers[Vulkan.current_frame],
                          0);
@@ -63,6 +123,11 @@ void sApp::_render_frame() {
                           Vulkan.render_pass,
                           Vulkan.swapchain_images_index);
 
+    // This frame's compute passes, before its graphics submit that waits for them
+    sGpuTimelineWait compute_wait;
+    const bool has_compute = async_compute.submit_frame(Vulkan.current_frame,
+                                                        &compute_wait);
+
     // Submit the command buffer
     VkPipelineStageFlags wait_stagers[1] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     VkSubmitInfo submit_info = {
@@ -77,16 +142,19 @@ void sApp::_render_frame() {
         .pSignalSemaphores = &Vulkan.render_finished_semaphore[Vulkan.current_frame]
     };
 
-    VK_OK(vkQueueSubmit(Vulkan.graphics_queue, 
-                        1, 
-                        &submit_info, 
-                        Vulkan.in_flight_fence[Vulkan.current_frame]), 
-          "Submit Queue frame");
+    // Tagged for the pacer's present wait
+    const uint64_t present_id = frame_pacer.get_next_present_id();
+    VkPresentIdKHR present_id_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = NULL,
+        .swapchainCount = 1,
+        .pPresentIds = &present_id
+    };
 
     // Presentation
     VkPresentInfoKHR present_info = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = NULL,
+        .pNext = (Vulkan.use_present_wait) ? &present_id_info : NULL,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = &Vulkan.render_finished_semaphore[Vulkan.current_frame],
         .swapchainCount = 1,
@@ -95,9 +163,65 @@ void sApp::_render_frame() {
         .pResults = NULL
     };
 
-    VK_OK(vkQueuePresentKHR(Vulkan.graphics_queue, 
-                            &present_info),
-          "Presenting frame");
+    VkResult present_result;
+    {
+        std::lock_guard<std::mutex> queue_lock(Vulkan.graphics_queue_mutex);
+
+        Vulkan.frame_timeline_values[Vulkan.current_frame] = Vulkan.graphics_timeline.submit(Vulkan.graphics_queue,
+                                                                                             submit_info,
+                                                                                             &compute_wait,
+                                                                                             (has_compute) ? 1 : 0);
+
+        present_result = vkQueuePresentKHR(Vulkan.graphics_queue, 
+                                           &present_info);
+    }
+
+    // What was released up to this frame's recording, on its submit
+    Vulkan.deletion_queue.seal();
+
+    frame_pacer.end_frame(Vulkan.current_frame,
+                          present_result == VK_SUCCESS || present_result == VK_SUBOPTIMAL_KHR);
+
+    if (present_result == VK_ERROR_OUT_OF_DATE_KHR ||
+        present_result == VK_SUBOPTIMAL_KHR ||
+        Vulkan.is_framebuffer_resized) {
+        _recreate_swapchain();
+    } else {
+        VK_OK(present_result, "Presenting frame");
+    }
+
+    Vulkan.current_frame = (Vulkan.current_frame + 1) % Vulkan.frame_count;
+}
+
+void sApp::_update_texture_descriptors() {
+    const sTexture &texture = texture_streamer.get(main_texture);
+    if (Vulkan.descriptor_texture_views[Vulkan.current_frame] == texture.texture_image_view) {
+        return;
+    }
+
+    VkDescriptorImageInfo image_info = {
+        .sampler = texture.sampler,
+        .imageView = texture.texture_image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+
+    VkWriteDescriptorSet descriptor_set_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = NULL,
+        .dstSet = Vulkan.descriptor_sets[Vulkan.current_frame],
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+        .pBufferInfo = NULL,
+        .pTexelBufferView = NULL
+    };
 
-    Vulkan.current_frame = (Vulkan.current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
-}
\ No newline at end of file
+    vkUpdateDescriptorSets(Vulkan.device, 
+                           1, 
+                           &descriptor_set_write, 
+                           0, 
+                           NULL);
+    Vulkan.descriptor_texture_views[Vulkan.current_frame] = texture.texture_image_view;
+}
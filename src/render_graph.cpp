@@ -0,0 +1,876 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#include "render_graph.h"
+
+static const sRGAccessInfo RG_ACCESS_INFOS[RG_ACCESS_COUNT] = {
+    { // RG_ACCESS_COLOR_ATTACHMENT
+        .stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .read_access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+        .write_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+    },
+    { // RG_ACCESS_DEPTH_ATTACHMENT
+        .stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .read_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+        .write_access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+    },
+    { // RG_ACCESS_FRAGMENT_SAMPLED
+        .stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_SAMPLED_BIT
+    },
+    { // RG_ACCESS_COMPUTE_SAMPLED
+        .stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_SAMPLED_BIT
+    },
+    { // RG_ACCESS_COMPUTE_STORAGE_READ
+        .stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+        .image_usage = VK_IMAGE_USAGE_STORAGE_BIT
+    },
+    { // RG_ACCESS_COMPUTE_STORAGE_WRITE
+        .stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_SHADER_READ_BIT,
+        .write_access = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+        .image_usage = VK_IMAGE_USAGE_STORAGE_BIT
+    },
+    { // RG_ACCESS_TRANSFER_READ
+        .stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .read_access = VK_ACCESS_2_TRANSFER_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+    },
+    { // RG_ACCESS_TRANSFER_WRITE
+        .stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .read_access = 0,
+        .write_access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    },
+    { // RG_ACCESS_VERTEX_BUFFER
+        .stages = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
+        .read_access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = 0
+    },
+    { // RG_ACCESS_INDEX_BUFFER
+        .stages = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
+        .read_access = VK_ACCESS_2_INDEX_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = 0
+    },
+    { // RG_ACCESS_UNIFORM_BUFFER
+        .stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .read_access = VK_ACCESS_2_UNIFORM_READ_BIT,
+        .write_access = 0,
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .image_usage = 0
+    }
+};
+
+static VkImageAspectFlags get_format_aspect(const VkFormat format) {
+    switch(format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+bool sApp::supports_synchronization2() {
+    if (!has_device_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features = {};
+    synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &synchronization2_features;
+    vkGetPhysicalDeviceFeatures2(Vulkan.physical_device,
+                                 &features);
+
+    return synchronization2_features.synchronization2;
+}
+
+void sRenderGraph::init(sApp *application) {
+    app = application;
+    if (app->Vulkan.use_synchronization2) {
+        cmd_pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(app->Vulkan.device,
+                                                                                   "vkCmdPipelineBarrier2KHR");
+    }
+}
+
+void sRenderGraph::reset() {
+    pass_count = 0;
+    resource_count = 0;
+    version_count = 0;
+}
+
+// ===================================
+// DECLARATION =======================
+// ===================================
+static uint32_t add_resource(sRenderGraph *graph,
+                             const sRGResource &resource) {
+    assert_msg(graph->resource_count < RG_MAX_RESOURCES, "Too many render graph resources");
+    assert_msg(graph->version_count < RG_MAX_VERSIONS, "Too many render graph resource versions");
+
+    const uint32_t resource_index = graph->resource_count++;
+    const uint32_t version = graph->version_count++;
+    graph->resources[resource_index] = resource;
+    graph->resources[resource_index].last_version = version;
+    graph->versions[version] = {
+        .resource = resource_index,
+        .producer = RG_INVALID,
+        .previous = RG_INVALID,
+        .readers = 0
+    };
+    return version;
+}
+
+uint32_t sRenderGraph::import_image(const char *name,
+                                    const VkImage &image,
+                                    const VkImageView &image_view,
+                                    const VkFormat format,
+                                    const VkExtent2D &extent,
+                                    const sRGState &initial_state,
+                                    const VkImageLayout final_layout,
+                                    const bool is_output) {
+    sRGResource resource = {};
+    resource.name = name;
+    resource.type = RG_RESOURCE_IMAGE;
+    resource.is_imported = true;
+    resource.is_output = is_output;
+    resource.image = image;
+    resource.image_view = image_view;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = get_format_aspect(format);
+    resource.final_layout = final_layout;
+    resource.initial_state = initial_state;
+    return add_resource(this, resource);
+}
+
+uint32_t sRenderGraph::import_buffer(const char *name,
+                                     const VkBuffer &buffer,
+                                     const VkDeviceSize size,
+                                     const sRGState &initial_state,
+                                     const bool is_output) {
+    sRGResource resource = {};
+    resource.name = name;
+    resource.type = RG_RESOURCE_BUFFER;
+    resource.is_imported = true;
+    resource.is_output = is_output;
+    resource.buffer = buffer;
+    resource.size = size;
+    resource.initial_state = initial_state;
+    return add_resource(this, resource);
+}
+
+uint32_t sRenderGraph::create_image(const char *name,
+                                    const VkFormat format,
+                                    const VkExtent2D &extent) {
+    sRGResource resource = {};
+    resource.name = name;
+    resource.type = RG_RESOURCE_IMAGE;
+    resource.is_imported = false;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = get_format_aspect(format);
+    resource.final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return add_resource(this, resource);
+}
+
+uint32_t sRenderGraph::add_pass(const char *name,
+                                RenderGraphPassFunction function,
+                                void *data,
+                                const bool has_side_effects) {
+    assert_msg(pass_count < RG_MAX_PASSES, "Too many render graph passes");
+    sRGPass &pass = passes[pass_count];
+    pass.name = name;
+    pass.function = function;
+    pass.data = data;
+    pass.has_side_effects = has_side_effects;
+    pass.access_count = 0;
+    return pass_count++;
+}
+
+uint32_t sRenderGraph::_add_access(const uint32_t pass,
+                                   const uint32_t version,
+                                   const eRGAccess access) {
+    sRGPass &render_pass = passes[pass];
+    assert_msg(render_pass.access_count < RG_MAX_PASS_ACCESSES, "Too many accesses on the render graph pass " << render_pass.name);
+    for(uint32_t i = 0; i < render_pass.access_count; i++) {
+        assert_msg(versions[render_pass.accesses[i].version].resource != versions[version].resource,
+                   "The render graph pass " << render_pass.name << " accesses a resource twice");
+    }
+    render_pass.accesses[render_pass.access_count++] = {
+        .version = version,
+        .access = access
+    };
+    return version;
+}
+
+uint32_t sRenderGraph::read(const uint32_t pass,
+                            const uint32_t version,
+                            const eRGAccess access) {
+    assert_msg(RG_ACCESS_INFOS[access].write_access == 0, "Reading with a write access");
+    versions[version].readers |= 1u << pass;
+    return _add_access(pass, version, access);
+}
+
+uint32_t sRenderGraph::write(const uint32_t pass,
+                             const uint32_t version,
+                             const eRGAccess access) {
+    sRGResource &resource = resources[versions[version].resource];
+    assert_msg(resource.last_version == version, "Only the last version of " << resource.name << " can be written");
+    assert_msg(version_count < RG_MAX_VERSIONS, "Too many render graph resource versions");
+
+    const uint32_t new_version = version_count++;
+    versions[new_version] = {
+        .resource = versions[version].resource,
+        .producer = pass,
+        .previous = version,
+        .readers = 0
+    };
+    resource.last_version = new_version;
+    return _add_access(pass, new_version, access);
+}
+
+// ===================================
+// COMPILE ===========================
+// ===================================
+void sRenderGraph::compile() {
+    bool is_live[RG_MAX_PASSES];
+    _cull_passes(is_live);
+    _sort_passes(is_live);
+
+    // Lifetimes on the sorted passes, and the usage of the transients
+    for(uint32_t i = 0; i < resource_count; i++) {
+        resources[i].first_use = RG_INVALID;
+        resources[i].last_use = 0;
+        resources[i].usage = 0;
+    }
+    for(uint32_t i = 0; i < sorted_count; i++) {
+        const sRGPass &pass = passes[sorted_passes[i]];
+        for(uint32_t j = 0; j < pass.access_count; j++) {
+            sRGResource &resource = resources[versions[pass.accesses[j].version].resource];
+            resource.first_use = (resource.first_use == RG_INVALID) ? i : resource.first_use;
+            resource.last_use = i;
+            resource.usage |= RG_ACCESS_INFOS[pass.accesses[j].access].image_usage;
+        }
+    }
+
+    if (!_is_transient_set_valid()) {
+        _build_transients();
+    }
+
+    _place_barriers();
+}
+
+void sRenderGraph::_cull_passes(bool *is_live) {
+    for(uint32_t i = 0; i < pass_count; i++) {
+        is_live[i] = passes[i].has_side_effects;
+    }
+    for(uint32_t i = 0; i < resource_count; i++) {
+        const uint32_t producer = versions[resources[i].last_version].producer;
+        if (resources[i].is_output && producer != RG_INVALID) {
+            is_live[producer] = true;
+        }
+    }
+
+    // Backwards from the live passes: the producers of what they read
+    bool has_changed = true;
+    while(has_changed) {
+        has_changed = false;
+        for(uint32_t i = 0; i < pass_count; i++) {
+            if (!is_live[i]) {
+                continue;
+            }
+
+            const sRGPass &pass = passes[i];
+            for(uint32_t j = 0; j < pass.access_count; j++) {
+                const sRGAccessInfo &info = RG_ACCESS_INFOS[pass.accesses[j].access];
+                const sRGVersion &version = versions[pass.accesses[j].version];
+
+                // A write only needs the previous contents if it also reads them (blending...)
+                uint32_t producer = RG_INVALID;
+                if (info.write_access == 0) {
+                    producer = version.producer;
+                } else if (info.read_access != 0) {
+                    producer = versions[version.previous].producer;
+                }
+
+                if (producer != RG_INVALID && !is_live[producer]) {
+                    is_live[producer] = true;
+                    has_changed = true;
+                }
+            }
+        }
+    }
+
+    culled_pass_count = 0;
+    for(uint32_t i = 0; i < pass_count; i++) {
+        culled_pass_count += (is_live[i]) ? 0 : 1;
+    }
+}
+
+void sRenderGraph::_sort_passes(const bool *is_live) {
+    uint32_t live_mask = 0;
+    for(uint32_t i = 0; i < pass_count; i++) {
+        live_mask |= (is_live[i]) ? (1u << i) : 0;
+    }
+
+    // Read after write, write after write & write after read
+    uint32_t dependencies[RG_MAX_PASSES] = {};
+    for(uint32_t i = 0; i < pass_count; i++) {
+        const sRGPass &pass = passes[i];
+        for(uint32_t j = 0; j < pass.access_count; j++) {
+            const sRGVersion &version = versions[pass.accesses[j].version];
+            if (RG_ACCESS_INFOS[pass.accesses[j].access].write_access == 0) {
+                dependencies[i] |= (version.producer != RG_INVALID) ? (1u << version.producer) : 0;
+            } else {
+                const sRGVersion &previous = versions[version.previous];
+                dependencies[i] |= (previous.producer != RG_INVALID) ? (1u << previous.producer) : 0;
+                dependencies[i] |= previous.readers & ~(1u << i);
+            }
+        }
+        dependencies[i] &= live_mask;
+    }
+
+    // Kahn's, taking the first declared pass that is ready
+    sorted_count = 0;
+    uint32_t sorted_mask = 0;
+    while(sorted_mask != live_mask) {
+        uint32_t ready = RG_INVALID;
+        for(uint32_t i = 0; i < pass_count && ready == RG_INVALID; i++) {
+            if ((live_mask & ~sorted_mask & (1u << i)) && (dependencies[i] & ~sorted_mask) == 0) {
+                ready = i;
+            }
+        }
+        assert_msg(ready != RG_INVALID, "The render graph has a cycle");
+
+        sorted_passes[sorted_count++] = ready;
+        sorted_mask |= 1u << ready;
+    }
+}
+
+void sRenderGraph::_place_barriers() {
+    image_barrier_count = 0;
+    buffer_barrier_count = 0;
+    barrier_call_count = 0;
+
+    for(uint32_t i = 0; i < resource_count; i++) {
+        sRGResource &resource = resources[i];
+        if (resource.is_imported) {
+            resource.state = resource.initial_state;
+        } else if (resource.first_use != RG_INVALID) {
+            // After the image that used the memory before, on this frame or the previous one.
+            // The contents are undefined either way
+            const sRGState &block_state = transients.blocks[transients.images[resource.transient_index].block].state;
+            resource.state = {
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .write_stages = block_state.write_stages | block_state.read_stages,
+                .write_access = block_state.write_access,
+                .read_stages = 0
+            };
+        }
+    }
+
+    for(uint32_t i = 0; i < sorted_count; i++) {
+        sRGPass &pass = passes[sorted_passes[i]];
+        pass.first_image_barrier = image_barrier_count;
+        pass.first_buffer_barrier = buffer_barrier_count;
+
+        for(uint32_t j = 0; j < pass.access_count; j++) {
+            const uint32_t version = pass.accesses[j].version;
+            const sRGAccessInfo &info = RG_ACCESS_INFOS[pass.accesses[j].access];
+            sRGResource &resource = resources[versions[version].resource];
+            sRGState &state = resource.state;
+
+            const bool is_image = resource.type == RG_RESOURCE_IMAGE;
+            const bool is_write = info.write_access != 0;
+            const bool is_transition = is_image && (state.layout != info.layout || (!resource.is_imported && resource.first_use == i));
+
+            bool needs_barrier;
+            if (is_transition || is_write) {
+                needs_barrier = is_transition || (state.write_stages | state.read_stages) != 0;
+            } else {
+                // Already visible to these stages since the last write
+                needs_barrier = state.write_stages != 0 && (info.stages & ~state.read_stages) != 0;
+            }
+
+            if (needs_barrier) {
+                VkPipelineStageFlags2 dst_stages = info.stages;
+                VkAccessFlags2 dst_access = info.read_access | info.write_access;
+
+                // Hoisted: the later passes that read this same version, on the same layout,
+                // are synchronized on this barrier too, instead of one barrier each
+                if (!is_write) {
+                    for(uint32_t k = i + 1; k < sorted_count; k++) {
+                        const sRGPass &later_pass = passes[sorted_passes[k]];
+                        for(uint32_t l = 0; l < later_pass.access_count; l++) {
+                            const sRGAccessInfo &later_info = RG_ACCESS_INFOS[later_pass.accesses[l].access];
+                            if (later_pass.accesses[l].version == version &&
+                                later_info.write_access == 0 &&
+                                later_info.layout == info.layout) {
+                                dst_stages |= later_info.stages;
+                                dst_access |= later_info.read_access;
+                            }
+                        }
+                    }
+                }
+
+                // Writes & layout changes wait for the reads too, the reads only for the write
+                const VkPipelineStageFlags2 src_stages = (is_transition || is_write) ? (state.write_stages | state.read_stages) : state.write_stages;
+
+                if (is_image) {
+                    assert_msg(image_barrier_count < RG_MAX_BARRIERS, "Too many render graph barriers");
+                    image_barriers[image_barrier_count++] = {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                        .pNext = NULL,
+                        .srcStageMask = src_stages,
+                        .srcAccessMask = state.write_access,
+                        .dstStageMask = dst_stages,
+                        .dstAccessMask = dst_access,
+                        .oldLayout = state.layout,
+                        .newLayout = info.layout,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = get_image(version),
+                        .subresourceRange = {
+                            .aspectMask = resource.aspect,
+                            .baseMipLevel = 0,
+                            .levelCount = VK_REMAINING_MIP_LEVELS,
+                            .baseArrayLayer = 0,
+                            .layerCount = VK_REMAINING_ARRAY_LAYERS
+                        }
+                    };
+                } else {
+                    assert_msg(buffer_barrier_count < RG_MAX_BARRIERS, "Too many render graph barriers");
+                    buffer_barriers[buffer_barrier_count++] = {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                        .pNext = NULL,
+                        .srcStageMask = src_stages,
+                        .srcAccessMask = state.write_access,
+                        .dstStageMask = dst_stages,
+                        .dstAccessMask = dst_access,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = resource.buffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE
+                    };
+                }
+
+                if (!is_write) {
+                    state.read_stages = (is_transition) ? dst_stages : (state.read_stages | dst_stages);
+                }
+            }
+
+            if (is_write) {
+                state = {
+                    .layout = info.layout,
+                    .write_stages = info.stages,
+                    .write_access = info.write_access,
+                    .read_stages = 0
+                };
+            } else {
+                state.layout = (is_image) ? info.layout : state.layout;
+            }
+
+            // The next image on the same memory starts after this one
+            if (!resource.is_imported) {
+                transients.blocks[transients.images[resource.transient_index].block].state = state;
+            }
+        }
+
+        pass.image_barrier_count = image_barrier_count - pass.first_image_barrier;
+        pass.buffer_barrier_count = buffer_barrier_count - pass.first_buffer_barrier;
+        barrier_call_count += (pass.image_barrier_count + pass.buffer_barrier_count > 0) ? 1 : 0;
+    }
+
+    // The imported images that leave on a given layout (the swapchain, to present)
+    final_image_barrier_begin = image_barrier_count;
+    for(uint32_t i = 0; i < resource_count; i++) {
+        const sRGResource &resource = resources[i];
+        if (!resource.is_imported ||
+            resource.type != RG_RESOURCE_IMAGE ||
+            resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            resource.final_layout == resource.state.layout) {
+            continue;
+        }
+
+        assert_msg(image_barrier_count < RG_MAX_BARRIERS, "Too many render graph barriers");
+        image_barriers[image_barrier_count++] = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .pNext = NULL,
+            .srcStageMask = resource.state.write_stages | resource.state.read_stages,
+            .srcAccessMask = resource.state.write_access,
+            .dstStageMask = VK_PIPELINE_STAGE_2_NONE, // Waited by the semaphores of the submit
+            .dstAccessMask = 0,
+            .oldLayout = resource.state.layout,
+            .newLayout = resource.final_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = resource.image,
+            .subresourceRange = {
+                .aspectMask = resource.aspect,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS
+            }
+        };
+    }
+    barrier_call_count += (image_barrier_count > final_image_barrier_begin) ? 1 : 0;
+}
+
+// ===================================
+// TRANSIENT IMAGES ==================
+// ===================================
+bool sRenderGraph::_is_transient_set_valid() {
+    uint32_t transient_count = 0;
+    for(uint32_t i = 0; i < resource_count; i++) {
+        const sRGResource &resource = resources[i];
+        if (resource.is_imported || resource.first_use == RG_INVALID) {
+            continue;
+        }
+
+        if (transient_count >= transients.image_count) {
+            return false;
+        }
+        const sRGTransientImage &image = transients.images[transient_count++];
+        if (image.format != resource.format ||
+            image.extent.width != resource.extent.width ||
+            image.extent.height != resource.extent.height ||
+            image.usage != resource.usage ||
+            image.first_use != resource.first_use ||
+            image.last_use != resource.last_use) {
+            return false;
+        }
+    }
+    if (transient_count != transients.image_count) {
+        return false;
+    }
+
+    // Same order on every frame
+    transient_count = 0;
+    for(uint32_t i = 0; i < resource_count; i++) {
+        if (!resources[i].is_imported && resources[i].first_use != RG_INVALID) {
+            resources[i].transient_index = transient_count++;
+        }
+    }
+    return true;
+}
+
+void sRenderGraph::_build_transients() {
+    const VkDevice &device = app->Vulkan.device;
+
+    // The frames in flight may still use the previous ones
+    _release_transient_set(&transients);
+    transient_generation++;
+
+    VkMemoryRequirements requirements[RG_MAX_RESOURCES];
+    uint32_t order[RG_MAX_RESOURCES];
+    for(uint32_t i = 0; i < resource_count; i++) {
+        sRGResource &resource = resources[i];
+        if (resource.is_imported || resource.first_use == RG_INVALID) {
+            continue;
+        }
+
+        const uint32_t index = transients.image_count++;
+        resource.transient_index = index;
+        sRGTransientImage &image = transients.images[index];
+        image = {
+            .format = resource.format,
+            .extent = resource.extent,
+            .usage = resource.usage,
+            .first_use = resource.first_use,
+            .last_use = resource.last_use,
+            .image = VK_NULL_HANDLE,
+            .image_view = VK_NULL_HANDLE,
+            .block = RG_INVALID
+        };
+
+        VkImageCreateInfo image_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = resource.format,
+            .extent = { resource.extent.width, resource.extent.height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = resource.usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = NULL,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VK_OK(vkCreateImage(device,
+                            &image_info,
+                            NULL,
+                            &image.image),
+              "Create transient image " << resource.name);
+        vkGetImageMemoryRequirements(device,
+                                     image.image,
+                                     &requirements[index]);
+        order[index] = index;
+    }
+
+    // Biggest first, so the smaller ones fit in the blocks they make
+    for(uint32_t i = 1; i < transients.image_count; i++) {
+        const uint32_t current = order[i];
+        uint32_t j = i;
+        for(; j > 0 && requirements[order[j - 1]].size < requirements[current].size; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = current;
+    }
+
+    // On the first block of a compatible memory type where no other image is alive at the same time
+    unaliased_transient_memory = 0;
+    for(uint32_t i = 0; i < transients.image_count; i++) {
+        const uint32_t index = order[i];
+        sRGTransientImage &image = transients.images[index];
+        unaliased_transient_memory += requirements[index].size;
+
+        for(uint32_t block = 0; block < transients.block_count && image.block == RG_INVALID; block++) {
+            if ((requirements[index].memoryTypeBits & (1u << transients.blocks[block].memory_type)) == 0) {
+                continue;
+            }
+
+            bool is_overlapping = false;
+            for(uint32_t j = 0; j < transients.image_count && !is_overlapping; j++) {
+                const sRGTransientImage &other = transients.images[j];
+                is_overlapping = other.block == block &&
+                                 other.first_use <= image.last_use &&
+                                 image.first_use <= other.last_use;
+            }
+            if (!is_overlapping) {
+                image.block = block;
+            }
+        }
+
+        if (image.block == RG_INVALID) {
+            image.block = transients.block_count++;
+            transients.blocks[image.block] = {
+                .memory = VK_NULL_HANDLE,
+                .size = 0,
+                .memory_type = app->find_memmory_type(app->Vulkan.physical_device,
+                                                      requirements[index].memoryTypeBits,
+                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                .state = {
+                    .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                    .write_stages = 0,
+                    .write_access = 0,
+                    .read_stages = 0
+                }
+            };
+        }
+
+        // Every image of the block starts at its beginning, offset 0 is always aligned
+        sRGMemoryBlock &block = transients.blocks[image.block];
+        block.size = (requirements[index].size > block.size) ? requirements[index].size : block.size;
+    }
+
+    transient_memory = 0;
+    for(uint32_t i = 0; i < transients.block_count; i++) {
+        sRGMemoryBlock &block = transients.blocks[i];
+        VkMemoryAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = NULL,
+            .allocationSize = block.size,
+            .memoryTypeIndex = block.memory_type
+        };
+        VK_OK(vkAllocateMemory(device,
+                               &alloc_info,
+                               NULL,
+                               &block.memory),
+              "Allocate transient memory");
+        transient_memory += block.size;
+    }
+
+    for(uint32_t i = 0; i < transients.image_count; i++) {
+        sRGTransientImage &image = transients.images[i];
+        VK_OK(vkBindImageMemory(device,
+                                image.image,
+                                transients.blocks[image.block].memory,
+                                0),
+              "Bind transient image");
+
+        VkImageViewCreateInfo view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = NULL,
+            .flags = 0,
+            .image = image.image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = image.format,
+            .components = {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY
+            },
+            .subresourceRange = {
+                .aspectMask = get_format_aspect(image.format),
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        VK_OK(vkCreateImageView(device,
+                                &view_info,
+                                NULL,
+                                &image.image_view),
+              "Create transient image view");
+    }
+}
+
+void sRenderGraph::_release_transient_set(sRGTransientSet *set) {
+    sDeletionQueue &deletion_queue = app->Vulkan.deletion_queue;
+    for(uint32_t i = 0; i < set->image_count; i++) {
+        deletion_queue.push(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t) set->images[i].image_view);
+        deletion_queue.push(VK_OBJECT_TYPE_IMAGE, (uint64_t) set->images[i].image);
+    }
+    for(uint32_t i = 0; i < set->block_count; i++) {
+        deletion_queue.push(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t) set->blocks[i].memory);
+    }
+    set->image_count = 0;
+    set->block_count = 0;
+}
+
+// ===================================
+// EXECUTE ===========================
+// ===================================
+void sRenderGraph::execute(const VkCommandBuffer &command_buffer) {
+    for(uint32_t i = 0; i < sorted_count; i++) {
+        const sRGPass &pass = passes[sorted_passes[i]];
+        _record_barriers(command_buffer,
+                         &image_barriers[pass.first_image_barrier],
+                         pass.image_barrier_count,
+                         &buffer_barriers[pass.first_buffer_barrier],
+                         pass.buffer_barrier_count);
+        pass.function(command_buffer,
+                      *this,
+                      pass.data);
+    }
+
+    _record_barriers(command_buffer,
+                     &image_barriers[final_image_barrier_begin],
+                     image_barrier_count - final_image_barrier_begin,
+                     NULL,
+                     0);
+}
+
+void sRenderGraph::_record_barriers(const VkCommandBuffer &command_buffer,
+                                    const VkImageMemoryBarrier2 *image_barrier_list,
+                                    const uint32_t image_count,
+                                    const VkBufferMemoryBarrier2 *buffer_barrier_list,
+                                    const uint32_t buffer_count) {
+    if (image_count + buffer_count == 0) {
+        return;
+    }
+
+    if (cmd_pipeline_barrier2 != NULL) {
+        VkDependencyInfo dependency_info = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .pNext = NULL,
+            .dependencyFlags = 0,
+            .memoryBarrierCount = 0,
+            .pMemoryBarriers = NULL,
+            .bufferMemoryBarrierCount = buffer_count,
+            .pBufferMemoryBarriers = buffer_barrier_list,
+            .imageMemoryBarrierCount = image_count,
+            .pImageMemoryBarriers = image_barrier_list
+        };
+        cmd_pipeline_barrier2(command_buffer,
+                              &dependency_info);
+        return;
+    }
+
+    // Without synchronization2: the stages are merged on the single call. The stage &
+    // access bits used by RG_ACCESS_INFOS have the same values on the legacy flags
+    sScratchScope scratch(get_scratch_allocator());
+    VkImageMemoryBarrier *legacy_image_barriers = scratch.alloc_array<VkImageMemoryBarrier>(image_count);
+    VkBufferMemoryBarrier *legacy_buffer_barriers = scratch.alloc_array<VkBufferMemoryBarrier>(buffer_count);
+    VkPipelineStageFlags src_stages = 0, dst_stages = 0;
+    for(uint32_t i = 0; i < image_count; i++) {
+        const VkImageMemoryBarrier2 &barrier = image_barrier_list[i];
+        src_stages |= (VkPipelineStageFlags) barrier.srcStageMask;
+        dst_stages |= (VkPipelineStageFlags) barrier.dstStageMask;
+        legacy_image_barriers[i] = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = (VkAccessFlags) barrier.srcAccessMask,
+            .dstAccessMask = (VkAccessFlags) barrier.dstAccessMask,
+            .oldLayout = barrier.oldLayout,
+            .newLayout = barrier.newLayout,
+            .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+            .image = barrier.image,
+            .subresourceRange = barrier.subresourceRange
+        };
+    }
+    for(uint32_t i = 0; i < buffer_count; i++) {
+        const VkBufferMemoryBarrier2 &barrier = buffer_barrier_list[i];
+        src_stages |= (VkPipelineStageFlags) barrier.srcStageMask;
+        dst_stages |= (VkPipelineStageFlags) barrier.dstStageMask;
+        legacy_buffer_barriers[i] = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = (VkAccessFlags) barrier.srcAccessMask,
+            .dstAccessMask = (VkAccessFlags) barrier.dstAccessMask,
+            .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+            .buffer = barrier.buffer,
+            .offset = barrier.offset,
+            .size = barrier.size
+        };
+    }
+
+    vkCmdPipelineBarrier(command_buffer,
+                         (src_stages != 0) ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         (dst_stages != 0) ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0, NULL,
+                         buffer_count, legacy_buffer_barriers,
+                         image_count, legacy_image_barriers);
+}
+
+void sRenderGraph::cleanup() {
+    _release_transient_set(&transients);
+}
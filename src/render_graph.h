@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+
+#define RG_MAX_PASSES        32 // The readers of a version are a bit mask
+#define RG_MAX_RESOURCES     64
+#define RG_MAX_VERSIONS      128
+#define RG_MAX_PASS_ACCESSES 24 // The main pass reads every texture copied on the frame
+#define RG_MAX_BARRIERS      128
+#define RG_INVALID           UINT32_MAX
+
+struct sApp;
+struct sRenderGraph;
+
+typedef void (*RenderGraphPassFunction)(const VkCommandBuffer &command_buffer,
+                                        const sRenderGraph &graph,
+                                        void *data);
+
+enum eRGResourceType : uint32_t {
+    RG_RESOURCE_IMAGE = 0,
+    RG_RESOURCE_BUFFER
+};
+
+// How a pass uses a resource, see RG_ACCESS_INFOS
+enum eRGAccess : uint32_t {
+    RG_ACCESS_COLOR_ATTACHMENT = 0, // Written, and read by the blending
+    RG_ACCESS_DEPTH_ATTACHMENT,
+    RG_ACCESS_FRAGMENT_SAMPLED,
+    RG_ACCESS_COMPUTE_SAMPLED,
+    RG_ACCESS_COMPUTE_STORAGE_READ,
+    RG_ACCESS_COMPUTE_STORAGE_WRITE,
+    RG_ACCESS_TRANSFER_READ,
+    RG_ACCESS_TRANSFER_WRITE,
+    RG_ACCESS_VERTEX_BUFFER,
+    RG_ACCESS_INDEX_BUFFER,
+    RG_ACCESS_UNIFORM_BUFFER,
+    RG_ACCESS_COUNT
+};
+
+struct sRGAccessInfo {
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2        read_access;
+    VkAccessFlags2        write_access; // 0 on read only accesses
+    VkImageLayout         layout;
+    VkImageUsageFlags     image_usage; // For the transient images
+};
+
+// Synchronization state of a resource, or of a transient memory block
+struct sRGState {
+    VkImageLayout         layout;
+    VkPipelineStageFlags2 write_stages; // Of the last write
+    VkAccessFlags2        write_access;
+    VkPipelineStageFlags2 read_stages; // Already synchronized with the last write
+};
+
+struct sRGResource {
+    const char         *name;
+    eRGResourceType    type;
+    bool               is_imported;
+    bool               is_output; // Its last version is needed after the graph, the passes that write it are never culled
+    uint32_t           last_version;
+
+    // Images
+    VkImage            image;
+    VkImageView        image_view;
+    VkFormat           format;
+    VkExtent2D         extent;
+    VkImageAspectFlags aspect;
+    VkImageUsageFlags  usage; // Of every access, on transient images
+    VkImageLayout      final_layout; // Left on it after the graph, UNDEFINED to leave it as is
+
+    // Buffers
+    VkBuffer           buffer;
+    VkDeviceSize       size;
+
+    sRGState           initial_state; // Imported resources
+    sRGState           state;
+
+    // Lifetime on the sorted passes, and the physical image of the transients
+    uint32_t           first_use;
+    uint32_t           last_use;
+    uint32_t           transient_index;
+};
+
+// Each write makes a new version, so the dependencies do not depend on the declaration order
+struct sRGVersion {
+    uint32_t resource;
+    uint32_t producer; // RG_INVALID for the first version
+    uint32_t previous; // The version the write replaced
+    uint32_t readers; // Mask of passes
+};
+
+struct sRGPassAccess {
+    uint32_t  version; // Read, or produced by a write
+    eRGAccess access;
+};
+
+struct sRGPass {
+    const char              *name;
+    RenderGraphPassFunction function;
+    void                    *data;
+    bool                    has_side_effects; // Never culled (uploads, readbacks...)
+    sRGPassAccess           accesses[RG_MAX_PASS_ACCESSES];
+    uint32_t                access_count;
+
+    // Merged on a single barrier call before the pass
+    uint32_t                first_image_barrier;
+    uint32_t                image_barrier_count;
+    uint32_t                first_buffer_barrier;
+    uint32_t                buffer_barrier_count;
+};
+
+// Physical images of the transient resources, and the memory blocks they alias on
+struct sRGTransientImage {
+    VkFormat          format;
+    VkExtent2D        extent;
+    VkImageUsageFlags usage;
+    uint32_t          first_use;
+    uint32_t          last_use;
+
+    VkImage           image;
+    VkImageView       image_view;
+    uint32_t          block;
+};
+
+struct sRGMemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize   size;
+    uint32_t       memory_type;
+    sRGState       state; // Of the last image that used it, this frame or the previous one
+};
+
+struct sRGTransientSet {
+    sRGTransientImage images[RG_MAX_RESOURCES];
+    uint32_t          image_count = 0;
+    sRGMemoryBlock    blocks[RG_MAX_RESOURCES];
+    uint32_t          block_count = 0;
+};
+
+// Per frame: the passes declare what they read & write, and compile() sorts them, culls
+// the ones whose results are not used, places the fewest barriers between them, and
+// aliases the transient images with disjoint lifetimes on the same memory. The transient
+// images are kept between frames, and only rebuilt when their descriptions change (the
+// old ones are released through the deletion queue)
+struct sRenderGraph {
+    sRGPass           passes[RG_MAX_PASSES];
+    uint32_t          pass_count = 0;
+    sRGResource       resources[RG_MAX_RESOURCES];
+    uint32_t          resource_count = 0;
+    sRGVersion        versions[RG_MAX_VERSIONS];
+    uint32_t          version_count = 0;
+
+    // Result of compile()
+    uint32_t          sorted_passes[RG_MAX_PASSES];
+    uint32_t          sorted_count = 0;
+    VkImageMemoryBarrier2  image_barriers[RG_MAX_BARRIERS];
+    uint32_t               image_barrier_count = 0;
+    VkBufferMemoryBarrier2 buffer_barriers[RG_MAX_BARRIERS];
+    uint32_t               buffer_barrier_count = 0;
+    uint32_t          final_image_barrier_begin = 0; // After the last pass, to the final layouts
+
+    sRGTransientSet   transients;
+    // Bumped each time the transients are rebuilt, from 1. What caches their views (framebuffers,
+    // descriptors) keys on it: a new view can reuse the handle value of a released one
+    uint64_t          transient_generation = 0;
+
+    // Stats of the last compile, and of the aliasing
+    uint32_t          culled_pass_count = 0;
+    uint32_t          barrier_call_count = 0;
+    VkDeviceSize      transient_memory = 0;
+    VkDeviceSize      unaliased_transient_memory = 0;
+
+    // vkCmdPipelineBarrier2 from VK_KHR_synchronization2, or NULL to use the legacy barriers
+    PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier2 = NULL;
+
+    sApp              *app = NULL;
+
+    void init(sApp *application);
+
+    // Starts a new frame's graph
+    void reset();
+
+    uint32_t import_image(const char *name,
+                          const VkImage &image,
+                          const VkImageView &image_view,
+                          const VkFormat format,
+                          const VkExtent2D &extent,
+                          const sRGState &initial_state,
+                          const VkImageLayout final_layout,
+                          const bool is_output);
+    uint32_t import_buffer(const char *name,
+                           const VkBuffer &buffer,
+                           const VkDeviceSize size,
+                           const sRGState &initial_state,
+                           const bool is_output);
+    // Contents undefined on its first use, only alive between its first & last pass
+    uint32_t create_image(const char *name,
+                          const VkFormat format,
+                          const VkExtent2D &extent);
+
+    uint32_t add_pass(const char *name,
+                      RenderGraphPassFunction function,
+                      void *data,
+                      const bool has_side_effects = false);
+    // Return the version to use afterwards: the same one on reads, a new one on writes
+    uint32_t read(const uint32_t pass,
+                  const uint32_t version,
+                  const eRGAccess access);
+    uint32_t write(const uint32_t pass,
+                   const uint32_t version,
+                   const eRGAccess access);
+
+    void compile();
+    void execute(const VkCommandBuffer &command_buffer);
+
+    // For the pass functions
+    inline VkImage get_image(const uint32_t version) const {
+        const sRGResource &resource = resources[versions[version].resource];
+        return (resource.is_imported) ? resource.image : transients.images[resource.transient_index].image;
+    }
+    inline VkImageView get_image_view(const uint32_t version) const {
+        const sRGResource &resource = resources[versions[version].resource];
+        return (resource.is_imported) ? resource.image_view : transients.images[resource.transient_index].image_view;
+    }
+    inline VkBuffer get_buffer(const uint32_t version) const {
+        return resources[versions[version].resource].buffer;
+    }
+
+    // NOTE: once the device is idle
+    void cleanup();
+
+    uint32_t _add_access(const uint32_t pass,
+                         const uint32_t version,
+                         const eRGAccess access);
+    void _cull_passes(bool *is_live);
+    void _sort_passes(const bool *is_live);
+    void _place_barriers();
+    bool _is_transient_set_valid();
+    void _build_transients();
+    // The frames in flight may still use them, so through the deletion queue
+    void _release_transient_set(sRGTransientSet *set);
+    void _record_barriers(const VkCommandBuffer &command_buffer,
+                          const VkImageMemoryBarrier2 *image_barrier_list,
+                          const uint32_t image_count,
+                          const VkBufferMemoryBarrier2 *buffer_barrier_list,
+                          const uint32_t buffer_count);
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <mutex>
+#include <vulkan/vulkan_core.h>
+
+#include "utils.h"
+
+#define SAMPLER_CACHE_MAX_SAMPLERS 64
+
+// The state that identifies a sampler, without padding so it can be hashed & compared as bytes
+struct sSamplerKey {
+    uint32_t mag_filter;
+    uint32_t min_filter;
+    uint32_t mipmap_mode;
+    uint32_t address_modes[3];
+    float    mip_lod_bias;
+    uint32_t anisotropy_enable;
+    float    max_anisotropy;
+    uint32_t compare_enable;
+    uint32_t compare_op;
+    float    min_lod;
+    float    max_lod;
+    uint32_t border_color;
+    uint32_t unnormalized_coordinates;
+    uint32_t flags;
+};
+
+struct sCachedSampler {
+    sSamplerKey key;
+    uint64_t    hash;
+    VkSampler   sampler;
+    uint32_t    ref_count;
+};
+
+// Shared, reference counted samplers. The drivers cap the sampler count
+// (maxSamplerAllocationCount), and most textures use the same state anyway
+struct sSamplerCache {
+    sCachedSampler samplers[SAMPLER_CACHE_MAX_SAMPLERS];
+    uint32_t       sampler_count = 0;
+
+    VkPhysicalDeviceLimits limits; // Queried once
+    std::mutex     mutex; // The texture streamer creates samplers from its thread
+
+    VkDevice       *device = NULL;
+
+    void init(VkDevice *vk_device,
+              const VkPhysicalDevice &physical_device) {
+        device = vk_device;
+
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(physical_device,
+                                      &properties);
+        limits = properties.limits;
+    }
+
+    // The usual texture state: trilinear, anisotropic and mirrored repeat
+    // maxLod is not clamped, so any mip count can share it
+    VkSamplerCreateInfo default_create_info() const {
+        return {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext = NULL,
+            .magFilter = VK_FILTER_LINEAR,
+            .minFilter = VK_FILTER_LINEAR,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, // Wrap arround UVS using a repeat
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+            .mipLodBias = 0.0f,
+            .anisotropyEnable = VK_TRUE,
+            .maxAnisotropy = limits.maxSamplerAnisotropy,
+            .compareEnable = VK_FALSE, // PCF on shadowmaps
+            .compareOp = VK_COMPARE_OP_ALWAYS,
+            .minLod = 0.0f,
+            .maxLod = VK_LOD_CLAMP_NONE,
+            .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+            .unnormalizedCoordinates = VK_FALSE, // The UVs are from 0,1
+        };
+    }
+
+    static sSamplerKey _make_key(const VkSamplerCreateInfo &info) {
+        sSamplerKey key;
+        memset(&key, 0, sizeof(key));
+        key.mag_filter = info.magFilter;
+        key.min_filter = info.minFilter;
+        key.mipmap_mode = info.mipmapMode;
+        key.address_modes[0] = info.addressModeU;
+        key.address_modes[1] = info.addressModeV;
+        key.address_modes[2] = info.addressModeW;
+        key.mip_lod_bias = info.mipLodBias;
+        key.anisotropy_enable = info.anisotropyEnable;
+        key.max_anisotropy = (info.anisotropyEnable) ? info.maxAnisotropy : 1.0f;
+        key.compare_enable = info.compareEnable;
+        key.compare_op = (info.compareEnable) ? info.compareOp : VK_COMPARE_OP_ALWAYS;
+        key.min_lod = info.minLod;
+        key.max_lod = info.maxLod;
+        key.border_color = info.borderColor;
+        key.unnormalized_coordinates = info.unnormalizedCoordinates;
+        key.flags = info.flags;
+        return key;
+    }
+
+    // FNV-1a
+    static uint64_t _hash_key(const sSamplerKey &key) {
+        const uint8_t *bytes = (const uint8_t*) &key;
+        uint64_t hash = 14695981039346656037ull;
+        for(uint32_t i = 0; i < sizeof(sSamplerKey); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    VkSampler acquire(const VkSamplerCreateInfo &requested_info) {
+        assert_msg(requested_info.pNext == NULL, "The sampler cache does not hash pNext chains");
+
+        // Clamp to what the device supports, before hashing
+        VkSamplerCreateInfo info = requested_info;
+        if (info.maxAnisotropy > limits.maxSamplerAnisotropy) {
+            info.maxAnisotropy = limits.maxSamplerAnisotropy;
+        }
+
+        const sSamplerKey key = _make_key(info);
+        const uint64_t hash = _hash_key(key);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(uint32_t i = 0; i < sampler_count; i++) {
+            if (samplers[i].hash == hash && memcmp(&samplers[i].key, &key, sizeof(sSamplerKey)) == 0) {
+                samplers[i].ref_count++;
+                return samplers[i].sampler;
+            }
+        }
+
+        assert_msg(sampler_count < SAMPLER_CACHE_MAX_SAMPLERS && sampler_count < limits.maxSamplerAllocationCount, "Too many unique samplers");
+
+        sCachedSampler *cached = &samplers[sampler_count++];
+        cached->key = key;
+        cached->hash = hash;
+        cached->ref_count = 1;
+        VK_OK(vkCreateSampler(*device,
+                              &info,
+                              NULL,
+                              &cached->sampler),
+              "Texture sampler creationg");
+
+        return cached->sampler;
+    }
+
+    void release(const VkSampler &sampler) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(uint32_t i = 0; i < sampler_count; i++) {
+            if (samplers[i].sampler != sampler) {
+                continue;
+            }
+
+            if (--samplers[i].ref_count == 0) {
+                vkDestroySampler(*device, samplers[i].sampler, NULL);
+                // Swap with the last one
+                samplers[i] = samplers[--sampler_count];
+            }
+            return;
+        }
+
+        assert_msg(false, "Releasing a sampler not owned by the cache");
+    }
+
+    void cleanup() {
+        for(uint32_t i = 0; i < sampler_count; i++) {
+            vkDestroySampler(*device, samplers[i].sampler, NULL);
+        }
+        sampler_count = 0;
+    }
+};
@@ -0,0 +1,98 @@
+#include "simulation.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+
+double sSimulation::get_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void sSimulation::start() {
+    state = {
+        .quad_rotation = 0.0f
+    };
+    tick = 0;
+
+    // So the render thread has a valid snapshot from the first frame
+    sSimulationSnapshot &snapshot = snapshots.get_back();
+    snapshot = {
+        .previous = state,
+        .current = state,
+        .tick_time = get_time(),
+        .tick = tick
+    };
+    snapshots.publish();
+
+    is_running.store(true);
+    thread = std::thread([this]() { _loop(); });
+}
+
+void sSimulation::stop() {
+    is_running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void sSimulation::_step(sSceneState *scene,
+                        const double delta_time) const {
+    // 90 degrees per second
+    scene->quad_rotation += (float) (delta_time * M_PI * 0.5);
+}
+
+void sSimulation::_loop() {
+    double next_tick_time = get_time() + SIMULATION_TICK_TIME;
+
+    while(is_running.load(std::memory_order_relaxed)) {
+        const double now = get_time();
+        if (now < next_tick_time) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(next_tick_time - now));
+            continue;
+        }
+
+        // Behind by too much (a debugger, a suspended laptop), drop the time instead of a burst
+        if (now - next_tick_time > SIMULATION_MAX_CATCH_UP_TICKS * SIMULATION_TICK_TIME) {
+            next_tick_time = now;
+        }
+
+        const sSceneState previous = state;
+        _step(&state,
+              SIMULATION_TICK_TIME);
+        tick++;
+
+        // Wrapped on both, so the interpolation never crosses the wrap
+        sSceneState wrapped_previous = previous;
+        if (previous.quad_rotation > 2.0f * (float) M_PI) {
+            wrapped_previous.quad_rotation -= 2.0f * (float) M_PI;
+            state.quad_rotation -= 2.0f * (float) M_PI;
+        }
+
+        sSimulationSnapshot &snapshot = snapshots.get_back();
+        snapshot = {
+            .previous = wrapped_previous,
+            .current = state,
+            .tick_time = next_tick_time,
+            .tick = tick
+        };
+        snapshots.publish();
+
+        next_tick_time += SIMULATION_TICK_TIME;
+    }
+}
+
+sSceneState sSimulation::get_interpolated(const double time) {
+    const sSimulationSnapshot &snapshot = snapshots.consume();
+
+    // A tick behind: previous at tick_time, current one tick after it
+    double alpha = (time - snapshot.tick_time) / SIMULATION_TICK_TIME;
+    alpha = (alpha < 0.0) ? 0.0 : ((alpha > 1.0) ? 1.0 : alpha);
+
+    const float t = (float) alpha;
+    return {
+        .quad_rotation = snapshot.previous.quad_rotation + (snapshot.current.quad_rotation - snapshot.previous.quad_rotation) * t
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#include "triple_buffer.h"
+
+// Fixed timestep of the simulation, independent of the frame rate
+#define SIMULATION_TICK_RATE 120
+#define SIMULATION_TICK_TIME (1.0 / SIMULATION_TICK_RATE)
+// After a stall, the ticks that are caught up before skipping the rest
+#define SIMULATION_MAX_CATCH_UP_TICKS 8
+
+// Everything the render thread needs from the simulation, copied by value
+struct sSceneState {
+    float quad_rotation; // Radians around Z
+};
+
+// The last two ticks, so the render thread can interpolate in between
+struct sSimulationSnapshot {
+    sSceneState previous;
+    sSceneState current;
+    double      tick_time; // When current was simulated, on the steady clock
+    uint64_t    tick;
+};
+
+// Runs the scene update on its own thread, at a fixed timestep, and publishes each
+// tick through a triple buffer. The render thread takes the latest snapshot without
+// waiting, and renders a tick behind, interpolated, so an expensive update does not
+// lengthen the frame, and a frame rate that is not a multiple of the tick rate does not stutter
+struct sSimulation {
+    sTripleBuffer<sSimulationSnapshot> snapshots;
+    sSceneState                        state;
+    uint64_t                           tick = 0;
+
+    std::thread                        thread;
+    std::atomic<bool>                  is_running = {false};
+
+    void start();
+    void stop();
+
+    // Render thread, the scene at the given time of the steady clock
+    sSceneState get_interpolated(const double time);
+
+    static double get_time();
+
+    void _step(sSceneState *scene,
+               const double delta_time) const;
+    void _loop();
+};
@@ -0,0 +1,103 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#include "sprite_batcher.h"
+
+void sApp::_create_sprite_batcher() {
+    sprite_batcher.device = &Vulkan.device;
+
+    // ===================================
+    // PER-FRAME VERTEX BUFFERS ==========
+    // ===================================
+    {
+        VkDeviceSize buffer_size = SPRITE_VERTICES_SIZE * SPRITE_BATCHER_MAX_SPRITES;
+
+        sprite_batcher.frame_count = Vulkan.frame_count;
+        sprite_batcher.vertex_buffers = (VkBuffer*) malloc(sizeof(VkBuffer) * Vulkan.frame_count);
+        sprite_batcher.vertex_buffers_memory = (VkDeviceMemory*) malloc(sizeof(VkDeviceMemory) * Vulkan.frame_count);
+        sprite_batcher.vertex_buffers_mapped = (void**) malloc(sizeof(void*) * Vulkan.frame_count);
+
+        for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
+            create_buffer(buffer_size,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          &sprite_batcher.vertex_buffers[i],
+                          &sprite_batcher.vertex_buffers_memory[i]);
+
+            // Mapped for the whole lifetime of the app, the sprites are written directly here
+            VK_OK(vkMapMemory(Vulkan.device,
+                              sprite_batcher.vertex_buffers_memory[i],
+                              0,
+                              buffer_size,
+                              0,
+                              &sprite_batcher.vertex_buffers_mapped[i]),
+                  "Mapping sprite vertex buffer");
+        }
+    }
+
+    // ===================================
+    // SHARED QUAD INDEX BUFFER ==========
+    // ===================================
+    {
+        const uint32_t index_count = SPRITE_BATCHER_QUADS_PER_CHUNK * 6;
+        VkDeviceSize buffer_size = sizeof(uint16_t) * index_count;
+
+        VkBuffer staging_buffer;
+        VkDeviceMemory staging_buffer_memory;
+
+        create_buffer(buffer_size,
+                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      &staging_buffer,
+                      &staging_buffer_memory);
+
+        uint16_t *indices;
+        VK_OK(vkMapMemory(Vulkan.device,
+                          staging_buffer_memory,
+                          0,
+                          buffer_size,
+                          0,
+                          (void**) &indices),
+              "Mapping memory");
+
+        // Same index order than Geometry::Meshes::Quad, for every quad
+        for(uint32_t quad = 0; quad < SPRITE_BATCHER_QUADS_PER_CHUNK; quad++) {
+            const uint16_t base = (uint16_t) (quad * 4);
+            uint16_t *quad_indices = &indices[quad * 6];
+            quad_indices[0] = base + 0;
+            quad_indices[1] = base + 1;
+            quad_indices[2] = base + 2;
+            quad_indices[3] = base + 2;
+            quad_indices[4] = base + 3;
+            quad_indices[5] = base + 0;
+        }
+
+        vkUnmapMemory(Vulkan.device,
+                      staging_buffer_memory);
+
+        create_buffer(buffer_size,
+                      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                      &sprite_batcher.index_buffer,
+                      &sprite_batcher.index_buffer_memory);
+
+        copy_buffer(staging_buffer,
+                    sprite_batcher.index_buffer,
+                    buffer_size);
+
+        vkDestroyBuffer(Vulkan.device,
+                        staging_buffer,
+                        NULL);
+        vkFreeMemory(Vulkan.device,
+                     staging_buffer_memory,
+                     NULL);
+    }
+
+    sprite_batcher.batches = (sSpriteBatch*) malloc(sizeof(sSpriteBatch) * SPRITE_BATCHER_MAX_BATCHES);
+    sprite_batcher.begin_frame(0);
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPRITE_BATCHER_SIMD 1
+#endif
+
+#include "utils.h"
+#include "mesh.h"
+
+// Max amount of sprites that can be written on a single frame
+#define SPRITE_BATCHER_MAX_SPRITES (1 << 20)
+// Max amount of texture/pipeline changes on a single frame
+#define SPRITE_BATCHER_MAX_BATCHES 4096
+// The quad index buffer is 16 bits, so a single draw can only address 65536 vertices
+// (16384 quads); bigger batches are split on chunks via the vertexOffset of the draw
+#define SPRITE_BATCHER_QUADS_PER_CHUNK 16384
+
+#define SPRITE_VERTICES_SIZE (sizeof(Geometry::sVertex2D) * 4)
+
+// Every sprite is 4 vertices of 7 floats: 112 bytes or 7 SSE registers.
+// Since the mapped memory is aligned, each sprite starts on a 16 byte boundary
+static_assert(sizeof(Geometry::sVertex2D) == 7 * sizeof(float), "Unexpected padding on sVertex2D");
+static_assert(SPRITE_VERTICES_SIZE % 16 == 0, "Sprites need to be 16 byte aligned");
+
+struct sSpriteBatch {
+    VkPipeline      pipeline;
+    VkDescriptorSet descriptor_set; // VK_NULL_HANDLE on bindless batches
+    uint32_t        texture_index; // Bindless slot, pushed as a constant
+    uint32_t        first_sprite;
+    uint32_t        sprite_count;
+};
+
+struct sSpriteBatcher {
+    // Per frame, persistently mapped, vertex buffers
+    VkBuffer       *vertex_buffers = NULL;
+    VkDeviceMemory *vertex_buffers_memory = NULL;
+    void*          *vertex_buffers_mapped = NULL;
+    uint32_t       frame_count = 0;
+
+    // Shared, precomputed, quad index buffer
+    VkBuffer       index_buffer;
+    VkDeviceMemory index_buffer_memory;
+
+    sSpriteBatch   *batches = NULL;
+    uint32_t       batch_count = 0;
+
+    // Current frame's write state
+    uint32_t       frame_index = 0;
+    float          *write_ptr = NULL;
+    uint32_t       sprite_count = 0;
+    uint32_t       dropped_sprite_count = 0;
+
+    VkDevice       *device = NULL;
+
+    void begin_frame(const uint32_t current_frame) {
+        frame_index = current_frame;
+        write_ptr = (float*) vertex_buffers_mapped[current_frame];
+        sprite_count = 0;
+        batch_count = 0;
+        dropped_sprite_count = 0;
+    }
+
+    // Start a new batch only when the texture or the pipeline changes
+    inline bool _set_batch_state(const VkPipeline &pipeline,
+                                 const VkDescriptorSet &texture_set,
+                                 const uint32_t texture_index) {
+        if (batch_count > 0) {
+            sSpriteBatch &last = batches[batch_count - 1];
+            if (last.pipeline == pipeline && last.descriptor_set == texture_set && last.texture_index == texture_index) {
+                return true;
+            }
+        }
+
+        if (batch_count >= SPRITE_BATCHER_MAX_BATCHES) {
+            return false;
+        }
+
+        batches[batch_count++] = {
+            .pipeline = pipeline,
+            .descriptor_set = texture_set,
+            .texture_index = texture_index,
+            .first_sprite = sprite_count,
+            .sprite_count = 0
+        };
+        return true;
+    }
+
+    inline void draw_sprite(const VkPipeline &pipeline,
+                            const VkDescriptorSet &texture_set,
+                            const glm::vec2 &position,
+                            const glm::vec2 &size,
+                            const glm::vec4 &uv_rect, // min uv (x, y), max uv (z, w)
+                            const glm::vec3 &color) {
+        _draw_sprite(pipeline, texture_set, 0, position, size, uv_rect, color);
+    }
+
+    // Bindless: the texture changes are a push constant, not a set bind
+    inline void draw_sprite(const VkPipeline &pipeline,
+                            const uint32_t texture_index,
+                            const glm::vec2 &position,
+                            const glm::vec2 &size,
+                            const glm::vec4 &uv_rect,
+                            const glm::vec3 &color) {
+        _draw_sprite(pipeline, VK_NULL_HANDLE, texture_index, position, size, uv_rect, color);
+    }
+
+    // Writes the 4 vertices of the sprite directly on the mapped memory
+    inline void _draw_sprite(const VkPipeline &pipeline,
+                             const VkDescriptorSet &texture_set,
+                             const uint32_t texture_index,
+                             const glm::vec2 &position,
+                             const glm::vec2 &size,
+                             const glm::vec4 &uv_rect,
+                             const glm::vec3 &color) {
+        if (sprite_count >= SPRITE_BATCHER_MAX_SPRITES || !_set_batch_state(pipeline, texture_set, texture_index)) {
+            dropped_sprite_count++;
+            return;
+        }
+
+        const float x0 = position.x, y0 = position.y;
+        const float x1 = position.x + size.x, y1 = position.y + size.y;
+        const float u0 = uv_rect.x, v0 = uv_rect.y;
+        const float u1 = uv_rect.z, v1 = uv_rect.w;
+        const float r = color.r, g = color.g, b = color.b;
+
+        // Same corner order (and winding) than Geometry::Meshes::Quad
+#ifdef SPRITE_BATCHER_SIMD
+        // Non-temporal stores: the memory is only written by the CPU, never read back
+        _mm_stream_ps(write_ptr +  0, _mm_setr_ps(x0, y0, r,  g));
+        _mm_stream_ps(write_ptr +  4, _mm_setr_ps(b,  u0, v0, x1));
+        _mm_stream_ps(write_ptr +  8, _mm_setr_ps(y0, r,  g,  b));
+        _mm_stream_ps(write_ptr + 12, _mm_setr_ps(u1, v0, x1, y1));
+        _mm_stream_ps(write_ptr + 16, _mm_setr_ps(r,  g,  b,  u1));
+        _mm_stream_ps(write_ptr + 20, _mm_setr_ps(v1, x0, y1, r));
+        _mm_stream_ps(write_ptr + 24, _mm_setr_ps(g,  b,  u0, v1));
+#else
+        const float vertices[28] = {
+            x0, y0, r, g, b, u0, v0,
+            x1, y0, r, g, b, u1, v0,
+            x1, y1, r, g, b, u1, v1,
+            x0, y1, r, g, b, u0, v1
+        };
+        memcpy(write_ptr, vertices, sizeof(vertices));
+#endif
+        write_ptr += 28;
+
+        batches[batch_count - 1].sprite_count++;
+        sprite_count++;
+    }
+
+    // Makes the streamed writes visible before the submit
+    void end_frame() {
+#ifdef SPRITE_BATCHER_SIMD
+        _mm_sfence();
+#endif
+    }
+
+    // Record one indexed draw per batch (per chunk of 16384 quads)
+    // The bindless batches expect the bindless set to be already bound
+    void flush(const VkCommandBuffer &command_buffer,
+               const VkPipelineLayout &pipeline_layout) {
+        if (batch_count == 0) {
+            return;
+        }
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(command_buffer,
+                               0,
+                               1,
+                               &vertex_buffers[frame_index],
+                               &offset);
+        vkCmdBindIndexBuffer(command_buffer,
+                             index_buffer,
+                             0,
+                             VK_INDEX_TYPE_UINT16);
+
+        VkPipeline bound_pipeline = VK_NULL_HANDLE;
+        VkDescriptorSet bound_set = VK_NULL_HANDLE;
+        uint32_t pushed_index = UINT32_MAX;
+        for(uint32_t i = 0; i < batch_count; i++) {
+            const sSpriteBatch &batch = batches[i];
+
+            if (batch.pipeline != bound_pipeline) {
+                vkCmdBindPipeline(command_buffer,
+                                  VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  batch.pipeline);
+                bound_pipeline = batch.pipeline;
+            }
+
+            if (batch.descriptor_set == VK_NULL_HANDLE) {
+                if (batch.texture_index != pushed_index) {
+                    vkCmdPushConstants(command_buffer,
+                                       pipeline_layout,
+                                       VK_SHADER_STAGE_FRAGMENT_BIT,
+                                       0,
+                                       sizeof(uint32_t),
+                                       &batch.texture_index);
+                    pushed_index = batch.texture_index;
+                }
+            } else if (batch.descriptor_set != bound_set) {
+                vkCmdBindDescriptorSets(command_buffer,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        pipeline_layout,
+                                        0,
+                                        1,
+                                        &batch.descriptor_set,
+                                        0,
+                                        NULL);
+                bound_set = batch.descriptor_set;
+            }
+
+            for(uint32_t drawn = 0; drawn < batch.sprite_count; drawn += SPRITE_BATCHER_QUADS_PER_CHUNK) {
+                uint32_t chunk_count = batch.sprite_count - drawn;
+                if (chunk_count > SPRITE_BATCHER_QUADS_PER_CHUNK) {
+                    chunk_count = SPRITE_BATCHER_QUADS_PER_CHUNK;
+                }
+
+                vkCmdDrawIndexed(command_buffer,
+                                 chunk_count * 6,
+                                 1,
+                                 0,
+                                 (int32_t) ((batch.first_sprite + drawn) * 4), // vertex offset
+                                 0);
+            }
+        }
+    }
+
+    void cleanup() {
+        for(uint32_t i = 0; i < frame_count; i++) {
+            vkUnmapMemory(*device, vertex_buffers_memory[i]);
+            vkDestroyBuffer(*device, vertex_buffers[i], NULL);
+            vkFreeMemory(*device, vertex_buffers_memory[i], NULL);
+        }
+        free(vertex_buffers);
+        free(vertex_buffers_memory);
+        free(vertex_buffers_mapped);
+
+        vkDestroyBuffer(*device, index_buffer, NULL);
+        vkFreeMemory(*device, index_buffer_memory, NULL);
+
+        free(batches);
+    }
+};
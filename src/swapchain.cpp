@@ -0,0 +1,154 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+// See app.cpp
+VkExtent2D choose_swapchain_extent(const VkSurfaceCapabilitiesKHR &capabilities,
+                                   GLFWwindow *window);
+
+void sApp::_create_swapchain(const VkSwapchainKHR &old_swapchain) {
+    // ===================================
+    // CREATE SWAPCHAIN ==================
+    // ===================================
+    {
+        // The extent (and the transform) change with the window
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Vulkan.physical_device,
+                                                  Vulkan.surface,
+                                                  &Vulkan.swapchain_info.capabilites);
+
+        // One more, in order to avoid waiting for the driver in order to adquire the image.
+        // And one per frame in flight, or the deeper pipelines stall on the acquire anyway
+        uint32_t image_count = Vulkan.swapchain_info.capabilites.minImageCount + 1;
+        image_count = (image_count < Vulkan.frame_count) ? Vulkan.frame_count : image_count;
+
+        // Check if we dont go over the max amount of images of the device
+        if (Vulkan.swapchain_info.capabilites.maxImageCount > 0 && 
+            image_count > Vulkan.swapchain_info.capabilites.maxImageCount) {
+            image_count = Vulkan.swapchain_info.capabilites.maxImageCount;
+        }
+
+        uint32_t queue_familiy_indices[2] = { 
+            Vulkan.queues.graphics_family_id, 
+            Vulkan.queues.presenting_family_id 
+        };
+
+        bool use_concurrent_mode = Vulkan.queues.graphics_family_id != Vulkan.queues.presenting_family_id;
+
+        Vulkan.swapchain_info.swapchain_extent = choose_swapchain_extent(Vulkan.swapchain_info.capabilites,
+                                                                         window);
+
+        VkSwapchainCreateInfoKHR create_info = {
+            .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+            .pNext = NULL,
+            .surface = Vulkan.surface,
+            .minImageCount = image_count,
+            .imageFormat = Vulkan.swapchain_info.selected_format.format,
+            .imageColorSpace = Vulkan.swapchain_info.selected_format.colorSpace,
+            .imageExtent = Vulkan.swapchain_info.swapchain_extent, // size of the swapchain iamges
+            .imageArrayLayers = 1, 
+            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            .imageSharingMode = (use_concurrent_mode) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE, // share images between queues families
+            .queueFamilyIndexCount = (uint32_t) ((use_concurrent_mode) ? 2 : 0),
+            .pQueueFamilyIndices = (use_concurrent_mode) ? queue_familiy_indices : NULL,
+            .preTransform = Vulkan.swapchain_info.capabilites.currentTransform, // Apply a transformation to the swapchian if wanted to
+            .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR, // use alpha channel for blending
+            .presentMode = Vulkan.swapchain_info.selected_present_mode,
+            .clipped = VK_TRUE, // remove ocluded, on screen pixels (if a window overlaps for example),
+            .oldSwapchain = old_swapchain // On a resize, so the images can be handed over without a stall
+        };
+
+        VK_OK(vkCreateSwapchainKHR(Vulkan.device, 
+                                   &create_info, 
+                                   NULL, 
+                                   &Vulkan.swapchain), 
+              "Swapchain creation");
+    }
+
+    // ===================================
+    // GET IMAGES FROM SWAPCHAIN =========
+    // ===================================
+    {
+        vkGetSwapchainImagesKHR(Vulkan.device, 
+                                Vulkan.swapchain, 
+                                &Vulkan.swapchain_images_count, 
+                                NULL);
+
+        Vulkan.swapchain_images = (VkImage*) malloc(sizeof(VkImage) * Vulkan.swapchain_images_count);
+
+        vkGetSwapchainImagesKHR(Vulkan.device, 
+                                Vulkan.swapchain, 
+                                &Vulkan.swapchain_images_count, 
+                                Vulkan.swapchain_images);
+    }
+
+
+    // ===================================
+    // CREATE IMAGE VIEWS ================
+    // ===================================
+    {
+        Vulkan.swapchain_image_views = (VkImageView*) malloc(sizeof(VkImageView) * Vulkan.swapchain_images_count);
+
+        for(uint32_t i = 0; i < Vulkan.swapchain_images_count; i++) {
+            VkImageViewCreateInfo create_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = NULL,
+                .image = Vulkan.swapchain_images[i],
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = Vulkan.swapchain_info.selected_format.format,
+                .components = { // Alter the was the RGBA channels are stored. Leave it as it comes
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY
+                },
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, // Wich aspect of the iamge are used, in this case just the color
+                    .baseMipLevel = 0,
+                    .levelCount = 1, // No need for mipmaping (for now) on the swapchain
+                    .baseArrayLayer = 0, // multiplelayers could be usefull for multiple perspectives rendered at the same time
+                    .layerCount = 1
+                }
+            };
+
+            VK_OK(vkCreateImageView(Vulkan.device, 
+                                    &create_info, 
+                                    NULL, 
+                                    &Vulkan.swapchain_image_views[i]),
+                 "Error creating image views of swapchain");
+        }
+    }
+}
+
+void sApp::_recreate_swapchain() {
+    // Minimized: nothing to present to, until the window has a size again
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window,
+                           &width,
+                           &height);
+    Vulkan.is_swapchain_stale = width == 0 || height == 0;
+    if (Vulkan.is_swapchain_stale) {
+        return;
+    }
+    Vulkan.is_framebuffer_resized = false;
+
+    // The frames in flight still use the old images & framebuffers, so they
+    // are destroyed once the GPU is past the last submitted frame
+    for(uint32_t i = 0; i < Vulkan.swapchain_images_count; i++) {
+        Vulkan.deletion_queue.push(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t) Vulkan.framebuffers[i]);
+        Vulkan.deletion_queue.push(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t) Vulkan.swapchain_image_views[i]);
+    }
+    Vulkan.deletion_queue.push(VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t) Vulkan.swapchain);
+    free(Vulkan.framebuffers);
+    free(Vulkan.swapchain_image_views);
+    free(Vulkan.swapchain_images);
+
+    // Only what depends on the extent. The render pass & the pipelines keep the
+    // format, and the viewport & scissor are dynamic
+    const VkSwapchainKHR old_swapchain = Vulkan.swapchain;
+    _create_swapchain(old_swapchain);
+    _create_framebuffers();
+}
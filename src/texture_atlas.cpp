@@ -0,0 +1,323 @@
+#include "texture_atlas.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vulkan/vulkan_core.h>
+
+#include "app.h"
+#include "utils.h"
+
+bool sAtlasBuilder::pack() {
+    // Taller images first, the skyline stays flatter
+    uint32_t *order = (uint32_t*) malloc(sizeof(uint32_t) * image_count);
+    for(uint32_t i = 0; i < image_count; i++) {
+        order[i] = i;
+    }
+    std::sort(order, order + image_count, [this](const uint32_t a, const uint32_t b) {
+        return images[a].height > images[b].height;
+    });
+
+    sSkylinePacker packers[TEXTURE_ATLAS_MAX_LAYERS];
+    layer_count = 0;
+    bool has_fit = true;
+
+    for(uint32_t i = 0; i < image_count && has_fit; i++) {
+        const sAtlasImage &image = images[order[i]];
+        const uint32_t padded_width = image.width + 2 * TEXTURE_ATLAS_PADDING;
+        const uint32_t padded_height = image.height + 2 * TEXTURE_ATLAS_PADDING;
+
+        // First layer with space, or a new one
+        uint32_t layer = 0, x, y;
+        for(; layer < layer_count; layer++) {
+            if (packers[layer].insert(padded_width, padded_height, &x, &y)) {
+                break;
+            }
+        }
+        if (layer == layer_count) {
+            if (layer_count == max_layers) {
+                has_fit = false;
+                break;
+            }
+            packers[layer_count++].init(layer_size, layer_size);
+            if (!packers[layer].insert(padded_width, padded_height, &x, &y)) {
+                has_fit = false;
+                break;
+            }
+        }
+
+        const float inv_size = 1.0f / (float) layer_size;
+        sAtlasRegion &region = regions[order[i]];
+        region.layer = layer;
+        region.x = x + TEXTURE_ATLAS_PADDING;
+        region.y = y + TEXTURE_ATLAS_PADDING;
+        region.width = image.width;
+        region.height = image.height;
+        region.uv_rect = glm::vec4(region.x * inv_size,
+                                   region.y * inv_size,
+                                   (region.x + region.width) * inv_size,
+                                   (region.y + region.height) * inv_size);
+    }
+
+    for(uint32_t i = 0; i < layer_count; i++) {
+        packers[i].clean();
+    }
+    free(order);
+
+    return has_fit;
+}
+
+void sApp::create_texture_atlas(const sAtlasBuilder &builder,
+                                sTextureAtlas *atlas) {
+    const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+
+    // Each level halves the padding, stop before the neighbours bleed in
+    uint32_t mip_levels = 1;
+    for(uint32_t padding = TEXTURE_ATLAS_PADDING; padding > 1; padding /= 2) {
+        mip_levels++;
+    }
+    if (!supports_linear_blit(format)) {
+        mip_levels = 1;
+    }
+
+    atlas->layer_count = builder.layer_count;
+    atlas->layer_size = builder.layer_size;
+    atlas->mip_levels = mip_levels;
+    atlas->device = &Vulkan.device;
+
+    // No images, no pages: a 0 sized staging buffer and a 0 layer image are invalid
+    if (builder.image_count == 0) {
+        atlas->layer_count = 0;
+        return;
+    }
+
+    // The padded images, one after the other on the staging buffer
+    VkDeviceSize *staging_offsets = (VkDeviceSize*) malloc(sizeof(VkDeviceSize) * builder.image_count);
+    VkDeviceSize staging_size = 0;
+    for(uint32_t i = 0; i < builder.image_count; i++) {
+        staging_offsets[i] = staging_size;
+        const VkDeviceSize padded_size = (VkDeviceSize) (builder.images[i].width + 2 * TEXTURE_ATLAS_PADDING) *
+                                                        (builder.images[i].height + 2 * TEXTURE_ATLAS_PADDING) * 4;
+        staging_size += (padded_size + 15) & ~((VkDeviceSize) 15);
+    }
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    create_buffer(staging_size,
+                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                  &staging_buffer,
+                  &staging_memory);
+
+    uint8_t *staging_address;
+    VK_OK(vkMapMemory(Vulkan.device,
+                      staging_memory,
+                      0,
+                      staging_size,
+                      0,
+                      (void**) &staging_address),
+          "Mapping atlas staging memory");
+
+    // Copy with the edges extended on the padding, so filtering and mips do not pick the neighbours
+    for(uint32_t i = 0; i < builder.image_count; i++) {
+        const sAtlasImage &image = builder.images[i];
+        const uint32_t padded_width = image.width + 2 * TEXTURE_ATLAS_PADDING;
+        const uint32_t padded_height = image.height + 2 * TEXTURE_ATLAS_PADDING;
+        uint32_t *dst = (uint32_t*) (staging_address + staging_offsets[i]);
+        const uint32_t *src = (const uint32_t*) image.pixels;
+
+        for(uint32_t y = 0; y < padded_height; y++) {
+            int32_t src_y = (int32_t) y - TEXTURE_ATLAS_PADDING;
+            src_y = (src_y < 0) ? 0 : ((src_y >= (int32_t) image.height) ? (int32_t) image.height - 1 : src_y);
+            const uint32_t *src_row = src + src_y * image.width;
+            uint32_t *dst_row = dst + y * padded_width;
+
+            for(uint32_t x = 0; x < TEXTURE_ATLAS_PADDING; x++) {
+                dst_row[x] = src_row[0];
+                dst_row[padded_width - 1 - x] = src_row[image.width - 1];
+            }
+            memcpy(dst_row + TEXTURE_ATLAS_PADDING,
+                   src_row,
+                   sizeof(uint32_t) * image.width);
+        }
+    }
+
+    vkUnmapMemory(Vulkan.device,
+                  staging_memory);
+
+    _create_texture_image(builder.layer_size,
+                          builder.layer_size,
+                          mip_levels,
+                          format,
+                          VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          0,
+                          &atlas->image,
+                          &atlas->memory,
+                          builder.layer_count);
+
+    {
+        VkCommandBuffer command_buffer = being_single_time_commands();
+
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = atlas->image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = mip_levels,
+                .baseArrayLayer = 0,
+                .layerCount = builder.layer_count
+            }
+        };
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        // The unused space is transparent
+        VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+        VkImageSubresourceRange clear_range = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = builder.layer_count
+        };
+        vkCmdClearColorImage(command_buffer,
+                             atlas->image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             &clear_color,
+                             1,
+                             &clear_range);
+
+        // The copies overwrite the clear
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.subresourceRange.levelCount = 1;
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        VkBufferImageCopy *regions = (VkBufferImageCopy*) malloc(sizeof(VkBufferImageCopy) * builder.image_count);
+        for(uint32_t i = 0; i < builder.image_count; i++) {
+            const sAtlasRegion &region = builder.regions[i];
+            regions[i] = {
+                .bufferOffset = staging_offsets[i],
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = region.layer,
+                    .layerCount = 1
+                },
+                .imageOffset = {
+                    .x = (int32_t) (region.x - TEXTURE_ATLAS_PADDING),
+                    .y = (int32_t) (region.y - TEXTURE_ATLAS_PADDING),
+                    .z = 0
+                },
+                .imageExtent = {
+                    .width = region.width + 2 * TEXTURE_ATLAS_PADDING,
+                    .height = region.height + 2 * TEXTURE_ATLAS_PADDING,
+                    .depth = 1
+                }
+            };
+        }
+        vkCmdCopyBufferToImage(command_buffer,
+                               staging_buffer,
+                               atlas->image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               builder.image_count,
+                               regions);
+        free(regions);
+
+        record_blit_mip_chain(command_buffer,
+                              atlas->image,
+                              builder.layer_size,
+                              builder.layer_size,
+                              mip_levels,
+                              builder.layer_count);
+
+        end_single_time_commands(command_buffer);
+    }
+
+    vkDestroyBuffer(Vulkan.device, staging_buffer, NULL);
+    vkFreeMemory(Vulkan.device, staging_memory, NULL);
+    free(staging_offsets);
+
+    // Views: the whole array, and a 2D view per page
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = NULL,
+        .image = atlas->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = format,
+        .components = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = mip_levels,
+            .baseArrayLayer = 0,
+            .layerCount = builder.layer_count
+        }
+    };
+    VK_OK(vkCreateImageView(Vulkan.device,
+                            &view_info,
+                            NULL,
+                            &atlas->array_view),
+          "Create atlas array view");
+
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.subresourceRange.layerCount = 1;
+    for(uint32_t i = 0; i < builder.layer_count; i++) {
+        view_info.subresourceRange.baseArrayLayer = i;
+        VK_OK(vkCreateImageView(Vulkan.device,
+                                &view_info,
+                                NULL,
+                                &atlas->layer_views[i]),
+              "Create atlas layer view");
+    }
+
+    // Clamp, so the UVs at the region borders do not wrap to the other side of the page
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = NULL,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+    atlas->sampler_cache = &sampler_cache;
+    atlas->sampler = sampler_cache.acquire(sampler_create_info);
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "utils.h"
+#include "mesh.h"
+#include "sampler_cache.h"
+
+#define TEXTURE_ATLAS_MAX_LAYERS 16
+#define TEXTURE_ATLAS_MAX_IMAGES 4096
+// Border around each image, filled by extending its edges. It also
+// bounds the mip count, since each level halves it
+#define TEXTURE_ATLAS_PADDING    4
+// Of add_image, for what does not fit on a page or past TEXTURE_ATLAS_MAX_IMAGES
+#define TEXTURE_ATLAS_INVALID_IMAGE UINT32_MAX
+
+// Skyline bottom-left packer: the free space is the area above a
+// polyline of horizontal segments, sorted by x
+struct sSkylineNode {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+};
+
+struct sSkylinePacker {
+    sSkylineNode *nodes = NULL;
+    uint32_t     node_count = 0;
+    uint32_t     width = 0;
+    uint32_t     height = 0;
+
+    void init(const uint32_t packer_width,
+              const uint32_t packer_height) {
+        width = packer_width;
+        height = packer_height;
+        // Each node is at least one pixel wide
+        nodes = (sSkylineNode*) malloc(sizeof(sSkylineNode) * (width + 1));
+        nodes[0] = { .x = 0, .y = 0, .width = width };
+        node_count = 1;
+    }
+
+    // Height at which a rect placed on the node would rest, false if it does not fit
+    bool _fit(const uint32_t index,
+              const uint32_t rect_width,
+              const uint32_t rect_height,
+              uint32_t *y) const {
+        if (nodes[index].x + rect_width > width) {
+            return false;
+        }
+
+        uint32_t top = 0;
+        int32_t width_left = (int32_t) rect_width;
+        for(uint32_t i = index; width_left > 0; i++) {
+            top = (nodes[i].y > top) ? nodes[i].y : top;
+            if (top + rect_height > height) {
+                return false;
+            }
+            width_left -= (int32_t) nodes[i].width;
+        }
+
+        *y = top;
+        return true;
+    }
+
+    bool insert(const uint32_t rect_width,
+                const uint32_t rect_height,
+                uint32_t *x,
+                uint32_t *y) {
+        // Lowest top edge, then the narrowest node to waste less
+        uint32_t best_index = UINT32_MAX;
+        uint32_t best_top = UINT32_MAX;
+        uint32_t best_width = UINT32_MAX;
+        uint32_t best_y = 0;
+        for(uint32_t i = 0; i < node_count; i++) {
+            uint32_t node_y;
+            if (!_fit(i, rect_width, rect_height, &node_y)) {
+                continue;
+            }
+            const uint32_t top = node_y + rect_height;
+            if (top < best_top || (top == best_top && nodes[i].width < best_width)) {
+                best_index = i;
+                best_top = top;
+                best_width = nodes[i].width;
+                best_y = node_y;
+            }
+        }
+
+        if (best_index == UINT32_MAX) {
+            return false;
+        }
+
+        *x = nodes[best_index].x;
+        *y = best_y;
+
+        // New segment on top of the rect
+        memmove(&nodes[best_index + 1],
+                &nodes[best_index],
+                sizeof(sSkylineNode) * (node_count - best_index));
+        nodes[best_index] = { .x = *x, .y = best_y + rect_height, .width = rect_width };
+        node_count++;
+
+        // Shrink or remove the segments now under it
+        for(uint32_t i = best_index + 1; i < node_count;) {
+            const uint32_t covered_end = nodes[i - 1].x + nodes[i - 1].width;
+            if (nodes[i].x >= covered_end) {
+                break;
+            }
+
+            const uint32_t shrink = covered_end - nodes[i].x;
+            if (nodes[i].width > shrink) {
+                nodes[i].x += shrink;
+                nodes[i].width -= shrink;
+                break;
+            }
+
+            memmove(&nodes[i],
+                    &nodes[i + 1],
+                    sizeof(sSkylineNode) * (node_count - i - 1));
+            node_count--;
+        }
+
+        // Merge the neighbours at the same height
+        for(uint32_t i = 0; i + 1 < node_count;) {
+            if (nodes[i].y == nodes[i + 1].y) {
+                nodes[i].width += nodes[i + 1].width;
+                memmove(&nodes[i + 1],
+                        &nodes[i + 2],
+                        sizeof(sSkylineNode) * (node_count - i - 2));
+                node_count--;
+            } else {
+                i++;
+            }
+        }
+
+        return true;
+    }
+
+    void clean() {
+        free(nodes);
+        nodes = NULL;
+    }
+};
+
+// Where an image ended up inside the atlas
+struct sAtlasRegion {
+    glm::vec4 uv_rect; // min uv, max uv
+    uint32_t  layer;
+    uint32_t  x, y; // In pixels, without the padding
+    uint32_t  width, height;
+
+    // From the image's own [0, 1] UVs to the atlas ones
+    inline glm::vec2 remap_uv(const glm::vec2 &uv) const {
+        return glm::vec2(uv_rect.x + uv.x * (uv_rect.z - uv_rect.x),
+                         uv_rect.y + uv.y * (uv_rect.w - uv_rect.y));
+    }
+
+    // The layer is chosen by binding its view, see sTextureAtlas::layer_views
+    inline void remap_mesh_uvs(Geometry::sVertex2D *vertices,
+                               const uint32_t vertex_count) const {
+        for(uint32_t i = 0; i < vertex_count; i++) {
+            vertices[i].text_coord = remap_uv(vertices[i].text_coord);
+        }
+    }
+};
+
+struct sAtlasImage {
+    const uint8_t *pixels; // RGBA8, owned by the caller until the atlas is created
+    uint32_t      width;
+    uint32_t      height;
+};
+
+// Collects the images and packs them on the layers, see sApp::create_texture_atlas for the upload
+struct sAtlasBuilder {
+    uint32_t       layer_size = 0;
+    uint32_t       max_layers = 0;
+
+    sAtlasImage    *images = NULL;
+    sAtlasRegion   *regions = NULL; // Same index as the images
+    uint32_t       image_count = 0;
+    uint32_t       layer_count = 0;
+
+    void init(const uint32_t atlas_layer_size,
+              const uint32_t atlas_max_layers) {
+        layer_size = atlas_layer_size;
+        max_layers = (atlas_max_layers < TEXTURE_ATLAS_MAX_LAYERS) ? atlas_max_layers : TEXTURE_ATLAS_MAX_LAYERS;
+        images = (sAtlasImage*) malloc(sizeof(sAtlasImage) * TEXTURE_ATLAS_MAX_IMAGES);
+        regions = (sAtlasRegion*) malloc(sizeof(sAtlasRegion) * TEXTURE_ATLAS_MAX_IMAGES);
+        image_count = 0;
+        layer_count = 0;
+    }
+
+    uint32_t add_image(const uint8_t *pixels,
+                       const uint32_t width,
+                       const uint32_t height) {
+        // Not asserts: the packer could never place them
+        if (image_count >= TEXTURE_ATLAS_MAX_IMAGES) {
+            std::cout << "Too many images on the atlas" << std::endl;
+            return TEXTURE_ATLAS_INVALID_IMAGE;
+        }
+        if (width + 2 * TEXTURE_ATLAS_PADDING > layer_size || height + 2 * TEXTURE_ATLAS_PADDING > layer_size) {
+            std::cout << "Image of " << width << "x" << height << " too big for the atlas pages of " << layer_size << std::endl;
+            return TEXTURE_ATLAS_INVALID_IMAGE;
+        }
+        images[image_count] = { .pixels = pixels, .width = width, .height = height };
+        return image_count++;
+    }
+
+    // Places every image, returns false if they do not fit on max_layers
+    bool pack();
+
+    void clean() {
+        free(images);
+        free(regions);
+    }
+};
+
+struct sTextureAtlas {
+    VkImage        image;
+    VkDeviceMemory memory;
+    VkImageView    array_view; // For sampler2DArray
+    VkImageView    layer_views[TEXTURE_ATLAS_MAX_LAYERS]; // For the sampler2D shaders, one per page
+    VkSampler      sampler; // From the cache. Needs a layout without the default immutable sampler
+
+    uint32_t       layer_count;
+    uint32_t       layer_size;
+    uint32_t       mip_levels;
+
+    VkDevice       *device = NULL;
+    sSamplerCache  *sampler_cache = NULL;
+
+    void cleanup() {
+        // Empty, nothing was created
+        if (layer_count == 0) {
+            return;
+        }
+
+        sampler_cache->release(sampler);
+        for(uint32_t i = 0; i < layer_count; i++) {
+            vkDestroyImageView(*device, layer_views[i], NULL);
+        }
+        vkDestroyImageView(*device, array_view, NULL);
+        vkDestroyImage(*device, image, NULL);
+        vkFreeMemory(*device, memory, NULL);
+    }
+};
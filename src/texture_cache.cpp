@@ -0,0 +1,289 @@
+#include "texture_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "utils.h"
+
+// ===== PLATFORM =====
+
+void* map_file(const char *file_name,
+               size_t *size,
+               const bool is_sequential) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    // The view keeps the mapping alive
+    void *address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (size_t) file_size.QuadPart;
+    return address;
+#else
+    const int file = open(file_name, O_RDONLY);
+    if (file < 0) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(file);
+        return NULL;
+    }
+
+    void *address = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Read once, front to back, by the upload. Or a few pages here & there
+    madvise(address, file_stat.st_size, (is_sequential) ? MADV_SEQUENTIAL : MADV_RANDOM);
+    *size = (size_t) file_stat.st_size;
+    return address;
+#endif
+}
+
+void unmap_file(void *address,
+                const size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(address);
+#else
+    munmap(address, size);
+#endif
+}
+
+static void make_directory(const char *path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+static bool get_file_stats(const char *file_name,
+                           int64_t *mtime,
+                           uint64_t *size) {
+    struct stat file_stat;
+    if (stat(file_name, &file_stat) != 0) {
+        return false;
+    }
+    *mtime = (int64_t) file_stat.st_mtime;
+    *size = (uint64_t) file_stat.st_size;
+    return true;
+}
+
+// ===== KEYS =====
+
+// FNV-1a
+static uint64_t hash_bytes(const uint8_t *bytes,
+                           const size_t size,
+                           uint64_t hash = 14695981039346656037ull) {
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool hash_file_contents(const char *file_name,
+                               uint64_t *hash) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    uint8_t buffer[64 * 1024];
+    *hash = 14695981039346656037ull;
+    size_t read_size;
+    while((read_size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        *hash = hash_bytes(buffer, read_size, *hash);
+    }
+    fclose(file);
+    return true;
+}
+
+// After a touch that kept the contents, so the next loads skip the hash
+static void update_cache_mtime(const char *cache_file_name,
+                               const int64_t source_mtime) {
+    FILE *file = fopen(cache_file_name, "r+b");
+    if (file == NULL) {
+        return;
+    }
+
+    if (fseek(file, (long) offsetof(sTextureCacheHeader, source_mtime), SEEK_SET) != 0 ||
+        fwrite(&source_mtime, sizeof(source_mtime), 1, file) != 1) {
+        std::cout << "Could not update the texture cache " << cache_file_name << std::endl;
+    }
+    fclose(file);
+}
+
+static void get_cache_file_name(const char *source_path,
+                                char *cache_file_name,
+                                const size_t cache_file_name_size) {
+    const uint64_t path_hash = hash_bytes((const uint8_t*) source_path, strlen(source_path));
+    snprintf(cache_file_name,
+             cache_file_name_size,
+             "%s/%016llx.vktc",
+             TEXTURE_CACHE_DIR,
+             (unsigned long long) path_hash);
+}
+
+// ===== CACHE =====
+
+bool load_texture_cache(const char *source_path,
+                        sTextureFile *texture_file) {
+    int64_t source_mtime;
+    uint64_t source_size;
+    if (!get_file_stats(source_path, &source_mtime, &source_size)) {
+        return false;
+    }
+
+    char cache_file_name[512];
+    get_cache_file_name(source_path, cache_file_name, sizeof(cache_file_name));
+
+    size_t mapping_size = 0;
+    uint8_t *mapping = (uint8_t*) map_file(cache_file_name, &mapping_size);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    const sTextureCacheHeader *header = (const sTextureCacheHeader*) mapping;
+    bool is_valid = mapping_size >= sizeof(sTextureCacheHeader) &&
+                    header->magic == TEXTURE_CACHE_MAGIC &&
+                    header->version == TEXTURE_CACHE_VERSION &&
+                    header->source_path_hash == hash_bytes((const uint8_t*) source_path, strlen(source_path)) &&
+                    header->source_size == source_size &&
+                    header->mip_levels > 0 &&
+                    header->mip_levels <= TEXTURE_FILE_MAX_LEVELS;
+
+    // Touched, but maybe with the same contents (a checkout, a copy...)
+    bool is_touched = false;
+    if (is_valid && header->source_mtime != source_mtime) {
+        uint64_t source_hash;
+        is_valid = hash_file_contents(source_path, &source_hash) && source_hash == header->source_hash;
+        is_touched = is_valid;
+    }
+
+    // Each level of the size of its extent, and inside of the mapping (without overflowing)
+    sBlockInfo block;
+    is_valid = is_valid &&
+               header->width > 0 &&
+               header->height > 0 &&
+               get_block_info((VkFormat) header->format, &block);
+    for(uint32_t level = 0; is_valid && level < header->mip_levels; level++) {
+        const uint32_t level_width = (header->width >> level) > 0 ? header->width >> level : 1;
+        const uint32_t level_height = (header->height >> level) > 0 ? header->height >> level : 1;
+        is_valid = header->level_sizes[level] == get_level_size(block, level_width, level_height) &&
+                   header->level_offsets[level] <= mapping_size &&
+                   header->level_sizes[level] <= mapping_size - header->level_offsets[level];
+    }
+
+    if (!is_valid) {
+        unmap_file(mapping, mapping_size);
+        return false;
+    }
+
+    if (is_touched) {
+        update_cache_mtime(cache_file_name,
+                           source_mtime);
+    }
+
+    texture_file->format = (VkFormat) header->format;
+    texture_file->width = header->width;
+    texture_file->height = header->height;
+    texture_file->mip_levels = header->mip_levels;
+    for(uint32_t level = 0; level < header->mip_levels; level++) {
+        texture_file->level_offsets[level] = (size_t) header->level_offsets[level];
+        texture_file->level_sizes[level] = (size_t) header->level_sizes[level];
+    }
+    texture_file->data = mapping;
+    texture_file->data_size = mapping_size;
+    texture_file->is_mapped = true;
+
+    return true;
+}
+
+bool write_texture_cache(const char *source_path,
+                         const sTextureFile &texture_file) {
+    sTextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.source_path_hash = hash_bytes((const uint8_t*) source_path, strlen(source_path));
+    if (!get_file_stats(source_path, &header.source_mtime, &header.source_size) ||
+        !hash_file_contents(source_path, &header.source_hash)) {
+        return false;
+    }
+    header.format = (int32_t) texture_file.format;
+    header.width = texture_file.width;
+    header.height = texture_file.height;
+    header.mip_levels = texture_file.mip_levels;
+
+    // Each level aligned, so they can be copied as is to the staging buffer
+    uint64_t offset = (sizeof(sTextureCacheHeader) + TEXTURE_CACHE_ALIGN - 1) & ~((uint64_t) TEXTURE_CACHE_ALIGN - 1);
+    for(uint32_t level = 0; level < texture_file.mip_levels; level++) {
+        header.level_offsets[level] = offset;
+        header.level_sizes[level] = texture_file.level_sizes[level];
+        offset += (texture_file.level_sizes[level] + TEXTURE_CACHE_ALIGN - 1) & ~((uint64_t) TEXTURE_CACHE_ALIGN - 1);
+    }
+
+    make_directory(TEXTURE_CACHE_DIR);
+
+    char cache_file_name[512];
+    get_cache_file_name(source_path, cache_file_name, sizeof(cache_file_name));
+    char temp_file_name[520];
+    snprintf(temp_file_name, sizeof(temp_file_name), "%s.tmp", cache_file_name);
+
+    FILE *file = fopen(temp_file_name, "wb");
+    if (file == NULL) {
+        std::cout << "Could not write the texture cache " << temp_file_name << std::endl;
+        return false;
+    }
+
+    const uint8_t padding[TEXTURE_CACHE_ALIGN] = {};
+    bool is_written = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    for(uint32_t level = 0; is_written && level < texture_file.mip_levels; level++) {
+        is_written = fwrite(padding, 1, header.level_offsets[level] - written, file) == header.level_offsets[level] - written &&
+                     fwrite(texture_file.data + texture_file.level_offsets[level], 1, texture_file.level_sizes[level], file) == texture_file.level_sizes[level];
+        written = header.level_offsets[level] + header.level_sizes[level];
+    }
+    fclose(file);
+
+    if (!is_written) {
+        remove(temp_file_name);
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename does not replace on windows
+    remove(cache_file_name);
+#endif
+    return rename(temp_file_name, cache_file_name) == 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#include "texture_loader.h"
+
+// Decoded textures, with their mip chain, ready to be copied to the staging buffers.
+// One file per source image, named by the hash of its path
+#define TEXTURE_CACHE_DIR     ".texture_cache"
+#define TEXTURE_CACHE_MAGIC   0x43544B56 // "VKTC"
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_ALIGN   16
+
+struct sTextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    // The source the cache was built from
+    uint64_t source_path_hash;
+    int64_t  source_mtime;
+    uint64_t source_size;
+    uint64_t source_hash; // Of the contents, only checked if the mtime changed
+
+    int32_t  format; // VkFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint64_t level_offsets[TEXTURE_FILE_MAX_LEVELS]; // From the start of the file
+    uint64_t level_sizes[TEXTURE_FILE_MAX_LEVELS];
+};
+
+// Maps the cache file of the source, if it is still up to date. The texture file
+// points inside the mapping, and is unmapped on its clean()
+bool load_texture_cache(const char *source_path,
+                        sTextureFile *texture_file);
+
+// Written to a temporary file and renamed, so a half written cache is never loaded
+bool write_texture_cache(const char *source_path,
+                         const sTextureFile &texture_file);
@@ -0,0 +1,542 @@
+#include "texture_loader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <iostream>
+
+#include "utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TEXTURE_LOADER_SSE 1
+#include <immintrin.h>
+#endif
+
+// The RGB shuffle needs SSSE3, selected at runtime on GCC/Clang
+#if defined(TEXTURE_LOADER_SSE) && defined(__GNUC__)
+#define TEXTURE_LOADER_SSSE3 1
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+bool get_block_info(const VkFormat format,
+                    sBlockInfo *info) {
+    switch(format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            *info = { .width = 1, .height = 1, .size = 4 };
+            return true;
+
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            *info = { .width = 4, .height = 4, .size = 8 };
+            return true;
+
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            *info = { .width = 4, .height = 4, .size = 16 };
+            return true;
+
+        // All the ASTC blocks are 128 bits, only the footprint changes
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+            *info = { .width = 4, .height = 4, .size = 16 };
+            return true;
+        case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+            *info = { .width = 5, .height = 5, .size = 16 };
+            return true;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+            *info = { .width = 6, .height = 6, .size = 16 };
+            return true;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            *info = { .width = 8, .height = 8, .size = 16 };
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+size_t get_level_size(const sBlockInfo &block,
+                      const uint32_t width,
+                      const uint32_t height) {
+    const size_t blocks_x = (width + block.width - 1) / block.width;
+    const size_t blocks_y = (height + block.height - 1) / block.height;
+    return blocks_x * blocks_y * block.size;
+}
+
+static bool read_file(const char *file_name,
+                      sTextureFile *texture_file) {
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    texture_file->data = (uint8_t*) malloc(size);
+    texture_file->data_size = size;
+    const size_t read_size = fread(texture_file->data, 1, size, file);
+    fclose(file);
+
+    if (read_size != (size_t) size) {
+        texture_file->clean();
+        return false;
+    }
+    return true;
+}
+
+// ===== KTX2 =====
+
+struct sKTX2Header {
+    uint8_t  identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+    // Index
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+
+struct sKTX2LevelIndex {
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+bool load_ktx2(const char *file_name,
+               sTextureFile *texture_file) {
+    if (!read_file(file_name, texture_file)) {
+        return false;
+    }
+
+    const sKTX2Header *header = (sKTX2Header*) texture_file->data;
+    if (texture_file->data_size < sizeof(sKTX2Header) ||
+        memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        std::cout << "Not a KTX2 file: " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    // Only plain 2D textures, whose levels can be copied directly
+    sBlockInfo block;
+    if (header->supercompression_scheme != 0 ||
+        header->pixel_depth > 1 ||
+        header->layer_count > 1 ||
+        header->face_count != 1 ||
+        !get_block_info((VkFormat) header->vk_format, &block)) {
+        std::cout << "Unsupported KTX2 layout or format on " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    // A level count of 0 asks for the mips to be generated, which is not possible with blocks
+    const uint32_t level_count = (header->level_count > 0) ? header->level_count : 1;
+    if (level_count > TEXTURE_FILE_MAX_LEVELS) {
+        std::cout << "Too many mip levels on the KTX2 file " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    const sKTX2LevelIndex *levels = (sKTX2LevelIndex*) (texture_file->data + sizeof(sKTX2Header));
+    if (texture_file->data_size < sizeof(sKTX2Header) + sizeof(sKTX2LevelIndex) * level_count) {
+        texture_file->clean();
+        return false;
+    }
+
+    texture_file->format = (VkFormat) header->vk_format;
+    texture_file->width = header->pixel_width;
+    texture_file->height = header->pixel_height;
+    texture_file->mip_levels = level_count;
+
+    for(uint32_t i = 0; i < level_count; i++) {
+        const uint32_t level_width = (header->pixel_width >> i) > 0 ? header->pixel_width >> i : 1;
+        const uint32_t level_height = (header->pixel_height >> i) > 0 ? header->pixel_height >> i : 1;
+
+        if (levels[i].byte_offset + levels[i].byte_length > texture_file->data_size ||
+            levels[i].byte_length != get_level_size(block, level_width, level_height)) {
+            std::cout << "Corrupted KTX2 level " << i << " on " << file_name << std::endl;
+            texture_file->clean();
+            return false;
+        }
+
+        texture_file->level_offsets[i] = levels[i].byte_offset;
+        texture_file->level_sizes[i] = levels[i].byte_length;
+    }
+
+    return true;
+}
+
+// ===== DDS =====
+
+#define DDS_FOURCC(a, b, c, d) ((uint32_t) (a) | ((uint32_t) (b) << 8) | ((uint32_t) (c) << 16) | ((uint32_t) (d) << 24))
+
+struct sDDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t four_cc;
+    uint32_t rgb_bit_count;
+    uint32_t bit_masks[4];
+};
+
+struct sDDSHeader {
+    uint32_t        magic; // "DDS "
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitch_or_linear_size;
+    uint32_t        depth;
+    uint32_t        mip_map_count;
+    uint32_t        reserved_1[11];
+    sDDSPixelFormat pixel_format;
+    uint32_t        caps[4];
+    uint32_t        reserved_2;
+};
+
+struct sDDSHeaderDX10 {
+    uint32_t dxgi_format;
+    uint32_t resource_dimension;
+    uint32_t misc_flag;
+    uint32_t array_size;
+    uint32_t misc_flags_2;
+};
+
+static VkFormat dxgi_to_vk_format(const uint32_t dxgi_format) {
+    switch(dxgi_format) {
+        case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+        case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+bool load_dds(const char *file_name,
+              sTextureFile *texture_file) {
+    if (!read_file(file_name, texture_file)) {
+        return false;
+    }
+
+    const sDDSHeader *header = (sDDSHeader*) texture_file->data;
+    if (texture_file->data_size < sizeof(sDDSHeader) ||
+        header->magic != DDS_FOURCC('D', 'D', 'S', ' ')) {
+        std::cout << "Not a DDS file: " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    size_t data_offset = sizeof(sDDSHeader);
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    switch(header->pixel_format.four_cc) {
+        case DDS_FOURCC('D', 'X', 'T', '1'): format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+        case DDS_FOURCC('D', 'X', 'T', '5'): format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+        case DDS_FOURCC('A', 'T', 'I', '2'):
+        case DDS_FOURCC('B', 'C', '5', 'U'): format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+        case DDS_FOURCC('D', 'X', '1', '0'): {
+            const sDDSHeaderDX10 *dx10_header = (sDDSHeaderDX10*) (texture_file->data + data_offset);
+            if (texture_file->data_size >= data_offset + sizeof(sDDSHeaderDX10) && dx10_header->array_size <= 1) {
+                format = dxgi_to_vk_format(dx10_header->dxgi_format);
+            }
+            data_offset += sizeof(sDDSHeaderDX10);
+            break;
+        }
+        default: break;
+    }
+
+    sBlockInfo block;
+    if (!get_block_info(format, &block)) {
+        std::cout << "Unsupported DDS format on " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    const uint32_t level_count = (header->mip_map_count > 0) ? header->mip_map_count : 1;
+    if (level_count > TEXTURE_FILE_MAX_LEVELS) {
+        std::cout << "Too many mip levels on the DDS file " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    texture_file->format = format;
+    texture_file->width = header->width;
+    texture_file->height = header->height;
+    texture_file->mip_levels = level_count;
+
+    // The levels are tightly packed after the headers
+    for(uint32_t i = 0; i < level_count; i++) {
+        const uint32_t level_width = (header->width >> i) > 0 ? header->width >> i : 1;
+        const uint32_t level_height = (header->height >> i) > 0 ? header->height >> i : 1;
+
+        texture_file->level_offsets[i] = data_offset;
+        texture_file->level_sizes[i] = get_level_size(block, level_width, level_height);
+        data_offset += texture_file->level_sizes[i];
+    }
+
+    if (data_offset > texture_file->data_size) {
+        std::cout << "Truncated DDS file: " << file_name << std::endl;
+        texture_file->clean();
+        return false;
+    }
+
+    return true;
+}
+
+// ===== RGBA EXPANSION =====
+
+#ifdef TEXTURE_LOADER_SSSE3
+static bool has_ssse3() {
+#if defined(__SSSE3__)
+    return true;
+#else
+    static const bool is_supported = __builtin_cpu_supports("ssse3");
+    return is_supported;
+#endif
+}
+
+// 16 pixels per iteration: 48 bytes in, 64 out, each register is shuffled to 4 RGBX texels
+SSSE3_TARGET
+static size_t expand_rgb_ssse3(uint8_t *dst,
+                               const uint8_t *src,
+                               const size_t pixel_count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+
+    size_t i = 0;
+    for(; i + 16 <= pixel_count; i += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*) (src + i * 3));
+        const __m128i b = _mm_loadu_si128((const __m128i*) (src + i * 3 + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*) (src + i * 3 + 32));
+
+        const __m128i rgb0 = a;
+        const __m128i rgb1 = _mm_alignr_epi8(b, a, 12);
+        const __m128i rgb2 = _mm_alignr_epi8(c, b, 8);
+        const __m128i rgb3 = _mm_srli_si128(c, 4);
+
+        _mm_storeu_si128((__m128i*) (dst + i * 4),      _mm_or_si128(_mm_shuffle_epi8(rgb0, shuffle), alpha));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 16), _mm_or_si128(_mm_shuffle_epi8(rgb1, shuffle), alpha));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 32), _mm_or_si128(_mm_shuffle_epi8(rgb2, shuffle), alpha));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 48), _mm_or_si128(_mm_shuffle_epi8(rgb3, shuffle), alpha));
+    }
+    return i;
+}
+#endif
+
+#ifdef TEXTURE_LOADER_SSE
+// Grey to (g, g, g, 255), 16 pixels per iteration with unpacks only
+static size_t expand_grey_sse2(uint8_t *dst,
+                               const uint8_t *src,
+                               const size_t pixel_count) {
+    const __m128i alpha = _mm_set1_epi8((char) 0xFF);
+
+    size_t i = 0;
+    for(; i + 16 <= pixel_count; i += 16) {
+        const __m128i grey = _mm_loadu_si128((const __m128i*) (src + i));
+        const __m128i grey_grey_lo = _mm_unpacklo_epi8(grey, grey);
+        const __m128i grey_grey_hi = _mm_unpackhi_epi8(grey, grey);
+        const __m128i grey_alpha_lo = _mm_unpacklo_epi8(grey, alpha);
+        const __m128i grey_alpha_hi = _mm_unpackhi_epi8(grey, alpha);
+
+        _mm_storeu_si128((__m128i*) (dst + i * 4),      _mm_unpacklo_epi16(grey_grey_lo, grey_alpha_lo));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 16), _mm_unpackhi_epi16(grey_grey_lo, grey_alpha_lo));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 32), _mm_unpacklo_epi16(grey_grey_hi, grey_alpha_hi));
+        _mm_storeu_si128((__m128i*) (dst + i * 4 + 48), _mm_unpackhi_epi16(grey_grey_hi, grey_alpha_hi));
+    }
+    return i;
+}
+#endif
+
+void expand_to_rgba8(uint8_t *dst,
+                     const uint8_t *src,
+                     const size_t pixel_count,
+                     const uint32_t channel_count) {
+    size_t i = 0;
+    switch(channel_count) {
+        case 4:
+            memcpy(dst, src, pixel_count * 4);
+            return;
+
+        case 3:
+#ifdef TEXTURE_LOADER_SSSE3
+            if (has_ssse3()) {
+                i = expand_rgb_ssse3(dst, src, pixel_count);
+            }
+#endif
+            for(; i < pixel_count; i++) {
+                dst[i * 4 + 0] = src[i * 3 + 0];
+                dst[i * 4 + 1] = src[i * 3 + 1];
+                dst[i * 4 + 2] = src[i * 3 + 2];
+                dst[i * 4 + 3] = 255;
+            }
+            return;
+
+        case 2: // Grey & alpha
+            for(; i < pixel_count; i++) {
+                dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i * 2];
+                dst[i * 4 + 3] = src[i * 2 + 1];
+            }
+            return;
+
+        case 1:
+#ifdef TEXTURE_LOADER_SSE
+            i = expand_grey_sse2(dst, src, pixel_count);
+#endif
+            for(; i < pixel_count; i++) {
+                dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+                dst[i * 4 + 3] = 255;
+            }
+            return;
+
+        default:
+            assert_msg(false, "Unsupported channel count");
+    }
+}
+
+// ===== MIP CHAIN =====
+
+static inline float srgb_to_linear(const float value) {
+    return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline uint8_t linear_to_srgb(const float value) {
+    const float srgb = (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t) (srgb * 255.0f + 0.5f);
+}
+
+struct sSrgbToLinear {
+    float values[256];
+
+    sSrgbToLinear() {
+        for(uint32_t i = 0; i < 256; i++) {
+            values[i] = srgb_to_linear(i / 255.0f);
+        }
+    }
+};
+
+void downsample_srgb_level(const uint8_t *src,
+                           const uint32_t src_width,
+                           const uint32_t src_height,
+                           uint8_t *dst,
+                           const uint32_t dst_width,
+                           const uint32_t dst_height) {
+    // Built once, the decodes run on several threads
+    static const sSrgbToLinear table;
+    const float *to_linear = table.values;
+
+    // 2x2 texels (or less on the odd borders)
+    for(uint32_t y = 0; y < dst_height; y++) {
+        const uint32_t y0 = (y * 2 < src_height) ? y * 2 : src_height - 1;
+        const uint32_t y1 = (y * 2 + 1 < src_height) ? y * 2 + 1 : y0;
+        for(uint32_t x = 0; x < dst_width; x++) {
+            const uint32_t x0 = (x * 2 < src_width) ? x * 2 : src_width - 1;
+            const uint32_t x1 = (x * 2 + 1 < src_width) ? x * 2 + 1 : x0;
+            const uint8_t *texels[4] = {
+                src + ((size_t) y0 * src_width + x0) * 4,
+                src + ((size_t) y0 * src_width + x1) * 4,
+                src + ((size_t) y1 * src_width + x0) * 4,
+                src + ((size_t) y1 * src_width + x1) * 4
+            };
+
+            uint8_t *out = dst + ((size_t) y * dst_width + x) * 4;
+            for(uint32_t channel = 0; channel < 3; channel++) {
+                const float sum = to_linear[texels[0][channel]] + to_linear[texels[1][channel]] +
+                                  to_linear[texels[2][channel]] + to_linear[texels[3][channel]];
+                out[channel] = linear_to_srgb(sum * 0.25f);
+            }
+            // Alpha is linear
+            out[3] = (uint8_t) ((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+        }
+    }
+}
+
+void build_srgb_mip_chain(const uint8_t *pixels,
+                          const uint32_t width,
+                          const uint32_t height,
+                          const uint32_t channel_count,
+                          sTextureFile *texture_file) {
+    uint32_t mip_levels = 1;
+    for(uint32_t size = (width > height) ? width : height; size > 1 && mip_levels < TEXTURE_FILE_MAX_LEVELS; size /= 2) {
+        mip_levels++;
+    }
+
+    size_t data_size = 0;
+    for(uint32_t level = 0; level < mip_levels; level++) {
+        const uint32_t level_width = (width >> level) > 0 ? width >> level : 1;
+        const uint32_t level_height = (height >> level) > 0 ? height >> level : 1;
+        texture_file->level_offsets[level] = data_size;
+        texture_file->level_sizes[level] = (size_t) level_width * level_height * 4;
+        data_size += texture_file->level_sizes[level];
+    }
+
+    texture_file->format = VK_FORMAT_R8G8B8A8_SRGB;
+    texture_file->width = width;
+    texture_file->height = height;
+    texture_file->mip_levels = mip_levels;
+    texture_file->data = (uint8_t*) malloc(data_size);
+    texture_file->data_size = data_size;
+    texture_file->is_mapped = false;
+    expand_to_rgba8(texture_file->data,
+                    pixels,
+                    (size_t) width * height,
+                    channel_count);
+
+    // Each level from the previous one
+    for(uint32_t level = 1; level < mip_levels; level++) {
+        downsample_srgb_level(texture_file->data + texture_file->level_offsets[level - 1],
+                              (width >> (level - 1)) > 0 ? width >> (level - 1) : 1,
+                              (height >> (level - 1)) > 0 ? height >> (level - 1) : 1,
+                              texture_file->data + texture_file->level_offsets[level],
+                              (width >> level) > 0 ? width >> level : 1,
+                              (height >> level) > 0 ? height >> level : 1);
+    }
+}
+
+bool load_texture_file(const char *file_name,
+                       sTextureFile *texture_file) {
+    const char *extension = strrchr(file_name, '.');
+    if (extension == NULL) {
+        return false;
+    }
+
+    if (strcmp(extension, ".ktx2") == 0) {
+        return load_ktx2(file_name, texture_file);
+    } else if (strcmp(extension, ".dds") == 0) {
+        return load_dds(file_name, texture_file);
+    }
+    return false;
+}
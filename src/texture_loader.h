@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#define TEXTURE_FILE_MAX_LEVELS 16
+
+// Size of a compression block, uncompressed formats are 1x1 blocks
+struct sBlockInfo {
+    uint32_t width;
+    uint32_t height;
+    uint32_t size; // In bytes
+};
+
+// Returns false for the formats the loader does not know
+bool get_block_info(const VkFormat format,
+                    sBlockInfo *info);
+
+// Bytes of a level, rounding the extent up to whole blocks
+size_t get_level_size(const sBlockInfo &block,
+                      const uint32_t width,
+                      const uint32_t height);
+
+// See texture_cache.cpp. Read only mappings, NULL if the file cannot be opened
+void* map_file(const char *file_name,
+               size_t *size,
+               const bool is_sequential = true);
+void unmap_file(void *address,
+                const size_t size);
+
+// A texture file with its pre built mip chain, ready to be copied as is
+struct sTextureFile {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mip_levels = 0;
+
+    // Level 0 is the biggest one, the offsets are inside data
+    size_t   level_offsets[TEXTURE_FILE_MAX_LEVELS];
+    size_t   level_sizes[TEXTURE_FILE_MAX_LEVELS];
+
+    uint8_t  *data = NULL; // The whole file
+    size_t   data_size = 0;
+    bool     is_mapped = false; // A memory mapped texture cache, not malloc'd
+
+    void clean() {
+        if (is_mapped) {
+            unmap_file(data, data_size);
+        } else {
+            free(data);
+        }
+        data = NULL;
+        is_mapped = false;
+    }
+};
+
+// KTX2, only without supercompression (the blocks are uploaded directly)
+bool load_ktx2(const char *file_name,
+               sTextureFile *texture_file);
+
+// DDS, with the legacy DXT FourCCs or the DX10 header
+bool load_dds(const char *file_name,
+              sTextureFile *texture_file);
+
+// Widens 1 to 4 channel pixels (as decoded by stb_image) to RGBA8, on SIMD for
+// grey & RGB. Meant to write straight to the mapped staging memory
+void expand_to_rgba8(uint8_t *dst,
+                     const uint8_t *src,
+                     const size_t pixel_count,
+                     const uint32_t channel_count);
+
+// One RGBA8 sRGB level from the previous one, box filtered on linear space. The
+// destination can be rounded up or down, the odd borders are clamped
+void downsample_srgb_level(const uint8_t *src,
+                           const uint32_t src_width,
+                           const uint32_t src_height,
+                           uint8_t *dst,
+                           const uint32_t dst_width,
+                           const uint32_t dst_height);
+
+// Box filtered mips of a sRGB image, averaged on linear space. The pixels can have
+// 1 to 4 channels, the chain is RGBA8. The texture file owns it, and the pixels are left untouched
+void build_srgb_mip_chain(const uint8_t *pixels,
+                          const uint32_t width,
+                          const uint32_t height,
+                          const uint32_t channel_count,
+                          sTextureFile *texture_file);
+
+// Picks the loader from the extension
+bool load_texture_file(const char *file_name,
+                       sTextureFile *texture_file);
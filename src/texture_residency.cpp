@@ -0,0 +1,239 @@
+#include "texture_streamer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+#include "app.h"
+#include "utils.h"
+
+// Residency of the streamed textures. Everything here runs on the render thread,
+// the upload thread only hands over new textures (via the state & has_pending), and the
+// decodes give up the failed reloads (via has_failed_reload & is_reloading)
+
+void sTextureStreamer::_init_residency(const uint32_t frames_in_flight) {
+    frame_count = frames_in_flight;
+    retired_textures = (sTexture*) malloc(sizeof(sTexture) * TEXTURE_STREAMER_MAX_TEXTURES * frame_count);
+    retired_counts = (uint32_t*) calloc(frame_count, sizeof(uint32_t));
+
+    // Half of the biggest device local heap by default, see set_budget
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(app->Vulkan.physical_device,
+                                        &memory_properties);
+    for(uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        const VkMemoryHeap &heap = memory_properties.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size / 2 > budget) {
+            budget = heap.size / 2;
+        }
+    }
+}
+
+void sTextureStreamer::_retire(const sTexture &texture) {
+    retired_textures[frame_index * TEXTURE_STREAMER_MAX_TEXTURES + retired_counts[frame_index]++] = texture;
+}
+
+void sTextureStreamer::_release_bindless_slot(const sTextureHandle handle) {
+    if (textures[handle].bindless_slot != BINDLESS_INVALID_SLOT) {
+        // The new view gets a new slot on update_bindless, the frames in flight keep reading the old one
+        app->bindless_table.release(textures[handle].bindless_slot);
+        textures[handle].bindless_slot = BINDLESS_INVALID_SLOT;
+    }
+}
+
+inline VkDeviceSize get_image_memory_size(const VkDevice &device,
+                                          const VkImage &image) {
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device,
+                                 image,
+                                 &requirements);
+    return requirements.size;
+}
+
+void sTextureStreamer::_shrink(const sTextureHandle handle) {
+    sStreamedTexture *streamed = &textures[handle];
+    const sTexture old_texture = streamed->texture;
+    sTexture *texture = &streamed->texture;
+
+    texture->width = (old_texture.width > 1) ? old_texture.width / 2 : 1;
+    texture->height = (old_texture.height > 1) ? old_texture.height / 2 : 1;
+    texture->mip_levels = old_texture.mip_levels - 1;
+    app->_create_texture_image(texture->width,
+                               texture->height,
+                               texture->mip_levels,
+                               texture->format,
+                               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                               0,
+                               &texture->texture_image,
+                               &texture->texture_image_memory);
+    texture->create_image_view();
+    texture->create_sampler(&app->sampler_cache);
+
+    shrinks[shrink_count++] = {
+        .source = old_texture.texture_image,
+        .target = texture->texture_image,
+        .format = texture->format,
+        .level_count = texture->mip_levels,
+        .width = texture->width,
+        .height = texture->height
+    };
+
+    // Read by this frame's copy, so it is destroyed after it
+    _retire(old_texture);
+    _release_bindless_slot(handle);
+
+    resident_bytes -= streamed->memory_size;
+    streamed->memory_size = get_image_memory_size(app->Vulkan.device, texture->texture_image);
+    resident_bytes += streamed->memory_size;
+    streamed->dropped_levels++;
+}
+
+void sTextureStreamer::_evict(const sTextureHandle handle) {
+    sStreamedTexture *streamed = &textures[handle];
+
+    // get() returns the placeholder from now on
+    streamed->state.store(STREAMED_TEXTURE_EVICTED, std::memory_order_release);
+    _retire(streamed->texture);
+    _release_bindless_slot(handle);
+
+    resident_bytes -= streamed->memory_size;
+    streamed->memory_size = 0;
+    streamed->dropped_levels = 0;
+}
+
+void sTextureStreamer::begin_frame(const uint32_t current_frame) {
+    frame_index = current_frame;
+    frame_number++;
+    // The previous frame recorded its copies already
+    shrink_count = 0;
+
+    // The GPU is done with the frame that retired these
+    for(uint32_t i = 0; i < retired_counts[frame_index]; i++) {
+        retired_textures[frame_index * TEXTURE_STREAMER_MAX_TEXTURES + i].cleanup();
+    }
+    retired_counts[frame_index] = 0;
+
+    // ===== NEW UPLOADS =====
+    for(uint32_t i = 0; i < texture_count; i++) {
+        sStreamedTexture *streamed = &textures[i];
+
+        if (streamed->has_pending.load(std::memory_order_acquire)) {
+            _retire(streamed->texture);
+            _release_bindless_slot(i);
+            resident_bytes -= streamed->memory_size;
+
+            streamed->texture = streamed->pending_texture;
+            streamed->memory_size = 0;
+            streamed->dropped_levels = 0;
+            streamed->has_pending.store(false);
+            streamed->is_reloading.store(false);
+        }
+
+        if (streamed->memory_size == 0 && is_resident(i)) {
+            streamed->memory_size = get_image_memory_size(app->Vulkan.device, streamed->texture.texture_image);
+            resident_bytes += streamed->memory_size;
+        }
+    }
+
+    // ===== RELOADS =====
+    // What was used on the frames in flight is needed again
+    for(uint32_t i = 0; i < texture_count; i++) {
+        sStreamedTexture *streamed = &textures[i];
+        if (streamed->last_used_frame + frame_count < frame_number) {
+            continue;
+        }
+
+        const uint32_t state = streamed->state.load(std::memory_order_acquire);
+        if (state == STREAMED_TEXTURE_EVICTED) {
+            streamed->state.store(STREAMED_TEXTURE_DECODING, std::memory_order_release);
+            _request_decode(i);
+        } else if (state == STREAMED_TEXTURE_RESIDENT &&
+                   streamed->dropped_levels > 0 &&
+                   !streamed->is_reloading.load(std::memory_order_acquire) &&
+                   resident_bytes < budget) {
+            // Set before is_reloading is cleared, so it is seen here
+            if (streamed->has_failed_reload.load(std::memory_order_acquire)) {
+                if (streamed->reload_frame + TEXTURE_RESIDENCY_RETRY_FRAMES > frame_number) {
+                    continue;
+                }
+                streamed->has_failed_reload.store(false, std::memory_order_relaxed);
+            }
+            streamed->reload_frame = frame_number;
+            streamed->is_reloading.store(true, std::memory_order_release);
+            _request_decode(i);
+        }
+    }
+
+    // ===== EVICTIONS =====
+    // Only what was not used on the frames in flight, one step per texture & frame
+    uint64_t shrunk_frame[TEXTURE_STREAMER_MAX_TEXTURES] = {};
+    while(resident_bytes > budget && shrink_count < TEXTURE_RESIDENCY_MAX_SHRINKS) {
+        sTextureHandle victim = UINT32_MAX;
+        uint64_t victim_last_used = UINT64_MAX;
+        for(uint32_t i = 0; i < texture_count; i++) {
+            const sStreamedTexture &streamed = textures[i];
+            if (!is_resident(i) ||
+                streamed.is_reloading.load(std::memory_order_acquire) ||
+                streamed.last_used_frame + frame_count >= frame_number ||
+                shrunk_frame[i] == frame_number) {
+                continue;
+            }
+
+            if (streamed.last_used_frame < victim_last_used) {
+                victim = i;
+                victim_last_used = streamed.last_used_frame;
+            }
+        }
+
+        if (victim == UINT32_MAX) {
+            break;
+        }
+
+        const sTexture &texture = textures[victim].texture;
+        const uint32_t biggest_side = (texture.width > texture.height) ? texture.width : texture.height;
+        if (texture.mip_levels > 1 && biggest_side / 2 >= TEXTURE_RESIDENCY_MIN_SIZE) {
+            _shrink(victim);
+        } else {
+            _evict(victim);
+        }
+        shrunk_frame[victim] = frame_number;
+    }
+}
+
+void sTextureStreamer::record_shrink(const VkCommandBuffer &command_buffer,
+                                     const uint32_t index) {
+    const sTextureShrink &shrink = shrinks[index];
+
+    // The render graph transitioned the whole source to TRANSFER_SRC, and the target to TRANSFER_DST
+    VkImageCopy regions[TEXTURE_FILE_MAX_LEVELS];
+    for(uint32_t level = 0; level < shrink.level_count; level++) {
+        const uint32_t width = (shrink.width >> level) > 0 ? shrink.width >> level : 1;
+        const uint32_t height = (shrink.height >> level) > 0 ? shrink.height >> level : 1;
+        regions[level] = {
+            .srcSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level + 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .srcOffset = { .x = 0, .y = 0, .z = 0 },
+            .dstSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .dstOffset = { .x = 0, .y = 0, .z = 0 },
+            .extent = { .width = width, .height = height, .depth = 1 }
+        };
+    }
+
+    vkCmdCopyImage(command_buffer,
+                   shrink.source,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   shrink.target,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   shrink.level_count,
+                   regions);
+}
@@ -0,0 +1,437 @@
+#include "texture_streamer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+#include <stb_image.h>
+
+#include "app.h"
+#include "utils.h"
+#include "texture_cache.h"
+
+// ===== DECODE (worker threads) =====
+
+static void decode_texture_job(void *data,
+                               const uint32_t begin,
+                               const uint32_t end) {
+    sStreamedTexture *streamed = (sStreamedTexture*) data;
+    sTextureStreamer *streamer = streamed->streamer;
+
+    // Prefer a compressed version, that can be uploaded as is
+    if (streamer->app->find_compressed_texture(streamed->path, &streamed->file)) {
+        streamed->generate_mips = false;
+    } else if (load_texture_cache(streamed->path, &streamed->file)) {
+        // Decoded on a previous run, with its mips: mapped & copied as is
+        streamed->generate_mips = false;
+    } else {
+        // Native channels, the expansion to RGBA is done while building the chain
+        int width, height, channel_count;
+        uint8_t *pixels = stbi_load(streamed->path,
+                                    &width,
+                                    &height,
+                                    &channel_count,
+                                    0);
+        if (pixels == NULL) {
+            std::cout << "Error streaming " << streamed->path << std::endl;
+            // A failed reload keeps the shrunk texture, and is retried later (see begin_frame)
+            if (streamed->is_reloading.load(std::memory_order_acquire)) {
+                streamed->has_failed_reload.store(true, std::memory_order_release);
+                streamed->has_pending.store(false, std::memory_order_release);
+                streamed->is_reloading.store(false, std::memory_order_release);
+            } else {
+                streamed->state.store(STREAMED_TEXTURE_FAILED, std::memory_order_release);
+            }
+            return;
+        }
+
+        // The mips are built here once, and stored with the cache for the next runs
+        build_srgb_mip_chain(pixels,
+                             width,
+                             height,
+                             channel_count,
+                             &streamed->file);
+        stbi_image_free(pixels);
+        streamed->generate_mips = false;
+
+        write_texture_cache(streamed->path,
+                            streamed->file);
+    }
+
+    // The reloads stay resident, with the current texture, until the swap
+    if (!streamed->is_reloading.load(std::memory_order_acquire)) {
+        streamed->state.store(STREAMED_TEXTURE_UPLOADING, std::memory_order_release);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        streamer->decoded_queue[streamer->decoded_count++] = (sTextureHandle) (streamed - streamer->textures);
+    }
+    streamer->has_decoded.notify_one();
+}
+
+// ===== STREAMER =====
+
+void sTextureStreamer::init(sApp *application,
+                            sWorkerPool *pool) {
+    app = application;
+    worker_pool = pool;
+
+    // Neutral grey, until the real texture arrives
+    const uint8_t grey_pixel[4] = { 128, 128, 128, 255 };
+    app->create_image_from_pixels(grey_pixel,
+                                  1,
+                                  1,
+                                  &placeholder);
+    placeholder.create_image_view();
+    placeholder.create_sampler(&app->sampler_cache);
+    if (app->Vulkan.use_bindless) {
+        // The first slot taken, the fallback of every texture without one
+        placeholder_slot = app->bindless_table.allocate(placeholder.texture_image_view,
+                                                        placeholder.sampler);
+        assert_msg(placeholder_slot != BINDLESS_INVALID_SLOT, "No bindless slot for the placeholder texture");
+    }
+
+    // The command pools are not thread safe, so the upload thread has its own
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = app->Vulkan.queues.graphics_family_id
+    };
+    VK_OK(vkCreateCommandPool(app->Vulkan.device,
+                              &pool_info,
+                              NULL,
+                              &upload_command_pool),
+          "Create upload command pool");
+
+    _init_residency(app->Vulkan.frame_count);
+
+    is_running = true;
+    upload_thread = std::thread([this]() { _upload_loop(); });
+}
+
+sTextureHandle sTextureStreamer::request(const char *image_name) {
+    assert_msg(texture_count < TEXTURE_STREAMER_MAX_TEXTURES, "Too many streamed textures");
+    const sTextureHandle handle = texture_count++;
+
+    sStreamedTexture *streamed = &textures[handle];
+    strncpy(streamed->path, image_name, TEXTURE_STREAMER_MAX_PATH - 1);
+    streamed->path[TEXTURE_STREAMER_MAX_PATH - 1] = '\0';
+    streamed->streamer = this;
+    streamed->bindless_slot = BINDLESS_INVALID_SLOT;
+    streamed->last_used_frame = frame_number;
+    streamed->memory_size = 0;
+    streamed->dropped_levels = 0;
+    streamed->is_reloading.store(false);
+    streamed->has_pending.store(false);
+    streamed->has_failed_reload.store(false);
+    streamed->reload_frame = 0;
+    streamed->state.store(STREAMED_TEXTURE_DECODING, std::memory_order_release);
+
+    _request_decode(handle);
+
+    return handle;
+}
+
+void sTextureStreamer::_request_decode(const sTextureHandle handle) {
+    worker_pool->push_job({
+        .function = decode_texture_job,
+        .data = &textures[handle],
+        .begin = 0,
+        .end = 1,
+        .pending_counter = NULL
+    });
+}
+
+void sTextureStreamer::update_bindless(sBindlessTable *table) {
+    // When the table is full, the rest keep the placeholder until a slot is released
+    for(uint32_t i = 0; i < texture_count; i++) {
+        if (textures[i].bindless_slot == BINDLESS_INVALID_SLOT && is_resident(i)) {
+            textures[i].bindless_slot = table->allocate(textures[i].texture.texture_image_view,
+                                                        textures[i].texture.sampler);
+        }
+    }
+}
+
+// ===== UPLOAD (upload thread) =====
+
+void sTextureStreamer::_upload_loop() {
+    sTextureHandle batch[TEXTURE_STREAMER_MAX_BATCH];
+
+    while(true) {
+        uint32_t batch_count = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            has_decoded.wait(lock, [this]() { return decoded_count > 0 || !is_running; });
+            if (!is_running) {
+                return;
+            }
+
+            // Take everything decoded so far, up to a batch
+            batch_count = (decoded_count < TEXTURE_STREAMER_MAX_BATCH) ? decoded_count : TEXTURE_STREAMER_MAX_BATCH;
+            memcpy(batch, decoded_queue, sizeof(sTextureHandle) * batch_count);
+            memmove(decoded_queue,
+                    decoded_queue + batch_count,
+                    sizeof(sTextureHandle) * (decoded_count - batch_count));
+            decoded_count -= batch_count;
+        }
+
+        _upload_batch(batch, batch_count);
+    }
+}
+
+void sTextureStreamer::_reserve_staging(const VkDeviceSize size) {
+    if (size <= staging_capacity) {
+        return;
+    }
+
+    if (staging_capacity > 0) {
+        vkUnmapMemory(app->Vulkan.device, staging_memory);
+        vkDestroyBuffer(app->Vulkan.device, staging_buffer, NULL);
+        vkFreeMemory(app->Vulkan.device, staging_memory, NULL);
+    }
+
+    // Grow geometrically, so a few big textures do not recreate it on every batch
+    staging_capacity = (staging_capacity * 2 > TEXTURE_STREAMER_STAGING_SIZE) ? staging_capacity * 2 : TEXTURE_STREAMER_STAGING_SIZE;
+    staging_capacity = (size > staging_capacity) ? size : staging_capacity;
+
+    app->create_buffer(staging_capacity,
+                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                       &staging_buffer,
+                       &staging_memory);
+
+    VK_OK(vkMapMemory(app->Vulkan.device,
+                      staging_memory,
+                      0,
+                      staging_capacity,
+                      0,
+                      (void**) &staging_address),
+          "Mapping streamer staging memory");
+}
+
+void sTextureStreamer::_upload_batch(const sTextureHandle *batch,
+                                     const uint32_t batch_count) {
+    const VkDevice &device = app->Vulkan.device;
+
+    // All the levels of the batch on a single staging buffer
+    VkDeviceSize staging_size = 0;
+    VkDeviceSize staging_offsets[TEXTURE_STREAMER_MAX_BATCH][TEXTURE_FILE_MAX_LEVELS];
+    for(uint32_t i = 0; i < batch_count; i++) {
+        const sTextureFile &file = textures[batch[i]].file;
+        for(uint32_t level = 0; level < file.mip_levels; level++) {
+            staging_offsets[i][level] = staging_size;
+            staging_size += (file.level_sizes[level] + 15) & ~((VkDeviceSize) 15);
+        }
+    }
+
+    _reserve_staging(staging_size);
+    for(uint32_t i = 0; i < batch_count; i++) {
+        const sTextureFile &file = textures[batch[i]].file;
+        for(uint32_t level = 0; level < file.mip_levels; level++) {
+            memcpy(staging_address + staging_offsets[i][level],
+                   file.data + file.level_offsets[level],
+                   file.level_sizes[level]);
+        }
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = NULL,
+        .commandPool = upload_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    VkCommandBuffer command_buffer;
+    VK_OK(vkAllocateCommandBuffers(device,
+                                   &alloc_info,
+                                   &command_buffer),
+          "Allocate upload command buffer");
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = NULL,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    vkBeginCommandBuffer(command_buffer,
+                         &begin_info);
+
+    for(uint32_t i = 0; i < batch_count; i++) {
+        sStreamedTexture *streamed = &textures[batch[i]];
+        const sTextureFile &file = streamed->file;
+        const uint32_t mip_levels = (streamed->generate_mips) ? get_mip_level_count(file.width, file.height) : file.mip_levels;
+
+        // Source of the blits, and of the copies when it is shrunk
+        const VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+        sTexture *texture = (streamed->is_reloading.load(std::memory_order_acquire)) ? &streamed->pending_texture : &streamed->texture;
+        app->_create_texture_image(file.width,
+                                   file.height,
+                                   mip_levels,
+                                   file.format,
+                                   usage,
+                                   0,
+                                   &texture->texture_image,
+                                   &texture->texture_image_memory);
+        texture->width = file.width;
+        texture->height = file.height;
+        texture->depth = 1;
+        texture->mip_levels = mip_levels;
+        texture->format = file.format;
+        texture->device = &app->Vulkan.device;
+        texture->physical_device = &app->Vulkan.physical_device;
+
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = NULL,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = texture->texture_image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = mip_levels,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, NULL,
+                             0, NULL,
+                             1, &barrier);
+
+        VkBufferImageCopy regions[TEXTURE_FILE_MAX_LEVELS];
+        for(uint32_t level = 0; level < file.mip_levels; level++) {
+            regions[level] = {
+                .bufferOffset = staging_offsets[i][level],
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = level,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { .x = 0, .y = 0, .z = 0 },
+                .imageExtent = {
+                    .width = (file.width >> level) > 0 ? file.width >> level : 1,
+                    .height = (file.height >> level) > 0 ? file.height >> level : 1,
+                    .depth = 1
+                }
+            };
+        }
+        vkCmdCopyBufferToImage(command_buffer,
+                               staging_buffer,
+                               texture->texture_image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               file.mip_levels,
+                               regions);
+
+        if (streamed->generate_mips) {
+            record_blit_mip_chain(command_buffer,
+                                  texture->texture_image,
+                                  file.width,
+                                  file.height,
+                                  mip_levels);
+        } else {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            vkCmdPipelineBarrier(command_buffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0,
+                                 0, NULL,
+                                 0, NULL,
+                                 1, &barrier);
+        }
+    }
+
+    vkEndCommandBuffer(command_buffer);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer
+    };
+    uint64_t upload_value;
+    {
+        // The queue (and its timeline) is shared with the render loop
+        std::lock_guard<std::mutex> lock(app->Vulkan.graphics_queue_mutex);
+        upload_value = app->Vulkan.graphics_timeline.submit(app->Vulkan.graphics_queue,
+                                                            submit_info);
+    }
+
+    // Only this thread waits, the render loop keeps using the placeholders
+    app->Vulkan.graphics_timeline.wait(upload_value);
+
+    vkFreeCommandBuffers(device,
+                         upload_command_pool,
+                         1,
+                         &command_buffer);
+
+    for(uint32_t i = 0; i < batch_count; i++) {
+        sStreamedTexture *streamed = &textures[batch[i]];
+        const bool is_reload = streamed->is_reloading.load(std::memory_order_acquire);
+        sTexture *texture = (is_reload) ? &streamed->pending_texture : &streamed->texture;
+        texture->create_image_view();
+        texture->create_sampler(&app->sampler_cache);
+        streamed->file.clean();
+
+        if (is_reload) {
+            // Swapped in by the render thread, on its next begin_frame
+            streamed->has_pending.store(true, std::memory_order_release);
+        } else {
+            // From now on get() returns it, and the frames swap their descriptors
+            streamed->state.store(STREAMED_TEXTURE_RESIDENT, std::memory_order_release);
+        }
+    }
+}
+
+void sTextureStreamer::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_running = false;
+    }
+    has_decoded.notify_all();
+    upload_thread.join();
+
+    for(uint32_t frame = 0; frame < frame_count; frame++) {
+        for(uint32_t i = 0; i < retired_counts[frame]; i++) {
+            retired_textures[frame * TEXTURE_STREAMER_MAX_TEXTURES + i].cleanup();
+        }
+    }
+    free(retired_textures);
+    free(retired_counts);
+
+    for(uint32_t i = 0; i < texture_count; i++) {
+        if (textures[i].has_pending.load()) {
+            textures[i].pending_texture.cleanup();
+        }
+
+        if (textures[i].state.load() == STREAMED_TEXTURE_RESIDENT) {
+            textures[i].texture.cleanup();
+            // A reload that was decoded but not uploaded
+            textures[i].file.clean();
+        } else {
+            // Decoded, but never uploaded
+            textures[i].file.clean();
+        }
+    }
+
+    placeholder.cleanup();
+    if (staging_capacity > 0) {
+        vkUnmapMemory(app->Vulkan.device, staging_memory);
+        vkDestroyBuffer(app->Vulkan.device, staging_buffer, NULL);
+        vkFreeMemory(app->Vulkan.device, staging_memory, NULL);
+    }
+    vkDestroyCommandPool(app->Vulkan.device, upload_command_pool, NULL);
+}
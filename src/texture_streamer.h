@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vulkan/vulkan_core.h>
+
+#include "textures.h"
+#include "texture_loader.h"
+#include "worker_pool.h"
+#include "bindless.h"
+
+#define TEXTURE_STREAMER_MAX_TEXTURES  256
+// Textures per upload submit
+#define TEXTURE_STREAMER_MAX_BATCH     16
+#define TEXTURE_STREAMER_MAX_PATH      256
+// Initial size of the persistently mapped staging buffer, it grows with the batches
+#define TEXTURE_STREAMER_STAGING_SIZE  (16 * 1024 * 1024)
+// Shrinking stops at this size, after it the whole image is evicted
+#define TEXTURE_RESIDENCY_MIN_SIZE     64
+// Image copies recorded per frame by the evictions
+#define TEXTURE_RESIDENCY_MAX_SHRINKS  16
+// Frames from a failed reload to the next try (file deleted, transient I/O error...)
+#define TEXTURE_RESIDENCY_RETRY_FRAMES 300
+
+struct sApp;
+
+typedef uint32_t sTextureHandle;
+
+enum eStreamedTextureState : uint32_t {
+    STREAMED_TEXTURE_EMPTY = 0,
+    STREAMED_TEXTURE_DECODING,
+    STREAMED_TEXTURE_UPLOADING,
+    STREAMED_TEXTURE_RESIDENT,
+    STREAMED_TEXTURE_EVICTED, // Over budget, decoded again when used
+    STREAMED_TEXTURE_FAILED // Keeps the placeholder forever
+};
+
+struct sTextureStreamer;
+
+struct sStreamedTexture {
+    char                   path[TEXTURE_STREAMER_MAX_PATH];
+    std::atomic<uint32_t>  state;
+
+    sTextureFile           file; // Decoded data, until its uploaded
+    bool                   generate_mips;
+    sTexture               texture;
+    uint32_t               bindless_slot; // Only touched by the render thread
+
+    // Residency, render thread only
+    uint64_t               last_used_frame;
+    VkDeviceSize           memory_size; // 0 until accounted on the budget
+    uint32_t               dropped_levels; // Top mips evicted
+
+    // Full resolution reload of a shrunk texture: the upload goes to pending_texture,
+    // and the render thread swaps it in, while the shrunk one stays bound meanwhile
+    std::atomic<bool>      is_reloading;
+    std::atomic<bool>      has_pending;
+    sTexture               pending_texture;
+    // A failed reload is not retried until TEXTURE_RESIDENCY_RETRY_FRAMES after it started,
+    // the shrunk texture stays & can still be shrunk or evicted meanwhile
+    std::atomic<bool>      has_failed_reload;
+    uint64_t               reload_frame; // Render thread only
+
+    sTextureStreamer       *streamer;
+};
+
+// Recorded on the frame's command buffer, before the render pass
+struct sTextureShrink {
+    VkImage  source;
+    VkImage  target;
+    VkFormat format;
+    uint32_t level_count; // From level 1 of the source, to level 0 of the target
+    uint32_t width; // Of the target
+    uint32_t height;
+};
+
+// Decodes on the worker pool, and uploads on its own thread with its own command pool
+// The handles are valid right away, and resolve to the placeholder until the upload is done
+struct sTextureStreamer {
+    sStreamedTexture   textures[TEXTURE_STREAMER_MAX_TEXTURES];
+    uint32_t           texture_count = 0;
+
+    sTexture           placeholder;
+    uint32_t           placeholder_slot = BINDLESS_INVALID_SLOT;
+
+    // Decoded textures, waiting for the upload thread
+    sTextureHandle     decoded_queue[TEXTURE_STREAMER_MAX_TEXTURES];
+    uint32_t           decoded_count = 0;
+    std::mutex         mutex;
+    std::condition_variable has_decoded;
+
+    std::thread        upload_thread;
+    bool               is_running = false;
+    VkCommandPool      upload_command_pool;
+
+    // Reused by every batch, the upload thread waits for its timeline value before writing it again
+    VkBuffer           staging_buffer;
+    VkDeviceMemory     staging_memory;
+    uint8_t            *staging_address = NULL;
+    VkDeviceSize       staging_capacity = 0;
+
+    sApp               *app = NULL;
+    sWorkerPool        *worker_pool = NULL;
+
+    // ===== RESIDENCY (see texture_residency.cpp) =====
+    // Over budget, the least recently used textures lose their top mip on each
+    // frame, down to TEXTURE_RESIDENCY_MIN_SIZE, and then the whole image
+    VkDeviceSize       budget = 0;
+    VkDeviceSize       resident_bytes = 0;
+    uint64_t           frame_number = 0;
+    uint32_t           frame_index = 0;
+    uint32_t           frame_count = 0;
+
+    // Still used by the frames in flight, destroyed when its frame slot comes back
+    sTexture           *retired_textures = NULL; // TEXTURE_STREAMER_MAX_TEXTURES per frame
+    uint32_t           *retired_counts = NULL;
+
+    sTextureShrink     shrinks[TEXTURE_RESIDENCY_MAX_SHRINKS];
+    uint32_t           shrink_count = 0;
+
+    void init(sApp *application,
+              sWorkerPool *pool);
+
+    // Returns immediately, the decode is done on the worker pool
+    sTextureHandle request(const char *image_name);
+
+    // The texture to bind for this handle, resident or not
+    const sTexture& get(const sTextureHandle handle) const {
+        if (textures[handle].state.load(std::memory_order_acquire) == STREAMED_TEXTURE_RESIDENT) {
+            return textures[handle].texture;
+        }
+        return placeholder;
+    }
+
+    // Same, as an index on the bindless table
+    uint32_t get_bindless_index(const sTextureHandle handle) const {
+        const uint32_t slot = textures[handle].bindless_slot;
+        return (slot != BINDLESS_INVALID_SLOT) ? slot : placeholder_slot;
+    }
+
+    // Render thread: gives a bindless slot to the textures that became resident
+    void update_bindless(sBindlessTable *table);
+
+    void mark_used(const sTextureHandle handle) {
+        textures[handle].last_used_frame = frame_number;
+    }
+
+    void _init_residency(const uint32_t frames_in_flight);
+    void set_budget(const VkDeviceSize budget_bytes) {
+        budget = budget_bytes;
+    }
+
+    // After waiting for the frame's timeline value: frees the retired textures, swaps the
+    // reloads in, reloads what is used again & evicts until under budget
+    void begin_frame(const uint32_t current_frame);
+    // The copy of a shrunk texture, outside of a render pass. Each one is a render
+    // graph pass that reads the old image & writes the new one (see record_command_buffer)
+    void record_shrink(const VkCommandBuffer &command_buffer,
+                       const uint32_t index);
+
+    void _request_decode(const sTextureHandle handle);
+    void _retire(const sTexture &texture);
+    void _release_bindless_slot(const sTextureHandle handle);
+    void _shrink(const sTextureHandle handle);
+    void _evict(const sTextureHandle handle);
+
+    bool is_resident(const sTextureHandle handle) const {
+        return textures[handle].state.load(std::memory_order_acquire) == STREAMED_TEXTURE_RESIDENT;
+    }
+
+    // NOTE: the worker pool needs to be stopped before, so no decode is in flight
+    void cleanup();
+
+    void _upload_loop();
+    void _reserve_staging(const VkDeviceSize size);
+    void _upload_batch(const sTextureHandle *batch,
+                       const uint32_t batch_count);
+};
@@ -7,11 +7,32 @@
 #include <iostream>
 
 #include "utils.h"
+#include "sampler_cache.h"
+
+// Full chain, down to 1x1
+inline uint32_t get_mip_level_count(const uint32_t width,
+                                    const uint32_t height) {
+    uint32_t levels = 1;
+    for(uint32_t size = (width > height) ? width : height; size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+// Blits each level from the previous one, for all the layers, in a single command buffer (see mipmaps.cpp)
+// Expects all the levels on TRANSFER_DST and the level 0 filled, leaves them on SHADER_READ_ONLY
+void record_blit_mip_chain(const VkCommandBuffer &command_buffer,
+                           const VkImage &image,
+                           const uint32_t width,
+                           const uint32_t height,
+                           const uint32_t mip_levels,
+                           const uint32_t layer_count = 1);
 
 struct sTexture {
     uint32_t width;
     uint32_t height;
     uint32_t depth;
+    uint32_t mip_levels = 1;
 
     VkFormat format;
 
@@ -22,11 +43,19 @@ struct sTexture {
 
     VkDevice *device = NULL;
     VkPhysicalDevice *physical_device = NULL;
+    sSamplerCache *sampler_cache = NULL;
 
     void create_image_view() {
+        // Only sampled: with the compute mips the image also has the storage usage,
+        // which its sRGB format does not support (EXTENDED_USAGE, see create_image_from_pixels)
+        VkImageViewUsageCreateInfo usage_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO,
+            .pNext = NULL,
+            .usage = VK_IMAGE_USAGE_SAMPLED_BIT
+        };
         VkImageViewCreateInfo create_info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .pNext = NULL,
+            .pNext = &usage_info,
             .image = texture_image,
             .viewType = (depth > 1) ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D,
             .format = format,
@@ -39,7 +68,7 @@ struct sTexture {
             .subresourceRange = {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, // Wich aspect of the iamge are used, in this case just the color
                 .baseMipLevel = 0,
-                .levelCount = 1, // No need for mipmaping (for now) on the swapchain
+                .levelCount = mip_levels, // Expose the whole chain
                 .baseArrayLayer = 0, // multiplelayers could be usefull for multiple perspectives rendered at the same time
                 .layerCount = 1
             }
@@ -52,41 +81,14 @@ struct sTexture {
              "Error creating image views of texture");
     }
 
-    void create_sampler() {
-        VkPhysicalDeviceProperties properties = {};
-        vkGetPhysicalDeviceProperties(*physical_device, 
-                                      &properties);
-
-        VkSamplerCreateInfo sampler_create_info = {
-            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-            .pNext = NULL,
-            .magFilter = VK_FILTER_LINEAR,
-            .minFilter = VK_FILTER_LINEAR,
-            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-            .addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, // Wrap arround UVS using a repeat
-            .addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
-            .addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
-            .mipLodBias = 0.0f, // ??
-            .anisotropyEnable  = VK_TRUE,
-            .maxAnisotropy = properties.limits.maxSamplerAnisotropy,
-            .compareEnable = VK_FALSE, // PCF on shadowmaps
-            .compareOp = VK_COMPARE_OP_ALWAYS,
-            .minLod = 0.0f,
-            .maxLod = 0.0f,
-            .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
-            .unnormalizedCoordinates = VK_FALSE, // The UVs are from 0,1
-        };
-
-        VK_OK(vkCreateSampler(*device, 
-                              &sampler_create_info, 
-                              NULL, 
-                              &sampler), 
-              "Texture sampler creationg");
+    // Shared with every texture on the same state, see sampler_cache.h
+    void create_sampler(sSamplerCache *cache) {
+        sampler_cache = cache;
+        sampler = sampler_cache->acquire(sampler_cache->default_create_info());
     }
 
-
     void cleanup() {
-        vkDestroySampler(*device, sampler, NULL);
+        sampler_cache->release(sampler);
         vkDestroyImageView(*device, texture_image_view, NULL);
         vkDestroyImage(*device, texture_image, NULL);
         vkFreeMemory(*device, texture_image_memory, NULL);
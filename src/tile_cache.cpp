@@ -0,0 +1,572 @@
+#include "app.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vulkan/vulkan_core.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "tile_cache.h"
+#include "uniform_structs.h"
+#include "sprite_batcher.h"
+
+// ===== VIEW =====
+
+glm::mat4 sTiledImageView::get_view() const {
+    return glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(zoom, zoom, 1.0f)),
+                          glm::vec3(-center, 0.0f));
+}
+
+glm::mat4 sTiledImageView::get_projection(const VkExtent2D &extent) const {
+    const float half_width = extent.width * 0.5f;
+    const float half_height = extent.height * 0.5f;
+    // Bottom & top in the GL order: the Vulkan clip space has the Y down, so the image's Y goes down the screen
+    return glm::ortho(-half_width, half_width, -half_height, half_height);
+}
+
+// ===== LOADS =====
+
+// On the worker pool: the page faults of the mapping happen here, not on the render thread
+static void read_tile_job(void *data,
+                          const uint32_t begin,
+                          const uint32_t end) {
+    sTileLoad *load = (sTileLoad*) data;
+    memcpy(load->staging,
+           load->source,
+           TILE_PYRAMID_TILE_BYTES);
+    load->state.store(TILE_LOAD_READY, std::memory_order_release);
+}
+
+uint32_t sTileCache::_find_victim_slot() const {
+    // The least recently used, that was not drawn this frame & is not being loaded.
+    // The empty slots were never used, so they go first
+    uint32_t victim = TILE_CACHE_INVALID;
+    uint64_t victim_last_used = UINT64_MAX;
+    for(uint32_t i = 0; i < TILE_CACHE_SLOT_COUNT; i++) {
+        const sTileSlot &slot = slots[i];
+        if (slot.is_pinned ||
+            (slot.tile != TILE_CACHE_INVALID && !slot.is_resident) ||
+            slot.last_used_frame >= frame_number) {
+            continue;
+        }
+
+        if (slot.last_used_frame < victim_last_used) {
+            victim = i;
+            victim_last_used = slot.last_used_frame;
+        }
+    }
+    return victim;
+}
+
+bool sTileCache::_request(const uint32_t tile) {
+    sTileLoad *load = NULL;
+    for(uint32_t i = 0; i < TILE_CACHE_MAX_LOADS; i++) {
+        if (loads[i].state.load(std::memory_order_acquire) == TILE_LOAD_FREE) {
+            load = &loads[i];
+            break;
+        }
+    }
+
+    const uint32_t slot = (load != NULL) ? _find_victim_slot() : TILE_CACHE_INVALID;
+    if (slot == TILE_CACHE_INVALID) {
+        return false;
+    }
+
+    // The frames in flight that drew the old tile are ordered before the copy by its barrier
+    if (slots[slot].tile != TILE_CACHE_INVALID) {
+        tile_slots[slots[slot].tile] = TILE_CACHE_INVALID;
+    }
+    slots[slot] = {
+        .tile = tile,
+        .last_used_frame = frame_number,
+        .is_resident = false,
+        .is_pinned = false
+    };
+    tile_slots[tile] = slot;
+
+    load->tile = tile;
+    load->slot = slot;
+    load->source = file_data + header->data_offset + (size_t) tile * TILE_PYRAMID_TILE_BYTES;
+    load->state.store(TILE_LOAD_READING, std::memory_order_release);
+    worker_pool->push_job({
+        .function = read_tile_job,
+        .data = load,
+        .begin = 0,
+        .end = 1,
+        .pending_counter = NULL
+    });
+    return true;
+}
+
+// ===== CACHE =====
+
+bool sTileCache::open(sApp *application,
+                      sWorkerPool *pool,
+                      const char *file_name,
+                      const uint32_t frames_in_flight) {
+    app = application;
+    worker_pool = pool;
+    frame_count = frames_in_flight;
+
+    // ===================================
+    // PYRAMID FILE ======================
+    // ===================================
+    {
+        // The tiles are read in the order they are seen, not the one they are stored
+        file_data = (uint8_t*) map_file(file_name, &file_size, false);
+        if (file_data == NULL) {
+            std::cout << "Could not open the tiled image " << file_name << std::endl;
+            return false;
+        }
+
+        header = (const sTilePyramidHeader*) file_data;
+        sTilePyramidHeader expected_header;
+        bool is_valid = file_size >= sizeof(sTilePyramidHeader) &&
+                        header->magic == TILE_PYRAMID_MAGIC &&
+                        header->version == TILE_PYRAMID_VERSION &&
+                        header->width > 0 && header->height > 0;
+        if (is_valid) {
+            // The layout is fixed by the size, anything else is a broken file
+            expected_header.init(header->width, header->height);
+            is_valid = memcmp(header, &expected_header, sizeof(sTilePyramidHeader)) == 0 &&
+                       file_size >= expected_header.get_file_size();
+        }
+
+        if (!is_valid) {
+            std::cout << file_name << " is not a tile pyramid, see tools/tile_pyramid.cpp" << std::endl;
+            unmap_file(file_data, file_size);
+            return false;
+        }
+
+        tile_slots = (uint32_t*) malloc(sizeof(uint32_t) * header->tile_count);
+        for(uint32_t i = 0; i < header->tile_count; i++) {
+            tile_slots[i] = TILE_CACHE_INVALID;
+        }
+        for(uint32_t i = 0; i < TILE_CACHE_SLOT_COUNT; i++) {
+            slots[i] = { .tile = TILE_CACHE_INVALID, .last_used_frame = 0, .is_resident = false, .is_pinned = false };
+        }
+    }
+
+    // ===================================
+    // ATLAS & STAGING ===================
+    // ===================================
+    {
+        atlas.width = TILE_CACHE_ATLAS_SIZE;
+        atlas.height = TILE_CACHE_ATLAS_SIZE;
+        atlas.depth = 1;
+        atlas.mip_levels = 1; // The pyramid is the mip chain
+        atlas.format = VK_FORMAT_R8G8B8A8_SRGB;
+        atlas.device = &app->Vulkan.device;
+        atlas.physical_device = &app->Vulkan.physical_device;
+        app->_create_texture_image(atlas.width,
+                                   atlas.height,
+                                   atlas.mip_levels,
+                                   atlas.format,
+                                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                   0,
+                                   &atlas.texture_image,
+                                   &atlas.texture_image_memory);
+        atlas.create_image_view();
+        // The default state, the same sampler the main layout has as immutable
+        atlas.create_sampler(&app->sampler_cache);
+
+        const VkDeviceSize staging_size = (VkDeviceSize) TILE_PYRAMID_TILE_BYTES * TILE_CACHE_MAX_LOADS;
+        app->create_buffer(staging_size,
+                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           &staging_buffer,
+                           &staging_memory);
+        VK_OK(vkMapMemory(app->Vulkan.device,
+                          staging_memory,
+                          0,
+                          staging_size,
+                          0,
+                          (void**) &staging_address),
+              "Mapping tile staging memory");
+
+        for(uint32_t i = 0; i < TILE_CACHE_MAX_LOADS; i++) {
+            loads[i].state.store(TILE_LOAD_FREE);
+            loads[i].staging = staging_address + (size_t) i * TILE_PYRAMID_TILE_BYTES;
+        }
+    }
+
+    // ===================================
+    // COARSEST LEVEL ====================
+    // ===================================
+    // Loaded right away & pinned, so every tile has something to fall back to
+    {
+        const sTilePyramidLevel &level = header->levels[header->level_count - 1];
+        const uint32_t pinned_count = level.tiles_x * level.tiles_y;
+        assert_msg(pinned_count <= TILE_CACHE_MAX_LOADS, "Too many tiles on the coarsest level");
+
+        for(uint32_t i = 0; i < pinned_count; i++) {
+            const uint32_t tile = level.first_tile + i;
+            memcpy(loads[i].staging,
+                   file_data + header->data_offset + (size_t) tile * TILE_PYRAMID_TILE_BYTES,
+                   TILE_PYRAMID_TILE_BYTES);
+
+            const glm::uvec2 origin = _get_slot_origin(i);
+            copies[i] = {
+                .bufferOffset = (VkDeviceSize) i * TILE_PYRAMID_TILE_BYTES,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { .x = (int32_t) origin.x, .y = (int32_t) origin.y, .z = 0 },
+                .imageExtent = { .width = TILE_PYRAMID_TILE_SIZE, .height = TILE_PYRAMID_TILE_SIZE, .depth = 1 }
+            };
+
+            slots[i] = { .tile = tile, .last_used_frame = 0, .is_resident = true, .is_pinned = true };
+            tile_slots[tile] = i;
+        }
+
+        app->transition_image_layout(atlas.texture_image,
+                                     atlas.format,
+                                     VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        VkCommandBuffer command_buffer = app->being_single_time_commands();
+        vkCmdCopyBufferToImage(command_buffer,
+                               staging_buffer,
+                               atlas.texture_image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               pinned_count,
+                               copies);
+        app->end_single_time_commands(command_buffer);
+
+        app->transition_image_layout(atlas.texture_image,
+                                     atlas.format,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    // ===================================
+    // DESCRIPTORS =======================
+    // ===================================
+    if (app->Vulkan.use_bindless) {
+        bindless_slot = app->bindless_table.allocate(atlas.texture_image_view,
+                                                     atlas.sampler);
+        if (bindless_slot == BINDLESS_INVALID_SLOT) {
+            std::cout << "Bindless table full, the tiles are drawn with the placeholder" << std::endl;
+            bindless_slot = app->texture_streamer.placeholder_slot;
+        }
+    } else {
+        // Same layout than the main sets: the frame's UBO, and the atlas instead of the texture.
+        // Sampled with the layout's immutable default sampler, so the pipeline layout is shared
+        VkDescriptorPoolSize pool_sizes[2];
+        pool_sizes[0] = { .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = frame_count };
+        pool_sizes[1] = { .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = frame_count };
+
+        VkDescriptorPoolCreateInfo pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = NULL,
+            .maxSets = frame_count,
+            .poolSizeCount = 2,
+            .pPoolSizes = pool_sizes,
+        };
+
+        VK_OK(vkCreateDescriptorPool(app->Vulkan.device,
+                                     &pool_create_info,
+                                     NULL,
+                                     &descriptor_pool),
+              "Create tile cache descriptor pool");
+
+        descriptor_sets = (VkDescriptorSet*) malloc(sizeof(VkDescriptorSet) * frame_count);
+        for(uint32_t i = 0; i < frame_count; i++) {
+            VkDescriptorSetAllocateInfo alloc_info = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext = NULL,
+                .descriptorPool = descriptor_pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &app->Vulkan.descriptor_set_layout
+            };
+
+            VK_OK(vkAllocateDescriptorSets(app->Vulkan.device,
+                                           &alloc_info,
+                                           &descriptor_sets[i]),
+                  "Allocate tile cache descriptor set");
+
+            VkDescriptorBufferInfo buffer_info = {
+                .buffer = app->Vulkan.uniform_buffers[i],
+                .offset = 0,
+                .range = sizeof(sUniformBufferObject)
+            };
+
+            VkDescriptorImageInfo image_info = {
+                .sampler = VK_NULL_HANDLE, // Immutable on the layout
+                .imageView = atlas.texture_image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            };
+
+            VkWriteDescriptorSet descriptor_set_write[2];
+            descriptor_set_write[0] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = descriptor_sets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .pImageInfo = NULL,
+                .pBufferInfo = &buffer_info,
+                .pTexelBufferView = NULL,
+            };
+            descriptor_set_write[1] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = NULL,
+                .dstSet = descriptor_sets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &image_info,
+                .pBufferInfo = NULL,
+                .pTexelBufferView = NULL,
+            };
+
+            vkUpdateDescriptorSets(app->Vulkan.device,
+                                   2,
+                                   descriptor_set_write,
+                                   0,
+                                   NULL);
+        }
+    }
+
+    is_open = true;
+    return true;
+}
+
+void sTileCache::begin_frame(const uint32_t current_frame) {
+    frame_index = current_frame;
+    frame_number++;
+    copy_count = 0;
+
+    for(uint32_t i = 0; i < TILE_CACHE_MAX_LOADS; i++) {
+        sTileLoad &load = loads[i];
+        const uint32_t state = load.state.load(std::memory_order_acquire);
+
+        if (state == TILE_LOAD_COPYING && load.frame_index == frame_index) {
+            // The GPU is done with the copy, the staging can be written again
+            load.state.store(TILE_LOAD_FREE, std::memory_order_release);
+        } else if (state == TILE_LOAD_READY) {
+            // Copied before this frame's render pass, so it can already be drawn
+            const glm::uvec2 origin = _get_slot_origin(load.slot);
+            copies[copy_count++] = {
+                .bufferOffset = (VkDeviceSize) (load.staging - staging_address),
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { .x = (int32_t) origin.x, .y = (int32_t) origin.y, .z = 0 },
+                .imageExtent = { .width = TILE_PYRAMID_TILE_SIZE, .height = TILE_PYRAMID_TILE_SIZE, .depth = 1 }
+            };
+            slots[load.slot].is_resident = true;
+
+            load.frame_index = frame_index;
+            load.state.store(TILE_LOAD_COPYING, std::memory_order_release);
+        }
+    }
+}
+
+void sTileCache::_draw_tile(sSpriteBatcher *sprite_batcher,
+                            const VkPipeline &pipeline,
+                            const uint32_t level,
+                            const uint32_t tile_x,
+                            const uint32_t tile_y) {
+    // Resident tile, or the closest coarser one that covers it
+    uint32_t source_level = level, slot = TILE_CACHE_INVALID;
+    for(; source_level < header->level_count; source_level++) {
+        const sTilePyramidLevel &pyramid_level = header->levels[source_level];
+        const uint32_t shift = source_level - level;
+        const uint32_t tile = pyramid_level.first_tile + (tile_y >> shift) * pyramid_level.tiles_x + (tile_x >> shift);
+        slot = tile_slots[tile];
+        if (slot != TILE_CACHE_INVALID && slots[slot].is_resident) {
+            break;
+        }
+    }
+    if (source_level == header->level_count) {
+        return;
+    }
+    slots[slot].last_used_frame = frame_number;
+
+    // Area of the tile, on texels of level 0
+    const sTilePyramidLevel &pyramid_level = header->levels[level];
+    const float scale = ldexpf(1.0f, (int) level);
+    const float x0 = tile_x * TILE_PYRAMID_CONTENT_SIZE * scale;
+    const float y0 = tile_y * TILE_PYRAMID_CONTENT_SIZE * scale;
+    float x1 = glm::min((tile_x + 1) * TILE_PYRAMID_CONTENT_SIZE, pyramid_level.width) * scale;
+    float y1 = glm::min((tile_y + 1) * TILE_PYRAMID_CONTENT_SIZE, pyramid_level.height) * scale;
+    x1 = glm::min(x1, (float) header->width);
+    y1 = glm::min(y1, (float) header->height);
+
+    // The same area inside of the source tile, on atlas texels
+    const uint32_t shift = source_level - level;
+    const float source_scale = ldexpf(1.0f, (int) source_level);
+    const glm::vec2 source_origin = glm::vec2((tile_x >> shift) * TILE_PYRAMID_CONTENT_SIZE,
+                                              (tile_y >> shift) * TILE_PYRAMID_CONTENT_SIZE) * source_scale;
+    const glm::vec2 slot_origin = glm::vec2(_get_slot_origin(slot)) + glm::vec2((float) TILE_PYRAMID_BORDER);
+    const glm::vec2 uv_min = (slot_origin + (glm::vec2(x0, y0) - source_origin) / source_scale) / (float) TILE_CACHE_ATLAS_SIZE;
+    const glm::vec2 uv_max = (slot_origin + (glm::vec2(x1, y1) - source_origin) / source_scale) / (float) TILE_CACHE_ATLAS_SIZE;
+
+    // From the bottom edge up: the Y of the image goes down the screen, and
+    // the sprite has to stay counter clockwise for the back face culling
+    const glm::vec2 position = glm::vec2(x0, y1);
+    const glm::vec2 size = glm::vec2(x1 - x0, y0 - y1);
+    const glm::vec4 uv_rect = glm::vec4(uv_min.x, uv_max.y, uv_max.x, uv_min.y);
+    if (app->Vulkan.use_bindless) {
+        sprite_batcher->draw_sprite(pipeline, bindless_slot, position, size, uv_rect, glm::vec3(1.0f));
+    } else {
+        sprite_batcher->draw_sprite(pipeline, descriptor_sets[frame_index], position, size, uv_rect, glm::vec3(1.0f));
+    }
+}
+
+void sTileCache::draw(const glm::mat4 &view_projection,
+                      const VkExtent2D &extent,
+                      sSpriteBatcher *sprite_batcher,
+                      const VkPipeline &pipeline) {
+    // The screen corners, back on texels of level 0
+    const glm::mat4 inverse = glm::inverse(view_projection);
+    const glm::vec4 corner_min = inverse * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f);
+    const glm::vec4 corner_max = inverse * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
+    const glm::vec2 visible_min = glm::max(glm::min(glm::vec2(corner_min), glm::vec2(corner_max)), glm::vec2(0.0f));
+    const glm::vec2 visible_max = glm::min(glm::max(glm::vec2(corner_min), glm::vec2(corner_max)),
+                                           glm::vec2((float) header->width, (float) header->height));
+    if (visible_min.x >= visible_max.x || visible_min.y >= visible_max.y) {
+        return;
+    }
+
+    // The level with 1 to 2 texels per pixel. And coarser while the visible
+    // tiles do not fit on half of the atlas, so a huge window cannot thrash it
+    const float texels_per_pixel = fabsf(corner_max.x - corner_min.x) / (float) extent.width;
+    int32_t level = (texels_per_pixel > 1.0f) ? (int32_t) floorf(log2f(texels_per_pixel)) : 0;
+    level = glm::min(level, (int32_t) header->level_count - 1);
+
+    glm::uvec2 tile_min, tile_max;
+    for(;; level++) {
+        const sTilePyramidLevel &pyramid_level = header->levels[level];
+        const float tile_texels = ldexpf((float) TILE_PYRAMID_CONTENT_SIZE, level);
+        tile_min = glm::uvec2(visible_min / tile_texels);
+        tile_max = glm::uvec2(visible_max / tile_texels);
+        tile_max = glm::min(tile_max, glm::uvec2(pyramid_level.tiles_x - 1, pyramid_level.tiles_y - 1));
+
+        const uint32_t visible_count = (tile_max.x - tile_min.x + 1) * (tile_max.y - tile_min.y + 1);
+        if (visible_count <= TILE_CACHE_SLOT_COUNT / 2 || level + 1 == (int32_t) header->level_count) {
+            break;
+        }
+    }
+    draw_level = (uint32_t) level;
+
+    // Keep what is already there, before the requests look for free slots
+    const sTilePyramidLevel &pyramid_level = header->levels[level];
+    for(uint32_t tile_y = tile_min.y; tile_y <= tile_max.y; tile_y++) {
+        for(uint32_t tile_x = tile_min.x; tile_x <= tile_max.x; tile_x++) {
+            const uint32_t slot = tile_slots[pyramid_level.first_tile + tile_y * pyramid_level.tiles_x + tile_x];
+            if (slot != TILE_CACHE_INVALID) {
+                slots[slot].last_used_frame = frame_number;
+            }
+        }
+    }
+
+    missing_tile_count = 0;
+    for(uint32_t tile_y = tile_min.y; tile_y <= tile_max.y; tile_y++) {
+        for(uint32_t tile_x = tile_min.x; tile_x <= tile_max.x; tile_x++) {
+            const uint32_t tile = pyramid_level.first_tile + tile_y * pyramid_level.tiles_x + tile_x;
+            if (tile_slots[tile] == TILE_CACHE_INVALID) {
+                _request(tile);
+            }
+            if (tile_slots[tile] == TILE_CACHE_INVALID || !slots[tile_slots[tile]].is_resident) {
+                missing_tile_count++;
+            }
+
+            _draw_tile(sprite_batcher, pipeline, level, tile_x, tile_y);
+        }
+    }
+}
+
+void sTileCache::record_transfers(const VkCommandBuffer &command_buffer) {
+    if (copy_count == 0) {
+        return;
+    }
+
+    // The atlas is on TRANSFER_DST, the render graph placed the barriers around the pass
+    vkCmdCopyBufferToImage(command_buffer,
+                           staging_buffer,
+                           atlas.texture_image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           copy_count,
+                           copies);
+}
+
+void sTileCache::cleanup() {
+    atlas.cleanup();
+    vkUnmapMemory(app->Vulkan.device, staging_memory);
+    vkDestroyBuffer(app->Vulkan.device, staging_buffer, NULL);
+    vkFreeMemory(app->Vulkan.device, staging_memory, NULL);
+    if (descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(app->Vulkan.device, descriptor_pool, NULL);
+    }
+    free(descriptor_sets);
+    free(tile_slots);
+    unmap_file(file_data, file_size);
+    is_open = false;
+}
+
+// ===== APP =====
+
+void sApp::_open_tiled_image() {
+    if (config.tiled_image_path == NULL ||
+        !tile_cache.open(this, &worker_pool, config.tiled_image_path, Vulkan.frame_count)) {
+        return;
+    }
+
+    tiled_image_view.fit(tile_cache.header->width,
+                         tile_cache.header->height,
+                         Vulkan.swapchain_info.swapchain_extent);
+
+    // Wheel to zoom around the cursor, drag to pan
+    glfwSetScrollCallback(window,
+                          [](GLFWwindow *window,
+                             double x_offset,
+                             double y_offset) {
+                                sApp *app = (sApp*) glfwGetWindowUserPointer(window);
+                                double cursor_x, cursor_y;
+                                glfwGetCursorPos(window, &cursor_x, &cursor_y);
+                                app->tiled_image_view.zoom_at(glm::vec2((float) cursor_x, (float) cursor_y),
+                                                              powf(1.2f, (float) y_offset),
+                                                              app->Vulkan.swapchain_info.swapchain_extent);
+                            });
+    glfwSetMouseButtonCallback(window,
+                               [](GLFWwindow *window,
+                                  int button,
+                                  int action,
+                                  int mods) {
+                                    sApp *app = (sApp*) glfwGetWindowUserPointer(window);
+                                    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+                                        app->tiled_image_view.is_dragging = action == GLFW_PRESS;
+                                        glfwGetCursorPos(window,
+                                                         &app->tiled_image_view.last_cursor.x,
+                                                         &app->tiled_image_view.last_cursor.y);
+                                    }
+                                });
+    glfwSetCursorPosCallback(window,
+                             [](GLFWwindow *window,
+                                double x,
+                                double y) {
+                                    sTiledImageView &view = ((sApp*) glfwGetWindowUserPointer(window))->tiled_image_view;
+                                    if (view.is_dragging) {
+                                        view.center -= glm::vec2(glm::dvec2(x, y) - view.last_cursor) / view.zoom;
+                                        view.last_cursor = glm::dvec2(x, y);
+                                    }
+                                });
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <atomic>
+#include <vulkan/vulkan_core.h>
+#include <glm/glm.hpp>
+
+#include "utils.h"
+#include "textures.h"
+#include "tile_pyramid.h"
+#include "worker_pool.h"
+#include "bindless.h"
+
+// Single layer atlas, with a fixed grid of tile slots
+#define TILE_CACHE_ATLAS_SIZE    4096
+#define TILE_CACHE_SLOTS_PER_ROW (TILE_CACHE_ATLAS_SIZE / TILE_PYRAMID_TILE_SIZE)
+#define TILE_CACHE_SLOT_COUNT    (TILE_CACHE_SLOTS_PER_ROW * TILE_CACHE_SLOTS_PER_ROW)
+// Tile reads in flight, each one with its own part of the staging buffer
+#define TILE_CACHE_MAX_LOADS     32
+#define TILE_CACHE_INVALID       UINT32_MAX
+
+struct sApp;
+struct sSpriteBatcher;
+
+enum eTileLoadState : uint32_t {
+    TILE_LOAD_FREE = 0,
+    TILE_LOAD_READING, // On the worker pool, from the mapped file to the staging
+    TILE_LOAD_READY, // Waiting for the render thread to record its copy
+    TILE_LOAD_COPYING // Recorded on frame_index, the staging is reused after it
+};
+
+struct sTileLoad {
+    std::atomic<uint32_t> state;
+    uint32_t              tile;
+    uint32_t              slot;
+    uint32_t              frame_index;
+    const uint8_t         *source; // Inside of the mapped pyramid
+    uint8_t               *staging;
+};
+
+struct sTileSlot {
+    uint32_t tile; // TILE_CACHE_INVALID when empty
+    uint64_t last_used_frame;
+    bool     is_resident; // False while its load is in flight
+    bool     is_pinned; // The coarsest level, always there to fall back to
+};
+
+// Pan & zoom of the tiled image, on texels of level 0
+struct sTiledImageView {
+    glm::vec2  center;
+    float      zoom; // Screen pixels per texel
+    bool       is_dragging;
+    glm::dvec2 last_cursor;
+
+    void fit(const uint32_t width,
+             const uint32_t height,
+             const VkExtent2D &extent) {
+        center = glm::vec2(width * 0.5f, height * 0.5f);
+        const float zoom_x = extent.width / (float) width;
+        const float zoom_y = extent.height / (float) height;
+        zoom = (zoom_x < zoom_y) ? zoom_x : zoom_y;
+    }
+
+    // The texel under the cursor stays there
+    void zoom_at(const glm::vec2 &cursor,
+                 const float factor,
+                 const VkExtent2D &extent) {
+        const glm::vec2 from_center = cursor - glm::vec2(extent.width * 0.5f, extent.height * 0.5f);
+        const glm::vec2 texel = center + from_center / zoom;
+        zoom *= factor;
+        center = texel - from_center / zoom;
+    }
+
+    // Texels to screen pixels, around the center. The Y of the image goes down, like Vulkan's
+    glm::mat4 get_view() const;
+    glm::mat4 get_projection(const VkExtent2D &extent) const;
+};
+
+// Streams the tiles of a pyramid file (see tile_pyramid.h) into a fixed size atlas.
+// Each frame the visible tiles of the level that matches the zoom are drawn through
+// the sprite batcher; the missing ones are requested, and covered meanwhile by the
+// closest resident coarser tile. The reads run on the worker pool, so the frame
+// never waits for the disk, however big the image is
+struct sTileCache {
+    bool                     is_open = false;
+
+    // The whole pyramid file, mapped
+    uint8_t                  *file_data = NULL;
+    size_t                   file_size = 0;
+    const sTilePyramidHeader *header = NULL;
+
+    uint32_t                 *tile_slots = NULL; // Per tile of the pyramid, TILE_CACHE_INVALID if not on the atlas
+    sTileSlot                slots[TILE_CACHE_SLOT_COUNT];
+    sTexture                 atlas;
+
+    // How the sprites sample the atlas: a bindless slot, or a set per frame (with its UBO)
+    uint32_t                 bindless_slot = BINDLESS_INVALID_SLOT;
+    VkDescriptorPool         descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet          *descriptor_sets = NULL;
+
+    // Persistently mapped, TILE_PYRAMID_TILE_BYTES per load
+    VkBuffer                 staging_buffer;
+    VkDeviceMemory           staging_memory;
+    uint8_t                  *staging_address = NULL;
+    sTileLoad                loads[TILE_CACHE_MAX_LOADS];
+
+    // This frame's copies, recorded before the render pass
+    VkBufferImageCopy        copies[TILE_CACHE_MAX_LOADS];
+    uint32_t                 copy_count = 0;
+
+    uint64_t                 frame_number = 0;
+    uint32_t                 frame_index = 0;
+    uint32_t                 frame_count = 0;
+
+    // Of the last draw
+    uint32_t                 draw_level = 0;
+    uint32_t                 missing_tile_count = 0;
+
+    sApp                     *app = NULL;
+    sWorkerPool              *worker_pool = NULL;
+
+    // Maps the file & loads the coarsest level, false if it is not a valid pyramid
+    bool open(sApp *application,
+              sWorkerPool *pool,
+              const char *file_name,
+              const uint32_t frames_in_flight);
+
+    // After waiting for the frame's timeline value: recycles its staging, and takes the finished reads
+    void begin_frame(const uint32_t current_frame);
+
+    // Sprites of the tiles visible by the view projection, requesting the missing ones
+    void draw(const glm::mat4 &view_projection,
+              const VkExtent2D &extent,
+              sSpriteBatcher *sprite_batcher,
+              const VkPipeline &pipeline);
+
+    // The copies of the tiles that arrived this frame, outside of a render pass.
+    // On the "Tile uploads" pass, which writes the atlas (see record_command_buffer)
+    void record_transfers(const VkCommandBuffer &command_buffer);
+
+    // NOTE: the worker pool needs to be stopped before, so no read is in flight
+    void cleanup();
+
+    bool _request(const uint32_t tile);
+    uint32_t _find_victim_slot() const;
+    void _draw_tile(sSpriteBatcher *sprite_batcher,
+                    const VkPipeline &pipeline,
+                    const uint32_t level,
+                    const uint32_t tile_x,
+                    const uint32_t tile_y);
+
+    inline glm::uvec2 _get_slot_origin(const uint32_t slot) const {
+        return glm::uvec2((slot % TILE_CACHE_SLOTS_PER_ROW) * TILE_PYRAMID_TILE_SIZE,
+                          (slot / TILE_CACHE_SLOTS_PER_ROW) * TILE_PYRAMID_TILE_SIZE);
+    }
+};
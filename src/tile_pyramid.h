@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+
+// Multi resolution tile pyramid of an image too big for a single VkImage. Built
+// offline by tools/tile_pyramid.cpp, and streamed at runtime by sTileCache
+//
+// Every tile is TILE_PYRAMID_TILE_SIZE^2 RGBA8 sRGB texels, with TILE_PYRAMID_BORDER
+// texels on each side copied from the neighbours (clamped on the image edges),
+// so the bilinear filter does not show the seams. Level 0 is the full image, each
+// next one is half of it (rounded up), until it fits on a single tile
+#define TILE_PYRAMID_MAGIC        0x50544B56 // "VKTP"
+#define TILE_PYRAMID_VERSION      1
+#define TILE_PYRAMID_TILE_SIZE    256
+#define TILE_PYRAMID_BORDER       1
+#define TILE_PYRAMID_CONTENT_SIZE (TILE_PYRAMID_TILE_SIZE - 2 * TILE_PYRAMID_BORDER)
+#define TILE_PYRAMID_TILE_BYTES   (TILE_PYRAMID_TILE_SIZE * TILE_PYRAMID_TILE_SIZE * 4)
+#define TILE_PYRAMID_MAX_LEVELS   24
+// The tiles start on a page, so each one is read from the mapping with the fewest faults
+#define TILE_PYRAMID_DATA_ALIGN   4096
+
+struct sTilePyramidLevel {
+    uint32_t width; // In texels of the level
+    uint32_t height;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t first_tile; // Tiles are stored level by level, row by row
+};
+
+struct sTilePyramidHeader {
+    uint32_t          magic;
+    uint32_t          version;
+    uint32_t          width;
+    uint32_t          height;
+    uint32_t          level_count;
+    uint32_t          tile_count;
+    uint64_t          data_offset; // From the start of the file, tile i is at data_offset + i * TILE_PYRAMID_TILE_BYTES
+    sTilePyramidLevel levels[TILE_PYRAMID_MAX_LEVELS];
+
+    // The layout only depends on the size, so the tool and the reader agree on it
+    void init(const uint32_t image_width,
+              const uint32_t image_height) {
+        memset(this, 0, sizeof(sTilePyramidHeader));
+        magic = TILE_PYRAMID_MAGIC;
+        version = TILE_PYRAMID_VERSION;
+        width = image_width;
+        height = image_height;
+
+        uint32_t level_width = width, level_height = height;
+        for(level_count = 0; level_count < TILE_PYRAMID_MAX_LEVELS; level_count++) {
+            sTilePyramidLevel &level = levels[level_count];
+            level.width = level_width;
+            level.height = level_height;
+            level.tiles_x = (level_width + TILE_PYRAMID_CONTENT_SIZE - 1) / TILE_PYRAMID_CONTENT_SIZE;
+            level.tiles_y = (level_height + TILE_PYRAMID_CONTENT_SIZE - 1) / TILE_PYRAMID_CONTENT_SIZE;
+            level.first_tile = tile_count;
+            tile_count += level.tiles_x * level.tiles_y;
+
+            if (level.tiles_x == 1 && level.tiles_y == 1) {
+                level_count++;
+                break;
+            }
+            level_width = (level_width + 1) / 2;
+            level_height = (level_height + 1) / 2;
+        }
+
+        data_offset = (sizeof(sTilePyramidHeader) + TILE_PYRAMID_DATA_ALIGN - 1) & ~((uint64_t) TILE_PYRAMID_DATA_ALIGN - 1);
+    }
+
+    uint64_t get_file_size() const {
+        return data_offset + (uint64_t) tile_count * TILE_PYRAMID_TILE_BYTES;
+    }
+};
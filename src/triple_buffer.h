@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <atomic>
+
+// Bit on the shared index: the middle slot has a value the reader did not take yet
+#define TRIPLE_BUFFER_DIRTY_BIT 4u
+#define TRIPLE_BUFFER_INDEX_MASK 3u
+
+// Lock-free single producer, single consumer hand-off of the latest value. The writer
+// fills its back slot and swaps it with the middle one; the reader swaps its front
+// slot with the middle one only if it is newer. Neither side ever waits for the other,
+// and the reader always gets a complete value, skipping the ones it was too slow for
+template<typename T>
+struct sTripleBuffer {
+    T                     slots[3];
+    uint32_t              back_index = 0; // Only touched by the writer
+    std::atomic<uint32_t> middle = {1};
+    uint32_t              front_index = 2; // Only touched by the reader
+
+    // Writer side: fill it, and then publish()
+    inline T& get_back() {
+        return slots[back_index];
+    }
+
+    inline void publish() {
+        // Release the writes of the back slot, acquire the slot the reader left
+        back_index = middle.exchange(back_index | TRIPLE_BUFFER_DIRTY_BIT, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX_MASK;
+    }
+
+    // Reader side: the latest published value, or the same one as before if there is none new
+    inline const T& consume(bool *is_new = NULL) {
+        const bool has_new = (middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_DIRTY_BIT) != 0;
+        if (has_new) {
+            front_index = middle.exchange(front_index, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX_MASK;
+        }
+        if (is_new != NULL) {
+            *is_new = has_new;
+        }
+        return slots[front_index];
+    }
+};
@@ -7,6 +7,11 @@ void sApp::_create_descriptor_set_layout() {
     // CREATE DESCRIPTION SET ========
     // ===============================
     {
+        // Every texture on this set uses the default state, so the sampler can
+        // live on the layout and the descriptor writes only change the view
+        sampler_cache.init(&Vulkan.device, Vulkan.physical_device);
+        Vulkan.default_sampler = sampler_cache.acquire(sampler_cache.default_create_info());
+
         VkDescriptorSetLayoutBinding layout_bidings[2];
         layout_bidings[0] = { // UBO layout
             .binding = 0, // the position on the shader's memories
@@ -21,7 +26,7 @@ void sApp::_create_descriptor_set_layout() {
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
             .descriptorCount = 1, // for uploading an array of UBOs
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, // only for vertex shaders
-            .pImmutableSamplers = NULL, // forimage samplers
+            .pImmutableSamplers = &Vulkan.default_sampler, // The sampler on the writes is ignored
         };
 
         // Create layout
@@ -43,7 +48,11 @@ void sApp::_create_descriptor_set_layout() {
 void sApp::_create_uniform_buffers() {
     VkDeviceSize buffer_size = sizeof(sUniformBufferObject);
 
-    for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    Vulkan.uniform_buffers = (VkBuffer*) malloc(sizeof(VkBuffer) * Vulkan.frame_count);
+    Vulkan.uniform_buffers_memory = (VkDeviceMemory*) malloc(sizeof(VkDeviceMemory) * Vulkan.frame_count);
+    Vulkan.uniform_buffers_mapped = (void**) malloc(sizeof(void*) * Vulkan.frame_count);
+
+    for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
         create_buffer(buffer_size, 
                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
@@ -56,8 +65,6 @@ void sApp::_create_uniform_buffers() {
                     buffer_size, 
                     0, 
                     &Vulkan.uniform_buffers_mapped[i]);
-
-        Vulkan.uniform_buffer_count++;
     }
 }
 
@@ -69,18 +76,18 @@ void sApp::_create_descriptor_pool_and_set() {
         VkDescriptorPoolSize pool_sizes[2];
         pool_sizes[0] = { // Ubo descriptor pool size
             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+            .descriptorCount = Vulkan.frame_count
         };
 
         pool_sizes[1] = { // Samplers descriptor pool size
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+            .descriptorCount = Vulkan.frame_count
         };
 
         VkDescriptorPoolCreateInfo pool_create_info = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
             .pNext = NULL,
-            .maxSets = MAX_FRAMES_IN_FLIGHT,
+            .maxSets = Vulkan.frame_count,
             .poolSizeCount = 2,
             .pPoolSizes = pool_sizes,
         };
@@ -96,8 +103,8 @@ void sApp::_create_descriptor_pool_and_set() {
     // CREATE DESCRIPTION SET ========
     // ===============================
     {
-        VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT] = {};
-        for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        VkDescriptorSetLayout *layouts = (VkDescriptorSetLayout*) malloc(sizeof(VkDescriptorSetLayout) * Vulkan.frame_count);
+        for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
             layouts[i] = Vulkan.descriptor_set_layout;
         }
         
@@ -105,27 +112,33 @@ void sApp::_create_descriptor_pool_and_set() {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
             .pNext = NULL,
             .descriptorPool = Vulkan.descriptor_pool,
-            .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+            .descriptorSetCount = Vulkan.frame_count,
             .pSetLayouts = layouts
         }; 
 
+        Vulkan.descriptor_sets = (VkDescriptorSet*) malloc(sizeof(VkDescriptorSet) * Vulkan.frame_count);
+        Vulkan.descriptor_texture_views = (VkImageView*) malloc(sizeof(VkImageView) * Vulkan.frame_count);
+
         VK_OK(vkAllocateDescriptorSets(Vulkan.device, 
                                        &alloc_info, 
                                        Vulkan.descriptor_sets), 
               "Descritor set allocations");
+        free(layouts);
         
-        for(uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for(uint32_t i = 0; i < Vulkan.frame_count; i++) {
             VkDescriptorBufferInfo buffer_info = {
                 .buffer = Vulkan.uniform_buffers[i],
                 .offset = 0,
                 .range = sizeof(sUniformBufferObject)
             };
 
+            const sTexture &texture = texture_streamer.get(main_texture);
             VkDescriptorImageInfo image_info = {
                 .sampler = texture.sampler,
                 .imageView = texture.texture_image_view,
                 .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             };
+            Vulkan.descriptor_texture_views[i] = texture.texture_image_view;
 
             VkWriteDescriptorSet descriptor_set_write[2];
             descriptor_set_write[0] = { // UBO descriptor write set
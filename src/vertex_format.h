@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <string.h>
+#include <array>
+#include <vulkan/vulkan_core.h>
+
+#include <glm/glm.hpp>
+
+namespace Geometry {
+
+    // =============================
+    // ATTRIBUTE ENCODINGS
+    // =============================
+    // Each encoding knows its Vulkan format, and how to be packed from a float vector
+
+    inline uint16_t float_to_half(const float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(float));
+
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const int32_t exponent = (int32_t) ((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        if (exponent >= 31) { // Overflow, Inf & NaN
+            return (uint16_t) (sign | 0x7c00 | ((((bits >> 23) & 0xff) == 0xff && mantissa) ? 0x200 : 0));
+        }
+        if (exponent <= 0) { // Denormals or zero
+            if (exponent < -10) {
+                return (uint16_t) sign;
+            }
+            mantissa |= 0x800000;
+            const uint32_t shift = (uint32_t) (14 - exponent);
+            uint32_t half_mantissa = mantissa >> shift;
+            // Round to nearest even
+            const uint32_t remainder = mantissa & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+                half_mantissa++;
+            }
+            return (uint16_t) (sign | half_mantissa);
+        }
+
+        uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+        // Round to nearest even (a carry on the mantissa correctly bumps the exponent)
+        const uint32_t remainder = mantissa & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return (uint16_t) half;
+    }
+
+    inline uint16_t float_to_unorm16(const float value) {
+        const float clamped = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+        return (uint16_t) (clamped * 65535.0f + 0.5f);
+    }
+
+    inline uint8_t float_to_unorm8(const float value) {
+        const float clamped = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+        return (uint8_t) (clamped * 255.0f + 0.5f);
+    }
+
+    struct sFloat2 {
+        float v[2];
+        static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+        static sFloat2 encode(const glm::vec2 &value) { return { { value.x, value.y } }; }
+    };
+
+    struct sFloat3 {
+        float v[3];
+        static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+        static sFloat3 encode(const glm::vec3 &value) { return { { value.x, value.y, value.z } }; }
+    };
+
+    struct sHalf2 {
+        uint16_t v[2];
+        static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+        static sHalf2 encode(const glm::vec2 &value) { return { { float_to_half(value.x), float_to_half(value.y) } }; }
+    };
+
+    struct sHalf4 {
+        uint16_t v[4];
+        static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        static sHalf4 encode(const glm::vec4 &value) {
+            return { { float_to_half(value.x), float_to_half(value.y), float_to_half(value.z), float_to_half(value.w) } };
+        }
+    };
+
+    struct sUnorm16x2 {
+        uint16_t v[2];
+        static constexpr VkFormat format = VK_FORMAT_R16G16_UNORM;
+        static sUnorm16x2 encode(const glm::vec2 &value) { return { { float_to_unorm16(value.x), float_to_unorm16(value.y) } }; }
+    };
+
+    // NOTE: a vec3 input on the shader just ignores the alpha
+    struct sUnorm8x4 {
+        uint8_t v[4];
+        static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+        static sUnorm8x4 encode(const glm::vec3 &value) {
+            return { { float_to_unorm8(value.x), float_to_unorm8(value.y), float_to_unorm8(value.z), 255 } };
+        }
+        static sUnorm8x4 encode(const glm::vec4 &value) {
+            return { { float_to_unorm8(value.x), float_to_unorm8(value.y), float_to_unorm8(value.z), float_to_unorm8(value.w) } };
+        }
+    };
+
+    // =============================
+    // VERTEX LAYOUT DESCRIPTION
+    // =============================
+    // The attributes are tightly packed in declaration order, on binding 0,
+    // with the shader location being the order on the list. All the encodings
+    // are multiple of 4 bytes, so the vertex struct has no padding
+    template<typename... Attributes>
+    constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> make_vertex_attributes() {
+        constexpr uint32_t sizes[] = { (uint32_t) sizeof(Attributes)... };
+        constexpr VkFormat formats[] = { Attributes::format... };
+
+        std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> result = {};
+        uint32_t offset = 0;
+        for(uint32_t i = 0; i < sizeof...(Attributes); i++) {
+            result[i] = {
+                .location = i,
+                .binding = 0,
+                .format = formats[i],
+                .offset = offset
+            };
+            offset += sizes[i];
+        }
+        return result;
+    }
+
+    // Binding & attribute tables of a vertex, generated at compile time
+    template<typename... Attributes>
+    struct sVertexLayout {
+        static constexpr uint32_t attribute_count = sizeof...(Attributes);
+        static constexpr uint32_t stride = (0 + ... + (uint32_t) sizeof(Attributes));
+
+        static constexpr VkVertexInputBindingDescription binding = {
+            .binding = 0,
+            .stride = stride,
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        };
+
+        static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> attributes = make_vertex_attributes<Attributes...>();
+
+        static VkPipelineVertexInputStateCreateInfo input_state() {
+            return {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+                .pNext = NULL,
+                .vertexBindingDescriptionCount = 1,
+                .pVertexBindingDescriptions = &binding,
+                .vertexAttributeDescriptionCount = attribute_count,
+                .pVertexAttributeDescriptions = attributes.data()
+            };
+        }
+    };
+};
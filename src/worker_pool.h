@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "utils.h"
+
+#define WORKER_POOL_MAX_THREADS 32
+#define WORKER_POOL_QUEUE_SIZE  1024
+
+typedef void (*WorkerJobFunction)(void *data, const uint32_t begin, const uint32_t end);
+
+struct sWorkerJob {
+    WorkerJobFunction      function;
+    void                   *data;
+    uint32_t               begin;
+    uint32_t               end;
+    std::atomic<uint32_t>  *pending_counter; // Decremented when the job is done, can be NULL
+};
+
+// Persistent threads consuming a ring buffer of range jobs
+struct sWorkerPool {
+    std::thread  threads[WORKER_POOL_MAX_THREADS];
+    uint32_t     thread_count = 0;
+
+    sWorkerJob   queue[WORKER_POOL_QUEUE_SIZE];
+    uint32_t     queue_head = 0;
+    uint32_t     queue_count = 0;
+
+    std::mutex   mutex;
+    std::condition_variable has_jobs;
+    bool         is_running = false;
+
+    void init(uint32_t worker_count = 0) {
+        if (worker_count == 0) {
+            // Leave a core for the render (main) thread, and one for the simulation thread
+            const uint32_t cores = std::thread::hardware_concurrency();
+            worker_count = (cores > 2) ? cores - 2 : 1;
+        }
+        if (worker_count > WORKER_POOL_MAX_THREADS) {
+            worker_count = WORKER_POOL_MAX_THREADS;
+        }
+
+        is_running = true;
+        thread_count = worker_count;
+        for(uint32_t i = 0; i < thread_count; i++) {
+            threads[i] = std::thread([this]() { _worker_loop(); });
+        }
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            is_running = false;
+        }
+        has_jobs.notify_all();
+
+        for(uint32_t i = 0; i < thread_count; i++) {
+            threads[i].join();
+        }
+        thread_count = 0;
+    }
+
+    void push_job(const sWorkerJob &job) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            assert_msg(queue_count < WORKER_POOL_QUEUE_SIZE, "Worker pool queue is full");
+            queue[(queue_head + queue_count) % WORKER_POOL_QUEUE_SIZE] = job;
+            queue_count++;
+        }
+        has_jobs.notify_one();
+    }
+
+    // Only the ones of pending_counter when it is not NULL
+    bool _pop_job(sWorkerJob *job,
+                  const std::atomic<uint32_t> *pending_counter = NULL) {
+        if (queue_count == 0) {
+            return false;
+        }
+        if (pending_counter != NULL && queue[queue_head].pending_counter != pending_counter) {
+            return false;
+        }
+        *job = queue[queue_head];
+        queue_head = (queue_head + 1) % WORKER_POOL_QUEUE_SIZE;
+        queue_count--;
+        return true;
+    }
+
+    static void _run_job(const sWorkerJob &job) {
+        job.function(job.data, job.begin, job.end);
+        if (job.pending_counter != NULL) {
+            job.pending_counter->fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void _worker_loop() {
+        while(true) {
+            sWorkerJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                has_jobs.wait(lock, [this]() { return queue_count > 0 || !is_running; });
+                if (!_pop_job(&job)) {
+                    return; // Stopped, and no work left
+                }
+            }
+            _run_job(job);
+        }
+    }
+
+    // Splits [0, count) on ranges of batch_size, and waits for all of them.
+    // The ranges go to the front of the queue, ahead of the long jobs (decodes, tile
+    // reads...), and the calling thread only helps with its own ones while it waits,
+    // so a render thread caller never ends up running a decode
+    void parallel_for(const WorkerJobFunction function,
+                      void *data,
+                      const uint32_t count,
+                      const uint32_t batch_size) {
+        if (count == 0) {
+            return;
+        }
+
+        std::atomic<uint32_t> pending_jobs(0);
+        const uint32_t job_count = (count + batch_size - 1) / batch_size;
+
+        // Single batch or no workers: skip the queue
+        if (job_count == 1 || thread_count == 0) {
+            function(data, 0, count);
+            return;
+        }
+
+        pending_jobs.store(job_count);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            assert_msg(queue_count + job_count <= WORKER_POOL_QUEUE_SIZE, "Worker pool queue is full");
+            // Backwards, so the first range ends up on the head
+            for(uint32_t i = job_count; i-- > 0;) {
+                const uint32_t begin = i * batch_size;
+                const uint32_t end = (begin + batch_size < count) ? begin + batch_size : count;
+                queue_head = (queue_head + WORKER_POOL_QUEUE_SIZE - 1) % WORKER_POOL_QUEUE_SIZE;
+                queue[queue_head] = {
+                    .function = function,
+                    .data = data,
+                    .begin = begin,
+                    .end = end,
+                    .pending_counter = &pending_jobs
+                };
+                queue_count++;
+            }
+        }
+        has_jobs.notify_all();
+
+        while(pending_jobs.load(std::memory_order_acquire) > 0) {
+            sWorkerJob job;
+            bool has_job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                has_job = _pop_job(&job,
+                                   &pending_jobs);
+            }
+
+            if (has_job) {
+                _run_job(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
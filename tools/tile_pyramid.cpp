@@ -0,0 +1,153 @@
+// Cuts an image into the tile pyramid streamed by sTileCache (see src/tile_pyramid.h)
+//
+//   tile_pyramid <image> <output.vktp>
+//   tile_pyramid <raw RGBA8 file> <output.vktp> <width> <height>
+//
+// stb_image decodes the whole image in memory, and stops at 2^31 bytes. The scans
+// bigger than that can be given as raw RGBA8 pixels, which are memory mapped instead
+#include <cstddef>
+#include <cstdint>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "tile_pyramid.h"
+#include "texture_loader.h"
+
+// Tile (x, y) of the level, with its border, clamped on the edges of the level
+static void cut_tile(const uint8_t *pixels,
+                     const uint32_t width,
+                     const uint32_t height,
+                     const uint32_t tile_x,
+                     const uint32_t tile_y,
+                     uint8_t *tile) {
+    const int64_t origin_x = (int64_t) tile_x * TILE_PYRAMID_CONTENT_SIZE - TILE_PYRAMID_BORDER;
+    const int64_t origin_y = (int64_t) tile_y * TILE_PYRAMID_CONTENT_SIZE - TILE_PYRAMID_BORDER;
+
+    // Columns inside of the level, copied as a whole row
+    const int64_t inside_begin = (origin_x < 0) ? -origin_x : 0;
+    int64_t inside_end = (int64_t) width - origin_x;
+    inside_end = (inside_end > TILE_PYRAMID_TILE_SIZE) ? TILE_PYRAMID_TILE_SIZE : inside_end;
+
+    for(int64_t row = 0; row < TILE_PYRAMID_TILE_SIZE; row++) {
+        int64_t y = origin_y + row;
+        y = (y < 0) ? 0 : ((y >= height) ? height - 1 : y);
+        const uint8_t *src_row = pixels + (size_t) y * width * 4;
+        uint8_t *dst_row = tile + row * TILE_PYRAMID_TILE_SIZE * 4;
+
+        memcpy(dst_row + inside_begin * 4,
+               src_row + (origin_x + inside_begin) * 4,
+               (size_t) (inside_end - inside_begin) * 4);
+        for(int64_t column = 0; column < inside_begin; column++) {
+            memcpy(dst_row + column * 4, src_row, 4);
+        }
+        for(int64_t column = inside_end; column < TILE_PYRAMID_TILE_SIZE; column++) {
+            memcpy(dst_row + column * 4, src_row + (size_t) (width - 1) * 4, 4);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3 && argc != 5) {
+        std::cout << "Usage: " << argv[0] << " <image> <output.vktp>" << std::endl;
+        std::cout << "       " << argv[0] << " <raw RGBA8 file> <output.vktp> <width> <height>" << std::endl;
+        return 1;
+    }
+
+    // ===================================
+    // SOURCE ============================
+    // ===================================
+    uint8_t *source = NULL;
+    size_t source_size = 0;
+    uint32_t width = 0, height = 0;
+    const bool is_raw = argc == 5;
+    if (is_raw) {
+        width = (uint32_t) strtoul(argv[3], NULL, 10);
+        height = (uint32_t) strtoul(argv[4], NULL, 10);
+        source = (uint8_t*) map_file(argv[1], &source_size);
+        if (source == NULL || width == 0 || height == 0 || source_size < (size_t) width * height * 4) {
+            std::cout << "Could not map " << argv[1] << " as " << width << "x" << height << " RGBA8 pixels" << std::endl;
+            return 1;
+        }
+    } else {
+        int image_width, image_height, channels;
+        source = stbi_load(argv[1], &image_width, &image_height, &channels, STBI_rgb_alpha);
+        if (source == NULL) {
+            std::cout << "Could not load " << argv[1] << ": " << stbi_failure_reason() << std::endl;
+            return 1;
+        }
+        width = (uint32_t) image_width;
+        height = (uint32_t) image_height;
+    }
+
+    sTilePyramidHeader header;
+    header.init(width, height);
+
+    FILE *file = fopen(argv[2], "wb");
+    if (file == NULL) {
+        std::cout << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+
+    bool is_written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for(uint64_t written = sizeof(header); is_written && written < header.data_offset; written++) {
+        is_written = fputc(0, file) != EOF;
+    }
+
+    // ===================================
+    // LEVELS ============================
+    // ===================================
+    // Only the current level & the next one are in memory at the same time
+    uint8_t *tile = (uint8_t*) malloc(TILE_PYRAMID_TILE_BYTES);
+    const uint8_t *level_pixels = source;
+    uint8_t *owned_pixels = NULL;
+    for(uint32_t level_index = 0; is_written && level_index < header.level_count; level_index++) {
+        const sTilePyramidLevel &level = header.levels[level_index];
+        std::cout << "Level " << level_index << ": " << level.width << "x" << level.height
+                  << ", " << level.tiles_x * level.tiles_y << " tiles" << std::endl;
+
+        for(uint32_t tile_y = 0; is_written && tile_y < level.tiles_y; tile_y++) {
+            for(uint32_t tile_x = 0; is_written && tile_x < level.tiles_x; tile_x++) {
+                cut_tile(level_pixels, level.width, level.height, tile_x, tile_y, tile);
+                is_written = fwrite(tile, TILE_PYRAMID_TILE_BYTES, 1, file) == 1;
+            }
+        }
+
+        if (level_index + 1 < header.level_count) {
+            const sTilePyramidLevel &next_level = header.levels[level_index + 1];
+            uint8_t *next_pixels = (uint8_t*) malloc((size_t) next_level.width * next_level.height * 4);
+            downsample_srgb_level(level_pixels,
+                                  level.width,
+                                  level.height,
+                                  next_pixels,
+                                  next_level.width,
+                                  next_level.height);
+            free(owned_pixels);
+            owned_pixels = next_pixels;
+            level_pixels = next_pixels;
+        }
+    }
+    free(owned_pixels);
+    free(tile);
+    fclose(file);
+
+    if (is_raw) {
+        unmap_file(source, source_size);
+    } else {
+        stbi_image_free(source);
+    }
+
+    if (!is_written) {
+        std::cout << "Could not write " << argv[2] << std::endl;
+        remove(argv[2]);
+        return 1;
+    }
+
+    std::cout << "Written " << header.tile_count << " tiles on " << argv[2] << std::endl;
+    return 0;
+}